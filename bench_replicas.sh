@@ -0,0 +1,45 @@
+#!/bin/bash
+
+# Débit des lectures selon le nombre de répliques de l'arbre (cf. replica.h)
+# usage : ./bench_replicas.sh [nombres de répliques...]     (défaut : 0 1 2 4)
+# Pour chaque nombre : lancement d'un master avec MWC_REPLICAS, chargement
+# de <preload> valeurs dans [<min>,<max>[, puis <clients> clients qui
+# n'envoient que des exist par la boîte aux lettres pendant <duration> s
+# (./loadgen). Les répliques ne servent que la boîte aux lettres : sans
+# réplique, toutes les lectures passent par le thread de la boîte et
+# l'arbre principal, l'une après l'autre.
+# Variables : CLIENTS, DURATION, PRELOAD, MAX, BARRIER (":ryw" pour la
+# lecture de ses propres écritures)
+
+counts=${@:-"0 1 2 4"}
+
+clients=${CLIENTS:-8}
+duration=${DURATION:-3}
+preload=${PRELOAD:-2000}
+min=0
+max=${MAX:-500}         # non inclus
+
+make --no-print-directory all > /dev/null || exit 1
+
+printf "%-10s %12s %12s %12s\n" "répliques" "lectures/s" "p50(µs)" "p99(µs)"
+for n in $counts
+do
+    if [ $n -eq 0 ]
+    then
+        ./master > /dev/null 2>&1 &
+    else
+        MWC_REPLICAS=$n$BARRIER ./master > /dev/null 2>&1 &
+    fi
+    masterPid=$!
+    sleep 0.2
+
+    out=$(MWC_HANDSHAKE=futex ./loadgen --clients=$clients --duration=$duration --reads=1 \
+          --preload=$preload --min=$min --max=$max)
+    ./client stop > /dev/null
+    wait $masterPid
+
+    rate=$(echo "$out" | sed -n 's/.* : \([0-9.]*\) ordres\/s$/\1/p')
+    p50=$(echo "$out" | sed -n '/^latence/,/p99/p' | sed -n 's/^ *p50 *\([0-9.]*\) µs/\1/p')
+    p99=$(echo "$out" | sed -n '/^latence/,/p99/p' | sed -n 's/^ *p99 *\([0-9.]*\) µs/\1/p')
+    printf "%-10s %12s %12s %12s\n" $n "$rate" "$p50" "$p99"
+done
@@ -0,0 +1,52 @@
+#!/bin/bash
+
+# Mesure des performances pour chaque type d'élément (cf. element.h)
+# usage : ./bench_types.sh [types...]     (défaut : float double int32 int64)
+# Pour chaque type : recompilation, lancement d'un master, insertion de
+# <nb> valeurs dans [<min>,<max>[, <nbExist> tests d'existence, somme,
+# puis un calcul local multi-thread.
+# note : le nombre de workers créés est au plus max-min
+
+types=${@:-"float double int32 int64"}
+
+nb=5000
+min=0
+max=200           # non inclus
+nbExist=200
+loc_nbThreads=4
+loc_nb=10000000
+
+now() { date +%s%N; }
+ms() { echo $(( ($2 - $1) / 1000000 )); }
+
+printf "%-8s %12s %12s %12s %12s\n" "type" "insert(ms)" "exist(ms)" "sum(ms)" "local(ms)"
+for t in $types
+do
+    make --no-print-directory $t > /dev/null || exit 1
+
+    ./master > /dev/null 2>&1 &
+    masterPid=$!
+    sleep 0.2
+
+    t0=$(now)
+    ./client insertmany $nb $min $max > /dev/null
+    t1=$(now)
+    for i in `seq 1 $nbExist`
+    do
+        ./client exist $(( (i * 7) % (max + 20) )) > /dev/null
+    done
+    t2=$(now)
+    ./client sum > /dev/null
+    t3=$(now)
+    ./client stop > /dev/null
+    wait $masterPid
+
+    t4=$(now)
+    ./client local $loc_nbThreads 5 $loc_nb $min $max > /dev/null
+    t5=$(now)
+
+    printf "%-8s %12d %12d %12d %12d\n" $t $(ms $t0 $t1) $(ms $t1 $t2) $(ms $t2 $t3) $(ms $t4 $t5)
+done
+
+# retour au type par défaut
+make --no-print-directory > /dev/null
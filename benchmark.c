@@ -0,0 +1,456 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <sys/sem.h>
+
+#include "utils.h"
+#include "myassert.h"
+
+#include "client_master.h"
+#include "masterio.h"
+#include "routing.h"
+
+
+/************************************************************************
+ * Mesure des performances du master et des workers
+ *
+ * Le programme lance ./master, le remplit avec <nb> éléments (un seul
+ * ordre insertmany), puis mesure chaque type d'ordre sur <iter> ordres
+ * successifs, chacun dans une session complète comme le vrai client
+ * (sémaphores, ouverture des tubes, ordre, réponse, fermeture).
+ * Les résultats (p50, p95, p99, moyenne en µs et débit en ordres/s) sont
+ * affichés et ajoutés à un fichier CSV pour comparer les commits entre eux.
+ ************************************************************************/
+
+// options
+#define OPT_NB      "--nb="         // nombre d'éléments chargés
+#define OPT_MIN     "--min="        // intervalle des éléments [min,max[
+#define OPT_MAX     "--max="
+#define OPT_DIST    "--dist="       // distribution des éléments (cf. utils.h)
+#define OPT_SEED    "--seed="       // graine des tirages
+#define OPT_ITER    "--iter="       // nombre d'ordres mesurés par type
+#define OPT_OUT     "--out="        // fichier CSV (complété, créé si besoin)
+#define OPT_LABEL   "--label="      // étiquette des lignes (par exemple le commit)
+#define OPT_VERBOSE "--verbose"     // garder les affichages du master et des workers
+#define OPT_IO      "--io="         // entrées/sorties du master (cf. masterio.h)
+#define OPT_BULK    "--bulk="       // transmission des insertmany (cf. client_master.h)
+#define OPT_HANDSHAKE "--handshake=" // ordres simples : sessions ou boîte aux lettres (cf. client_master.h)
+#define OPT_ROUTE   "--route="      // routage des ordres du master (cf. routing.h)
+
+// attente maximale du démarrage du master
+#define MASTER_START_TIMEOUT 5.0
+
+
+/************************************************************************
+ * paramètres du benchmark
+ ************************************************************************/
+typedef struct {
+    int nb;
+    double min;
+    double max;
+    UtDist dist;
+    uint64_t seed;
+    int iter;
+    const char *out;
+    const char *label;
+    bool verbose;
+    const char *io;
+    int bulk;
+    int handshake;
+    int route;
+} Data;
+
+// un type d'ordre mesuré
+typedef struct {
+    const char *name;       // nom dans les résultats
+    int order;              // CM_ORDER_*
+    int expected;           // CM_ANSWER_* attendue (-1 : pas de vérification)
+} BenchOrder;
+
+// l'élément envoyé (insert, exist) dépend de la réponse attendue
+static const BenchOrder benchOrders[] = {
+    { "insert",     CM_ORDER_INSERT,   CM_ANSWER_INSERT_OK },
+    { "exist_hit",  CM_ORDER_EXIST,    CM_ANSWER_EXIST_YES },
+    { "exist_miss", CM_ORDER_EXIST,    CM_ANSWER_EXIST_NO },
+    { "min",        CM_ORDER_MINIMUM,  CM_ANSWER_MINIMUM_OK },
+    { "max",        CM_ORDER_MAXIMUM,  CM_ANSWER_MAXIMUM_OK },
+    { "sum",        CM_ORDER_SUM,      CM_ANSWER_SUM_OK },
+    { "howmany",    CM_ORDER_HOW_MANY, CM_ANSWER_HOW_MANY_OK },
+    { "print",      CM_ORDER_PRINT,    CM_ANSWER_PRINT_OK },
+    { "stats",      CM_ORDER_STATS,    CM_ANSWER_STATS_OK },
+};
+#define NB_BENCH_ORDERS ((int) (sizeof(benchOrders) / sizeof(benchOrders[0])))
+
+// résultats d'une série de mesures
+typedef struct {
+    const char *name;
+    int iterations;
+    int errors;
+    double p50;             // en secondes
+    double p95;
+    double p99;
+    double mean;
+    double throughput;      // ordres (ou éléments pour insertmany) par seconde
+} BenchResult;
+
+
+/************************************************************************
+ * Usage et analyse des arguments passés en ligne de commande
+ ************************************************************************/
+static void usage(const char *exeName, const char *message)
+{
+    fprintf(stderr, "usage : %s [options]\n", exeName);
+    fprintf(stderr, "   " OPT_NB "<nb>             éléments chargés avant les mesures (défaut 5000)\n");
+    fprintf(stderr, "   " OPT_MIN "<min> " OPT_MAX "<max>  intervalle [<min>,<max>[ des éléments (défaut [0,200[)\n");
+    fprintf(stderr, "   " OPT_DIST "<distribution>  distribution des éléments (cf. utils.h, défaut uniform)\n");
+    fprintf(stderr, "   " OPT_SEED "<graine>        graine des tirages\n");
+    fprintf(stderr, "   " OPT_ITER "<iter>          ordres mesurés par type (défaut 500)\n");
+    fprintf(stderr, "   " OPT_OUT "<fichier>        résultats CSV (défaut bench.csv, complété)\n");
+    fprintf(stderr, "   " OPT_LABEL "<étiquette>    première colonne du CSV (par exemple le commit)\n");
+    fprintf(stderr, "   " OPT_VERBOSE "           affichages du master et des workers conservés\n");
+    fprintf(stderr, "   " OPT_IO "<mode>            entrées/sorties du master : blocking ou uring (défaut blocking)\n");
+    fprintf(stderr, "   " OPT_BULK "<mode>          insertmany : element, copy ou splice (défaut splice)\n");
+    fprintf(stderr, "   " OPT_HANDSHAKE "<mode>     ordres simples : fifo ou futex (défaut fifo)\n");
+    fprintf(stderr, "   " OPT_ROUTE "<mode>         routage du master : tree ou direct (défaut tree)\n");
+    fprintf(stderr, "note : le nombre de workers créés est au plus max-min\n");
+    if (message != NULL)
+        fprintf(stderr, "message :\n    %s\n", message);
+    exit(EXIT_FAILURE);
+}
+
+static void parseArgs(int argc, char * argv[], Data *data)
+{
+    data->nb = 5000;
+    data->min = 0;
+    data->max = 200;
+    data->dist.kind = UT_DIST_UNIFORM;
+    data->dist.param = 0;
+    data->seed = ut_defaultSeed();
+    data->iter = 500;
+    data->out = "bench.csv";
+    data->label = "-";
+    data->verbose = false;
+    data->io = "blocking";
+    data->bulk = CM_BULK_SPLICE;
+    data->handshake = CM_HANDSHAKE_FIFO;
+    data->route = RT_TREE;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], OPT_NB, strlen(OPT_NB)) == 0)
+            data->nb = strtol(argv[i] + strlen(OPT_NB), NULL, 10);
+        else if (strncmp(argv[i], OPT_MIN, strlen(OPT_MIN)) == 0)
+            data->min = strtod(argv[i] + strlen(OPT_MIN), NULL);
+        else if (strncmp(argv[i], OPT_MAX, strlen(OPT_MAX)) == 0)
+            data->max = strtod(argv[i] + strlen(OPT_MAX), NULL);
+        else if (strncmp(argv[i], OPT_DIST, strlen(OPT_DIST)) == 0)
+        {
+            if (! ut_parseDist(argv[i] + strlen(OPT_DIST), &(data->dist)))
+                usage(argv[0], OPT_DIST " : distribution inconnue");
+        }
+        else if (strncmp(argv[i], OPT_SEED, strlen(OPT_SEED)) == 0)
+            data->seed = strtoull(argv[i] + strlen(OPT_SEED), NULL, 10);
+        else if (strncmp(argv[i], OPT_ITER, strlen(OPT_ITER)) == 0)
+            data->iter = strtol(argv[i] + strlen(OPT_ITER), NULL, 10);
+        else if (strncmp(argv[i], OPT_OUT, strlen(OPT_OUT)) == 0)
+            data->out = argv[i] + strlen(OPT_OUT);
+        else if (strncmp(argv[i], OPT_LABEL, strlen(OPT_LABEL)) == 0)
+        {
+            data->label = argv[i] + strlen(OPT_LABEL);
+            if (data->label[0] == '\0')
+                data->label = "-";
+        }
+        else if (strcmp(argv[i], OPT_VERBOSE) == 0)
+            data->verbose = true;
+        else if (strncmp(argv[i], OPT_IO, strlen(OPT_IO)) == 0)
+            data->io = argv[i] + strlen(OPT_IO);
+        else if (strncmp(argv[i], OPT_BULK, strlen(OPT_BULK)) == 0)
+        {
+            const char *name = argv[i] + strlen(OPT_BULK);
+            data->bulk = -1;
+            for (int mode = CM_BULK_ELEMENT; mode <= CM_BULK_SPLICE; mode++)
+                if (strcmp(name, cm_bulkName(mode)) == 0)
+                    data->bulk = mode;
+            if (data->bulk == -1)
+                usage(argv[0], OPT_BULK " : mode inconnu");
+        }
+        else if (strncmp(argv[i], OPT_HANDSHAKE, strlen(OPT_HANDSHAKE)) == 0)
+        {
+            const char *name = argv[i] + strlen(OPT_HANDSHAKE);
+            data->handshake = -1;
+            for (int mode = CM_HANDSHAKE_FIFO; mode <= CM_HANDSHAKE_FUTEX; mode++)
+                if (strcmp(name, cm_handshakeName(mode)) == 0)
+                    data->handshake = mode;
+            if (data->handshake == -1)
+                usage(argv[0], OPT_HANDSHAKE " : mode inconnu");
+        }
+        else if (strncmp(argv[i], OPT_ROUTE, strlen(OPT_ROUTE)) == 0)
+        {
+            const char *name = argv[i] + strlen(OPT_ROUTE);
+            data->route = -1;
+            for (int mode = RT_TREE; mode <= RT_DIRECT; mode++)
+                if (strcmp(name, rt_name(mode)) == 0)
+                    data->route = mode;
+            if (data->route == -1)
+                usage(argv[0], OPT_ROUTE " : mode inconnu");
+        }
+        else
+            usage(argv[0], "option inconnue");
+    }
+
+    if (data->nb < 1)
+        usage(argv[0], OPT_NB " : nb doit être strictement positif");
+    if (data->max <= data->min)
+        usage(argv[0], OPT_MAX " : max doit être strictement supérieur à min");
+    if (data->iter < 1)
+        usage(argv[0], OPT_ITER " : iter doit être strictement positif");
+    if ((strcmp(data->io, "blocking") != 0) && (strcmp(data->io, "uring") != 0))
+        usage(argv[0], OPT_IO " : mode inconnu");
+}
+
+
+/************************************************************************
+ * lancement du master
+ ************************************************************************/
+static bool isFifo(const char *name)
+{
+    struct stat st;
+    return (stat(name, &st) == 0) && S_ISFIFO(st.st_mode);
+}
+
+// lance ./master et attend qu'il ait créé sémaphores et tubes nommés
+static pid_t startMaster(bool verbose, const char *io)
+{
+    myassert(semget(KEY1, 1, 0) == -1, "un master tourne déjà (cf. rmsempipe.sh)");
+
+    pid_t pid = fork();
+    myassert(pid != -1, "echec fork du master");
+    if (pid == 0)
+    {
+        if (! verbose)
+        {
+            int fd = open("/dev/null", O_WRONLY);
+            myassert(fd != -1, "echec ouverture /dev/null");
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+        setenv(MIO_ENV_MODE, io, 1);
+        execl("./master", "./master", NULL);
+        myassert(false, "echec lancement ./master");
+    }
+
+    // le sémaphore 2 vaut 0 tant que le master ne l'a pas initialisé :
+    // la première session attendra si besoin
+    // (noms de l'espace MWC_SHARD, hérité par le master)
+    char pipe1[CM_NAME_MAX], pipe2[CM_NAME_MAX], mailboxName[CM_NAME_MAX];
+    cm_name(pipe1, CM_PIPE_CLIENT_TO_MASTER, cm_namespace());
+    cm_name(pipe2, CM_PIPE_MASTER_TO_CLIENT, cm_namespace());
+    cm_name(mailboxName, CM_MAILBOX, cm_namespace());
+    double t0 = ut_getTime();
+    while ((semget(KEY2, 1, 0) == -1) || ! isFifo(pipe1) || ! isFifo(pipe2)
+           || (access(mailboxName, F_OK) != 0))
+    {
+        myassert(waitpid(pid, NULL, WNOHANG) == 0, "le master s'est arrêté au démarrage");
+        myassert(ut_getTime() - t0 < MASTER_START_TIMEOUT, "le master ne démarre pas");
+        struct timespec delay = { 0, 1000000 };
+        nanosleep(&delay, NULL);
+    }
+    return pid;
+}
+
+
+/************************************************************************
+ * mesures
+ ************************************************************************/
+// boîte aux lettres du master (mode --handshake=futex, sinon NULL)
+static CmMailbox *mailbox = NULL;
+
+// un ordre dans une session complète, ou par la boîte aux lettres pour les
+// ordres simples en mode futex, comme le client ; retourne la durée
+static double timeOrder(int order, elt_t elt, const elt_t *tab, int nb, CmAnswer *answer)
+{
+    double t0 = ut_getTime();
+    if ((mailbox != NULL) && cm_mailboxSupports(order))
+    {
+        cm_mailboxOrder(mailbox, order, elt, answer);
+        return ut_getTime() - t0;
+    }
+    CmSession session;
+    cm_openSession(&session);
+    cm_sendOrder(&session, order, elt, tab, nb);
+    cm_receiveAnswer(&session, answer);
+    cm_closeSession(&session, order);
+    double t = ut_getTime() - t0;
+    cm_freeAnswer(answer);
+    return t;
+}
+
+static int compareDouble(const void *a, const void *b)
+{
+    double x = *((const double *) a);
+    double y = *((const double *) b);
+    return (x > y) - (x < y);
+}
+
+// percentile (rang le plus proche) d'un tableau trié
+static double percentile(const double *sorted, int n, double p)
+{
+    int rank = (int) ceil(p * n);
+    if (rank < 1)
+        rank = 1;
+    return sorted[rank - 1];
+}
+
+// statistiques de n durées (le tableau est trié au passage)
+static void summarize(BenchResult *result, double *times, int n, double total)
+{
+    qsort(times, n, sizeof(double), compareDouble);
+    double sum = 0;
+    for (int i = 0; i < n; i++)
+        sum += times[i];
+    result->iterations = n;
+    result->p50 = percentile(times, n, 0.50);
+    result->p95 = percentile(times, n, 0.95);
+    result->p99 = percentile(times, n, 0.99);
+    result->mean = sum / n;
+    result->throughput = n / total;
+}
+
+// <iter> ordres d'un même type
+static void benchOrder(const Data *data, const BenchOrder *bo, const elt_t *loaded, UtRng *rng, BenchResult *result)
+{
+    double *times = malloc(data->iter * sizeof(double));
+    myassert(times != NULL, "echec allocation des mesures");
+    result->name = bo->name;
+    result->errors = 0;
+
+    double t0 = ut_getTime();
+    for (int i = 0; i < data->iter; i++)
+    {
+        // élément envoyé : valeur de l'intervalle (insert), valeur chargée
+        // (exist_hit), ou valeur au-delà de max, jamais insérée (exist_miss)
+        elt_t elt = 0;
+        if (bo->expected == CM_ANSWER_INSERT_OK)
+            elt = ELT_FROM_REAL(ut_rngReal(rng, data->min, data->max, 0));
+        else if (bo->expected == CM_ANSWER_EXIST_YES)
+            elt = loaded[ut_rngNext(rng) % data->nb];
+        else if (bo->expected == CM_ANSWER_EXIST_NO)
+            elt = ELT_FROM_REAL(ceil(data->max) + 1 + (ut_rngNext(rng) % 1000));
+
+        CmAnswer answer;
+        times[i] = timeOrder(bo->order, elt, NULL, 0, &answer);
+        if ((bo->expected != -1) && (answer.code != bo->expected))
+            result->errors++;
+    }
+    summarize(result, times, data->iter, ut_getTime() - t0);
+    free(times);
+}
+
+// une seule mesure (insertmany, stop) ; <nb> : débit exprimé en éléments
+static void benchSingle(const char *name, double t, int nb, bool error, BenchResult *result)
+{
+    result->name = name;
+    result->errors = error ? 1 : 0;
+    summarize(result, &t, 1, t);
+    result->throughput = nb / t;
+}
+
+
+/************************************************************************
+ * résultats
+ ************************************************************************/
+static void printResults(const BenchResult *results, int n)
+{
+    printf("%-12s %8s %7s %10s %10s %10s %10s %12s\n", "ordre", "mesures", "erreurs",
+           "p50(µs)", "p95(µs)", "p99(µs)", "moy.(µs)", "débit(/s)");
+    for (int i = 0; i < n; i++)
+        printf("%-12s %8d %7d %10.1f %10.1f %10.1f %10.1f %12.1f\n", results[i].name,
+               results[i].iterations, results[i].errors, results[i].p50 * 1e6, results[i].p95 * 1e6,
+               results[i].p99 * 1e6, results[i].mean * 1e6, results[i].throughput);
+}
+
+// ajout au fichier CSV (en-tête si le fichier est vide)
+static void writeResults(const Data *data, const BenchResult *results, int n)
+{
+    FILE *f = fopen(data->out, "a");
+    myassert(f != NULL, "echec ouverture du fichier de résultats");
+    if (ftell(f) == 0)
+        fprintf(f, "label,elt,io,bulk,handshake,route,nb,dist,order,iterations,errors,p50_us,p95_us,p99_us,mean_us,ops_per_s\n");
+    for (int i = 0; i < n; i++)
+        fprintf(f, "%s,%s,%s,%s,%s,%s,%d,%s,%s,%d,%d,%.3f,%.3f,%.3f,%.3f,%.1f\n", data->label, ELT_NAME, data->io,
+                cm_bulkName(data->bulk), cm_handshakeName(data->handshake), rt_name(data->route),
+                data->nb, ut_distName(data->dist.kind), results[i].name, results[i].iterations,
+                results[i].errors, results[i].p50 * 1e6, results[i].p95 * 1e6, results[i].p99 * 1e6,
+                results[i].mean * 1e6, results[i].throughput);
+    int ret = fclose(f);
+    myassert(ret == 0, "echec fermeture du fichier de résultats");
+    printf("résultats ajoutés à %s\n", data->out);
+}
+
+
+/************************************************************************
+ * Fonction principale
+ ************************************************************************/
+int main(int argc, char * argv[])
+{
+    Data data;
+    parseArgs(argc, argv, &data);
+    // même mode pour nos envois et pour le master
+    setenv(CM_ENV_BULK, cm_bulkName(data.bulk), 1);
+    setenv(RT_ENV_MODE, rt_name(data.route), 1);
+
+    // insertmany + chaque type d'ordre + stop
+    BenchResult results[NB_BENCH_ORDERS + 2];
+    int nbResults = 0;
+    CmAnswer answer;
+    UtRng rng;
+    ut_rngInit(&rng, data.seed, 1);
+
+    pid_t masterPid = startMaster(data.verbose, data.io);
+    if (data.handshake == CM_HANDSHAKE_FUTEX)
+        mailbox = cm_mailboxAttach();
+    printf("master lancé (pid %d, entrées/sorties %s, insertmany %s, ordres simples %s, routage %s), éléments "
+           ELT_NAME ", %d ordres par type\n", (int) masterPid, data.io, cm_bulkName(data.bulk),
+           cm_handshakeName(data.handshake), rt_name(data.route), data.iter);
+
+    // chargement
+    elt_t *loaded = ut_generateDist(&(data.dist), data.nb, data.min, data.max, 0, data.seed, 1);
+    double t = timeOrder(CM_ORDER_INSERT_MANY, 0, loaded, data.nb, &answer);
+    benchSingle("insertmany", t, data.nb, answer.code != CM_ANSWER_INSERT_MANY_OK, &(results[nbResults++]));
+    printf("chargement : %d éléments (%s) dans [%g,%g[ en %.3f ms\n", data.nb,
+           ut_distName(data.dist.kind), data.min, data.max, t * 1e3);
+
+    for (int i = 0; i < NB_BENCH_ORDERS; i++)
+        benchOrder(&data, &(benchOrders[i]), loaded, &rng, &(results[nbResults++]));
+
+    if (mailbox != NULL)
+        cm_mailboxDetach(mailbox);
+
+    // arrêt : mesuré une seule fois, puis attente de la fin du master
+    t = timeOrder(CM_ORDER_STOP, 0, NULL, 0, &answer);
+    benchSingle("stop", t, 1, answer.code != CM_ANSWER_STOP_OK, &(results[nbResults++]));
+    int status;
+    pid_t ret = waitpid(masterPid, &status, 0);
+    myassert(ret == masterPid, "echec attente de la fin du master");
+
+    printResults(results, nbResults);
+    writeResults(&data, results, nbResults);
+
+    free(loaded);
+    return EXIT_SUCCESS;
+}
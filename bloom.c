@@ -0,0 +1,114 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "myassert.h"
+
+#include "bloom.h"
+
+// ln(2) (M_LN2 n'est pas défini en C99 strict)
+#define LN2     0.69314718055994530942
+
+
+/************************************************************************
+ * paramètres
+ ************************************************************************/
+bool bf_parse(const char *spec, uint64_t *capacity, double *fpRate)
+{
+    if ((spec == NULL) || (spec[0] == '\0'))
+        return false;
+    char *end;
+    long long n = strtoll(spec, &end, 10);
+    double p = BF_DEFAULT_FP;
+    if (*end == ':')
+        p = strtod(end + 1, &end);
+    if ((*end != '\0') || (n < 1) || (p <= 0) || (p >= 1))
+        return false;
+    *capacity = (uint64_t) n;
+    *fpRate = p;
+    return true;
+}
+
+void bf_init(BloomFilter *bf, uint64_t capacity, double fpRate)
+{
+    myassert(capacity > 0, "capacité du filtre incorrecte");
+    myassert((fpRate > 0) && (fpRate < 1), "taux de faux positifs incorrect");
+
+    double m = -((double) capacity) * log(fpRate) / (LN2 * LN2);
+    bf->nbBits = ((uint64_t) ceil(m) + 63) & ~((uint64_t) 63);
+    bf->nbHashes = (int) lround(m / capacity * LN2);
+    if (bf->nbHashes < 1)
+        bf->nbHashes = 1;
+    bf->bits = calloc(bf->nbBits / 64, sizeof(uint64_t));
+    myassert(bf->bits != NULL, "echec allocation du filtre");
+    bf->capacity = capacity;
+    bf->targetFp = fpRate;
+}
+
+void bf_end(BloomFilter *bf)
+{
+    free(bf->bits);
+    bf->bits = NULL;
+    bf->nbBits = 0;
+}
+
+
+/************************************************************************
+ * hachage
+ ************************************************************************/
+// deux hachages indépendants de l'élément (h2 impair : tous les bits sont
+// atteignables)
+static void hashes(elt_t elt, uint64_t *h1, uint64_t *h2)
+{
+    *h1 = elt_hash(elt);
+    *h2 = elt_mix(*h1 ^ 0x5851f42d4c957f2dULL) | 1;
+}
+
+
+/************************************************************************
+ * ajout et test
+ ************************************************************************/
+void bf_add(BloomFilter *bf, elt_t elt)
+{
+    uint64_t h1, h2;
+    hashes(elt, &h1, &h2);
+    for (int i = 0; i < bf->nbHashes; i++)
+    {
+        uint64_t bit = (h1 + i * h2) % bf->nbBits;
+        bf->bits[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+bool bf_mayContain(const BloomFilter *bf, elt_t elt)
+{
+    uint64_t h1, h2;
+    hashes(elt, &h1, &h2);
+    for (int i = 0; i < bf->nbHashes; i++)
+    {
+        uint64_t bit = (h1 + i * h2) % bf->nbBits;
+        if (! (bf->bits[bit / 64] & (1ULL << (bit % 64))))
+            return false;
+    }
+    return true;
+}
+
+
+/************************************************************************
+ * mesures
+ ************************************************************************/
+size_t bf_bytes(const BloomFilter *bf)
+{
+    return bf->nbBits / 8;
+}
+
+double bf_estimatedFp(const BloomFilter *bf)
+{
+    uint64_t nbSet = 0;
+    for (uint64_t i = 0; i < bf->nbBits / 64; i++)
+        nbSet += __builtin_popcountll(bf->bits[i]);
+    return pow((double) nbSet / bf->nbBits, bf->nbHashes);
+}
@@ -0,0 +1,50 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "element.h"
+
+/******************************************
+ * filtre de Bloom des éléments insérés
+ ******************************************/
+// Mode optionnel du master (variable d'environnement MWC_BLOOM) :
+//    MWC_BLOOM=<nbElements>[:<tauxFauxPositifs>]   (taux par défaut 0.01)
+// Le filtre est dimensionné pour <nbElements> éléments distincts au taux
+// de faux positifs demandé : m = -n.ln(p)/ln(2)^2 bits et k = m/n.ln(2)
+// fonctions de hachage (double hachage h1 + i.h2). Au-delà de <nbElements>
+// le filtre reste correct, seul le taux de faux positifs augmente.
+// Un exist dont l'élément n'est pas dans le filtre est répondu absent par
+// le master sans interroger les workers ; un élément présent dans le filtre
+// passe par les workers comme avant (réponse exacte).
+
+#define BF_ENV_MODE     "MWC_BLOOM"
+#define BF_DEFAULT_FP   0.01
+
+typedef struct {
+    uint64_t nbBits;
+    int nbHashes;
+    uint64_t *bits;
+    uint64_t capacity;      // nombre d'éléments distincts prévu
+    double targetFp;        // taux de faux positifs visé à cette capacité
+} BloomFilter;
+
+// lecture de MWC_BLOOM ; false si le mode n'est pas demandé ou incorrect
+bool bf_parse(const char *spec, uint64_t *capacity, double *fpRate);
+
+void bf_init(BloomFilter *bf, uint64_t capacity, double fpRate);
+void bf_end(BloomFilter *bf);
+
+void bf_add(BloomFilter *bf, elt_t elt);
+// false : l'élément n'a jamais été ajouté (true : peut-être)
+bool bf_mayContain(const BloomFilter *bf, elt_t elt);
+
+// mémoire occupée par les bits
+size_t bf_bytes(const BloomFilter *bf);
+// taux de faux positifs estimé d'après la proportion de bits à 1
+// (parcours complet du filtre)
+double bf_estimatedFp(const BloomFilter *bf);
+
+#endif
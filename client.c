@@ -2,6 +2,8 @@
 #include "config.h"
 #endif
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -12,12 +14,14 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <fcntl.h>
-#include <sys/sem.h>
+#include <sys/mman.h>
 
 #include "utils.h"
 #include "myassert.h"
+#include "count.h"
 
 #include "client_master.h"
+#include "trace.h"
 
 
 /************************************************************************
@@ -33,6 +37,24 @@
 #define TK_INSERT_MANY "insertmany"       // insertions de plusieurs éléments aléatoires
 #define TK_PRINT       "print"            // debug : demande aux master/workers d'afficher les éléments
 #define TK_LOCAL       "local"            // lancer un calcul local (sans master) en multi-thread
+#define TK_STATS       "stats"            // statistiques des ordres traités par le master
+#define TK_TREESTATS   "treestats"        // forme de l'arbre des workers (profondeur, mémoire, ...)
+
+// options (n'importe où après la commande)
+#define TK_OPT_BENCH   "--bench"          // local : mesure pour 1, 2, 4, ..., nbThreads threads
+#define TK_OPT_SEED    "--seed="          // insertmany, local : graine des tirages aléatoires
+#define TK_OPT_DIST    "--dist="          // insertmany, local : distribution des tirages aléatoires
+#define TK_OPT_HISTO   "--histo"          // local : table de fréquences (--histo ou --histo=<nbClasses>)
+#define TK_OPT_WINDOW  "--window="        // local (fichier) : lecture par fenêtres de <Mo> par thread
+#define TK_OPT_SAVE    "--save="          // local : sauvegarde du tableau généré dans un fichier
+#define TK_OPT_SET     "-s"               // ensemble visé du master (-s <ensemble>)
+
+// nombre de classes par défaut maximal (une par valeur entière de [min,max[)
+#define HISTO_MAX_BINS (1L << 24)
+
+// taille par défaut (en Mo) des fenêtres de lecture d'un fichier trop gros
+// pour être projeté en entier
+#define FILE_WINDOW_MB 64
 
 
 /************************************************************************
@@ -43,15 +65,22 @@
  ************************************************************************/
 typedef struct {
     // communication avec le master
-    int fdMasterToClient;
-    int fdClientToMaster;
+    CmSession session;
     // infos pour le travail à faire (récupérées sur la ligne de commande)
     int order;     // ordre de l'utilisateur (cf. CM_ORDER_* dans client_master.h)
-    float elt;     // pour CM_ORDER_EXIST, CM_ORDER_INSERT, CM_ORDER_LOCAL
-    int nb;        // pour CM_ORDER_INSERT_MANY, CM_ORDER_LOCAL
-    float min;     // pour CM_ORDER_INSERT_MANY, CM_ORDER_LOCAL
-    float max;     // pour CM_ORDER_INSERT_MANY, CM_ORDER_LOCAL
+    int set;       // ensemble visé (option -s, cf. CM_SET_DEFAULT)
+    elt_t elt;     // pour CM_ORDER_EXIST, CM_ORDER_INSERT, CM_ORDER_LOCAL
+    long nb;       // pour CM_ORDER_INSERT_MANY, CM_ORDER_LOCAL
+    double min;    // pour CM_ORDER_INSERT_MANY, CM_ORDER_LOCAL
+    double max;    // pour CM_ORDER_INSERT_MANY, CM_ORDER_LOCAL
     int nbThreads; // pour CM_ORDER_LOCAL
+    bool bench;    // pour CM_ORDER_LOCAL : option --bench
+    uint64_t seed; // pour CM_ORDER_INSERT_MANY, CM_ORDER_LOCAL : option --seed
+    UtDist dist;   // pour CM_ORDER_INSERT_MANY, CM_ORDER_LOCAL : option --dist
+    long nbBins;   // pour CM_ORDER_LOCAL : option --histo (0 si pas de table de fréquences)
+    const char *file;   // pour CM_ORDER_LOCAL : fichier d'éléments (NULL si tableau généré)
+    long windowMB;      // pour CM_ORDER_LOCAL : option --window (0 : choix automatique)
+    const char *save;   // pour CM_ORDER_LOCAL : option --save (NULL si pas de sauvegarde)
 } Data;
 
 /************************************************************************
@@ -60,6 +89,7 @@ typedef struct {
 static void usage(const char *exeName, const char *message)
 {
     fprintf(stderr, "usages : %s <ordre> [[[<param1>] [<param2>] ...]]\n", exeName);
+    fprintf(stderr, "   (éléments de type " ELT_NAME ")\n");
     fprintf(stderr, "   $ %s " TK_STOP "\n", exeName);
     fprintf(stderr, "          arrêt master\n");
     fprintf(stderr, "   $ %s " TK_HOW_MANY "\n", exeName);
@@ -78,9 +108,37 @@ static void usage(const char *exeName, const char *message)
     fprintf(stderr, "          ajout de <nb> élements (dans [<min>,<max>[) aléatoires dans l'ensemble\n");
     fprintf(stderr, "   $ %s " TK_PRINT "\n", exeName);
     fprintf(stderr, "          affichage trié (dans la console du master)\n");
+    fprintf(stderr, "   $ %s " TK_STATS "\n", exeName);
+    fprintf(stderr, "          nombre, réponses négatives, erreurs et latences des ordres traités par le master\n");
+    fprintf(stderr, "   $ %s " TK_TREESTATS "\n", exeName);
+    fprintf(stderr, "          profondeur, équilibre, mémoire et descripteurs de l'arbre des workers\n");
     fprintf(stderr, "   $ %s " TK_LOCAL " <nbThreads> <elt> <nb> <min> <max>\n", exeName);
     fprintf(stderr, "          combien d'exemplaires de <elt> dans <nb> éléments (dans [<min>,<max>[)\n"
                     "          aléatoires avec <nbThreads> threads\n");
+    fprintf(stderr, "   $ %s " TK_LOCAL " <nbThreads> <elt> <fichier>\n", exeName);
+    fprintf(stderr, "          combien d'exemplaires de <elt> dans le <fichier> (éléments " ELT_NAME "\n"
+                    "          bruts, cf. " TK_OPT_SAVE ") avec <nbThreads> threads\n");
+    fprintf(stderr, "options :\n");
+    fprintf(stderr, "   " TK_OPT_BENCH "\n");
+    fprintf(stderr, "          " TK_LOCAL " : mesure du temps, de l'accélération et de l'efficacité\n"
+                    "          pour 1, 2, 4, ..., <nbThreads> threads\n");
+    fprintf(stderr, "   " TK_OPT_SEED "<graine>\n");
+    fprintf(stderr, "          " TK_INSERT_MANY ", " TK_LOCAL " : tirages reproductibles (quel que soit\n"
+                    "          le nombre de threads)\n");
+    fprintf(stderr, "   " TK_OPT_DIST "<distribution>[:<paramètre>]\n");
+    fprintf(stderr, "          " TK_INSERT_MANY ", " TK_LOCAL " : distribution des tirages (cf. utils.h)\n"
+                    "          uniform (défaut), zipf[:s], normal, sorted, reverse, nearly[:p], few[:k]\n");
+    fprintf(stderr, "   " TK_OPT_HISTO "[=<nbClasses>]\n");
+    fprintf(stderr, "          " TK_LOCAL " : table de fréquences des <nb> éléments en <nbClasses> classes\n"
+                    "          de même largeur sur [<min>,<max>[ (défaut : une classe par valeur entière)\n");
+    fprintf(stderr, "   " TK_OPT_WINDOW "<Mo>\n");
+    fprintf(stderr, "          " TK_LOCAL " <fichier> : lecture par fenêtres de <Mo> par thread au lieu\n"
+                    "          d'une projection complète (automatique si le fichier dépasse la moitié de la RAM)\n");
+    fprintf(stderr, "   " TK_OPT_SAVE "<fichier>\n");
+    fprintf(stderr, "          " TK_LOCAL " : sauvegarde des <nb> éléments générés dans <fichier>\n");
+    fprintf(stderr, "   " TK_OPT_SET " <ensemble>\n");
+    fprintf(stderr, "          ordres du master : ensemble visé, de 0 (défaut) à %d ; " TK_STOP ", " TK_STATS "\n"
+                    "          et " TK_TREESTATS " concernent tout le master\n", CM_MAX_SETS - 1);
 
     if (message != NULL)
         fprintf(stderr, "message :\n    %s\n", message);
@@ -92,10 +150,71 @@ static void usage(const char *exeName, const char *message)
 /************************************************************************
  * Analyse des arguments passés en ligne de commande
  ************************************************************************/
+// retire les options (--xxx) de argv et retourne le nouveau argc
+static int parseOptions(int argc, char * argv[], Data *data)
+{
+    data->bench = false;
+    data->seed = ut_defaultSeed();
+    data->dist.kind = UT_DIST_UNIFORM;
+    data->dist.param = 0;
+    data->nbBins = 0;
+    data->file = NULL;
+    data->windowMB = 0;
+    data->save = NULL;
+    data->set = CM_SET_DEFAULT;
+
+    int newArgc = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], TK_OPT_SET) == 0)
+        {
+            char *end = NULL;
+            long set = (i + 1 < argc) ? strtol(argv[i + 1], &end, 10) : -1;
+            if ((end == NULL) || (end == argv[i + 1]) || (*end != '\0') || (set < 0) || (set >= CM_MAX_SETS))
+                usage(argv[0], TK_OPT_SET " : numéro d'ensemble incorrect");
+            data->set = (int) set;
+            i++;
+        }
+        else if (strncmp(argv[i], "--", 2) != 0)
+            argv[newArgc++] = argv[i];
+        else if (strcmp(argv[i], TK_OPT_BENCH) == 0)
+            data->bench = true;
+        else if (strncmp(argv[i], TK_OPT_SEED, strlen(TK_OPT_SEED)) == 0)
+            data->seed = strtoull(argv[i] + strlen(TK_OPT_SEED), NULL, 10);
+        else if (strcmp(argv[i], TK_OPT_HISTO) == 0)
+            data->nbBins = -1;      // calculé quand min et max seront connus
+        else if (strncmp(argv[i], TK_OPT_HISTO "=", strlen(TK_OPT_HISTO "=")) == 0)
+        {
+            data->nbBins = strtol(argv[i] + strlen(TK_OPT_HISTO "="), NULL, 10);
+            if (data->nbBins < 1)
+                usage(argv[0], TK_OPT_HISTO " : le nombre de classes doit être strictement positif");
+        }
+        else if (strncmp(argv[i], TK_OPT_WINDOW, strlen(TK_OPT_WINDOW)) == 0)
+        {
+            data->windowMB = strtol(argv[i] + strlen(TK_OPT_WINDOW), NULL, 10);
+            if (data->windowMB < 1)
+                usage(argv[0], TK_OPT_WINDOW " : la taille des fenêtres doit être strictement positive");
+        }
+        else if (strncmp(argv[i], TK_OPT_SAVE, strlen(TK_OPT_SAVE)) == 0)
+            data->save = argv[i] + strlen(TK_OPT_SAVE);
+        else if (strncmp(argv[i], TK_OPT_DIST, strlen(TK_OPT_DIST)) == 0)
+        {
+            if (! ut_parseDist(argv[i] + strlen(TK_OPT_DIST), &(data->dist)))
+                usage(argv[0], TK_OPT_DIST " : distribution inconnue");
+        }
+        else
+            usage(argv[0], "option inconnue");
+    }
+    argv[newArgc] = NULL;
+    return newArgc;
+}
+
 static void parseArgs(int argc, char * argv[], Data *data)
 {
     data->order = CM_ORDER_NONE;
 
+    argc = parseOptions(argc, argv, data);
+
     if (argc == 1)
         usage(argv[0], "Il faut préciser une commande");
 
@@ -120,6 +239,10 @@ static void parseArgs(int argc, char * argv[], Data *data)
         data->order = CM_ORDER_PRINT;
     else if (strcmp(argv[1], TK_LOCAL) == 0)
         data->order = CM_ORDER_LOCAL;
+    else if (strcmp(argv[1], TK_STATS) == 0)
+        data->order = CM_ORDER_STATS;
+    else if (strcmp(argv[1], TK_TREESTATS) == 0)
+        data->order = CM_ORDER_TREESTATS;
     else
         usage(argv[0], "commande inconnue");
 
@@ -142,142 +265,614 @@ static void parseArgs(int argc, char * argv[], Data *data)
         usage(argv[0], TK_INSERT_MANY " : il faut 3 arguments après la commande");
     if ((data->order == CM_ORDER_PRINT) && (argc != 2))
         usage(argv[0], TK_PRINT " : il ne faut pas d'argument après la commande");
-    if ((data->order == CM_ORDER_LOCAL) && (argc != 7))
-        usage(argv[0], TK_LOCAL " : il faut 5 arguments après la commande");
+    if ((data->order == CM_ORDER_STATS) && (argc != 2))
+        usage(argv[0], TK_STATS " : il ne faut pas d'argument après la commande");
+    if ((data->order == CM_ORDER_TREESTATS) && (argc != 2))
+        usage(argv[0], TK_TREESTATS " : il ne faut pas d'argument après la commande");
+    if ((data->order == CM_ORDER_LOCAL) && (argc != 7) && (argc != 5))
+        usage(argv[0], TK_LOCAL " : il faut 5 arguments (ou 3 avec un fichier) après la commande");
 
     // extraction des arguments
     if (data->order == CM_ORDER_EXIST)
     {
-        data->elt = strtof(argv[2], NULL);
+        if (! elt_parse(argv[2], &(data->elt)))
+            usage(argv[0], TK_EXIST " : élément incorrect (type " ELT_NAME ")");
     }
     else if (data->order == CM_ORDER_INSERT)
     {
-        data->elt = strtof(argv[2], NULL);
+        if (! elt_parse(argv[2], &(data->elt)))
+            usage(argv[0], TK_INSERT " : élément incorrect (type " ELT_NAME ")");
     }
     else if (data->order == CM_ORDER_INSERT_MANY)
     {
         data->nb = strtol(argv[2], NULL, 10);
-        data->min = strtof(argv[3], NULL);
-        data->max = strtof(argv[4], NULL);
+        data->min = strtod(argv[3], NULL);
+        data->max = strtod(argv[4], NULL);
         if (data->nb < 1)
             usage(argv[0], TK_INSERT_MANY " : nb doit être strictement positif");
         if (data->max < data->min)
             usage(argv[0], TK_INSERT_MANY " : max ne doit pas être inférieur à min");
     }
+    else if ((data->order == CM_ORDER_LOCAL) && (argc == 5))
+    {
+        data->nbThreads = strtol(argv[2], NULL, 10);
+        if (! elt_parse(argv[3], &(data->elt)))
+            usage(argv[0], TK_LOCAL " : élément incorrect (type " ELT_NAME ")");
+        data->file = argv[4];
+        if (data->nbThreads < 1)
+            usage(argv[0], TK_LOCAL " : nbThreads doit être strictement positif");
+        if (data->nbBins != 0)
+            usage(argv[0], TK_OPT_HISTO " : pas disponible avec un fichier");
+        if (data->save != NULL)
+            usage(argv[0], TK_OPT_SAVE " : pas disponible avec un fichier");
+    }
     else if (data->order == CM_ORDER_LOCAL)
     {
         data->nbThreads = strtol(argv[2], NULL, 10);
-        data->elt = strtof(argv[3], NULL);
+        if (! elt_parse(argv[3], &(data->elt)))
+            usage(argv[0], TK_LOCAL " : élément incorrect (type " ELT_NAME ")");
         data->nb = strtol(argv[4], NULL, 10);
-        data->min = strtof(argv[5], NULL);
-        data->max = strtof(argv[6], NULL);
+        data->min = strtod(argv[5], NULL);
+        data->max = strtod(argv[6], NULL);
         if (data->nbThreads < 1)
             usage(argv[0], TK_LOCAL " : nbThreads doit être strictement positif");
         if (data->nb < 1)
             usage(argv[0], TK_LOCAL " : nb doit être strictement positif");
         if (data->max <= data->min)
             usage(argv[0], TK_LOCAL " : max ne doit être strictement supérieur à min");
+        if (data->windowMB != 0)
+            usage(argv[0], TK_OPT_WINDOW " : uniquement avec un fichier");
+        if (data->nbBins == -1)
+        {
+            data->nbBins = (long) ceil(data->max - data->min);
+            if (data->nbBins > HISTO_MAX_BINS)
+                usage(argv[0], TK_OPT_HISTO " : intervalle trop grand, préciser le nombre de classes");
+        }
     }
 }
 
 /************************************************************************
  * Partie multi-thread
  ************************************************************************/
+// taille d'une ligne de cache : chaque compteur de thread occupe sa propre
+// ligne pour éviter le faux partage entre coeurs
+#define CACHE_LINE 64
+
+// nombre de répétitions de chaque mesure en mode --bench (on garde la meilleure)
+#define BENCH_REPEAT 5
+
+//Un compteur par thread, aligné et rembourré sur une ligne de cache
+typedef struct {
+    long count;
+    char pad[CACHE_LINE - sizeof(long)];
+} PaddedCounter;
+
 //Une structure pour les arguments à passer à un thread (aucune variable globale autorisée)
 typedef struct {
-    int val;
-    float* mytab;
-    int *result;
-    int debut ;
-    int fin ;
-    pthread_mutex_t myMutex ;
+    elt_t val;
+    const elt_t *mytab;
+    long debut;                 // premier indice traité (inclus)
+    long fin;                   // dernier indice traité (exclu)
+    PaddedCounter *counter;     // compteur privé du thread
 } threadData ;
 
 void * thread_function(void * arg){
 
     threadData *data = (threadData*)arg; 
-    for (int i = data->debut; i<=data->fin; i++){
-        if(data->val==data->mytab[i]){
-            pthread_mutex_lock(&data->myMutex);
-            (*(data->result))++;
-            pthread_mutex_unlock(&data->myMutex);
-        }
-    }
-    free(arg); 
+    //comptage vectorisé du bloc, écrit une seule fois à la fin
+    data->counter->count = cnt_countEqual(data->mytab + data->debut, data->fin - data->debut, data->val);
     return NULL;
 }
 
-void lauchThreads(const Data *data)
+//début du bloc du thread i : nb*i/nbThreads, reculé pour que le bloc
+//commence sur une page (deux threads ne partagent ni page ni ligne de
+//cache, et les blocs d'un fichier projeté tombent sur des pages entières)
+static long chunkStart(const elt_t *tab, long nb, int i, int nbThreads)
 {
-    //variables nécessaires
-    int result = 0;
-    float * tab = ut_generateTab(data->nb, data->min, data->max, 0);
-    int pasTableau = data->nb-1/data->nbThreads; //-1 car on commence les indices a 0
-    int resteTableau = data->nb-1%data->nbThreads;
-    int val = data->elt;
-    pthread_t pthreadTab[data->nbThreads]; //tableau d'identifiant de thread
+    if (i == 0)
+        return 0;
+    if (i == nbThreads)
+        return nb;
+    long start = (long) ((long long) nb * i / nbThreads);
+    long shift = ((uintptr_t) (tab + start) % sysconf(_SC_PAGESIZE)) / sizeof(elt_t);
+    return (shift <= start) ? start - shift : 0;
+}
 
-    //création mutex
-    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+//compte les exemplaires de val dans tab[0..nb[ avec nbThreads threads :
+//chaque thread traite un bloc contigu de taille nb/nbThreads (à une page
+//près), puis les compteurs privés sont additionnés (réduction)
+static long countParallel(const elt_t *tab, long nb, elt_t val, int nbThreads)
+{
+    pthread_t pthreadTab[nbThreads]; //tableau d'identifiant de thread
+    threadData threadArgs[nbThreads];
+    PaddedCounter *counters;
+    int ret = posix_memalign((void **) &counters, CACHE_LINE, nbThreads * sizeof(PaddedCounter));
+    myassert(ret == 0, "Client : erreur allocation compteurs");
 
     //Lancement des threads
-    for(int i = 0 ; i < data->nbThreads ; i++){
-        threadData* myData = malloc(sizeof(threadData));
-        myData->val = val ;
-        myData->mytab = tab ;
-        myData->result = &result ;
-        if(i == 0){
-            myData->debut = 0 ; //si debut du tableau on commence a 0
-        }
-        else{
-            myData->debut = pasTableau*i+1 ; //sinon on commance au dernier incice +1
-        }
-        if(i == data->nbThreads-1){
-            myData->fin = pasTableau*(i+1)+resteTableau ; //si on est a la fin du tableau on prend le reste de la division
-        }
-        else {
-            myData->fin = pasTableau*(i+1);
-        }
-        myData->myMutex = mutex ;
-        int ret = pthread_create(&(pthreadTab[i]), NULL, thread_function, myData);
+    for(int i = 0 ; i < nbThreads ; i++){
+        threadArgs[i].val = val;
+        threadArgs[i].mytab = tab;
+        threadArgs[i].debut = chunkStart(tab, nb, i, nbThreads);
+        threadArgs[i].fin = chunkStart(tab, nb, i+1, nbThreads);
+        threadArgs[i].counter = &(counters[i]);
+        counters[i].count = 0;
+        ret = pthread_create(&(pthreadTab[i]), NULL, thread_function, &(threadArgs[i]));
         myassert(ret == 0, "Client : erreur création thread");
     }
 
     //attente de la fin des threads
-    for(int i = 0 ; i < data->nbThreads ; i++){
-        int ret = pthread_join(pthreadTab[i],NULL);
+    for(int i = 0 ; i < nbThreads ; i++){
+        ret = pthread_join(pthreadTab[i],NULL);
         myassert(ret == 0, "Erreur client : fermeture des threads");
     }
 
+    //réduction finale
+    long result = 0;
+    for(int i = 0 ; i < nbThreads ; i++)
+        result += counters[i].count;
+
+    free(counters);
+    return result;
+}
+
+//meilleur temps (en secondes) de countParallel sur BENCH_REPEAT essais
+static double timeCountParallel(const elt_t *tab, long nb, elt_t val, int nbThreads)
+{
+    double best = -1;
+    for (int r = 0; r < BENCH_REPEAT; r++)
+    {
+        double t0 = ut_getTime();
+        countParallel(tab, nb, val, nbThreads);
+        double t = ut_getTime() - t0;
+        if ((best < 0) || (t < best))
+            best = t;
+    }
+    return best;
+}
+
+//nombre de coeurs réellement utilisés par nbThreads threads
+static int nbCoresUsed(int nbThreads)
+{
+    long nbCores = sysconf(_SC_NPROCESSORS_ONLN);
+    if ((nbCores < 1) || (nbThreads < nbCores))
+        return nbThreads;
+    return nbCores;
+}
+
+//débit d'un comptage de nb éléments en t secondes
+static void printThroughput(long nb, double t, int nbThreads)
+{
+    double eltPerSec = nb / t;
+    printf("noyau %s : %.3f ms, %.1f Méléments/s, %.1f Méléments/s/coeur, %.2f Go/s\n",
+           cnt_kernelName(), t * 1e3, eltPerSec * 1e-6,
+           eltPerSec * 1e-6 / nbCoresUsed(nbThreads), eltPerSec * sizeof(elt_t) * 1e-9);
+}
+
+//balayage du nombre de threads (1, 2, 4, ..., nbThreads) : temps,
+//accélération et efficacité par rapport à un seul thread
+static void benchThreads(const Data *data, const elt_t *tab)
+{
+    printf("noyau de comptage : %s\n", cnt_kernelName());
+    printf("%8s %12s %12s %14s %10s %10s %10s\n", "threads", "temps(ms)", "Méléments/s",
+           "Mél./s/coeur", "Go/s", "speedup", "efficacité");
+    double t1 = 0;
+    for (int p = 1; ; p = (2*p < data->nbThreads) ? 2*p : data->nbThreads)
+    {
+        double t = timeCountParallel(tab, data->nb, data->elt, p);
+        if (p == 1)
+            t1 = t;
+        double speedup = t1 / t;
+        double eltPerSec = data->nb / t;
+        printf("%8d %12.3f %12.1f %14.1f %10.2f %10.2f %9.0f%%\n", p, t * 1e3, eltPerSec * 1e-6,
+               eltPerSec * 1e-6 / nbCoresUsed(p), eltPerSec * sizeof(elt_t) * 1e-9, speedup, 100 * speedup / p);
+        if (p == data->nbThreads)
+            break;
+    }
+}
+
+/************************************************************************
+ * Table de fréquences (sous-mode --histo)
+ ************************************************************************/
+//Une table de fréquences : nbBins classes de même largeur sur [min,max[,
+//la case supplémentaire d'indice nbBins compte les éléments hors intervalle
+typedef struct {
+    long nbBins;
+    double min;
+    double max;
+    double scale;       // nbBins / (max - min)
+} HistoParams;
+
+static void histoInit(HistoParams *h, long nbBins, double min, double max)
+{
+    h->nbBins = nbBins;
+    h->min = min;
+    h->max = max;
+    h->scale = nbBins / (max - min);
+}
+
+static inline long histoBin(const HistoParams *h, elt_t v)
+{
+    double x = ((double) v - h->min) * h->scale;
+    if (! (x >= 0) || (x >= h->nbBins))
+        return h->nbBins;
+    return (long) x;
+}
+
+//Une structure pour les arguments à passer à un thread de la table de fréquences
+typedef struct {
+    const elt_t *mytab;
+    long debut;                 // premier indice traité (inclus)
+    long fin;                   // dernier indice traité (exclu)
+    int id;                     // numéro du thread (0..nbThreads-1)
+    int nbThreads;
+    const HistoParams *params;
+    long **tables;              // tables privées de tous les threads
+    pthread_barrier_t *barrier;
+} histoThreadData;
+
+void * histo_thread_function(void * arg){
+
+    histoThreadData *data = (histoThreadData*)arg; 
+    long nbCells = data->params->nbBins + 1;
+
+    //table privée, allouée (et donc placée en mémoire) par le thread lui-même
+    long *table = calloc(nbCells, sizeof(long));
+    myassert(table != NULL, "Client : erreur allocation table de fréquences");
+    data->tables[data->id] = table;
+    cnt_histogram(data->mytab + data->debut, data->fin - data->debut,
+                  data->params->min, data->params->scale, data->params->nbBins, table);
+
+    //réduction en arbre : à l'étape <step>, le thread id (multiple de
+    //2*step) ajoute la table du thread id+step à la sienne ; toutes les
+    //fusions d'une même étape se font en parallèle
+    for (int step = 1; step < data->nbThreads; step *= 2)
+    {
+        int ret = pthread_barrier_wait(data->barrier);
+        myassert((ret == 0) || (ret == PTHREAD_BARRIER_SERIAL_THREAD), "Client : erreur barrière");
+        if ((data->id % (2*step) == 0) && (data->id + step < data->nbThreads))
+        {
+            long *other = data->tables[data->id + step];
+            for (long k = 0; k < nbCells; k++)
+                table[k] += other[k];
+            free(other);
+            data->tables[data->id + step] = NULL;
+        }
+    }
+    return NULL;
+}
+
+//table de fréquences de tab[0..nb[ avec nbThreads threads (mêmes blocs
+//contigus que countParallel) ; le résultat (nbBins+1 cases) est à libérer
+static long * histoParallel(const elt_t *tab, long nb, const HistoParams *params, int nbThreads)
+{
+    pthread_t pthreadTab[nbThreads];
+    histoThreadData threadArgs[nbThreads];
+    long *tables[nbThreads];
+    pthread_barrier_t barrier;
+    int ret = pthread_barrier_init(&barrier, NULL, nbThreads);
+    myassert(ret == 0, "Client : erreur création barrière");
+
+    for(int i = 0 ; i < nbThreads ; i++){
+        threadArgs[i].mytab = tab;
+        threadArgs[i].debut = chunkStart(tab, nb, i, nbThreads);
+        threadArgs[i].fin = chunkStart(tab, nb, i+1, nbThreads);
+        threadArgs[i].id = i;
+        threadArgs[i].nbThreads = nbThreads;
+        threadArgs[i].params = params;
+        threadArgs[i].tables = tables;
+        threadArgs[i].barrier = &barrier;
+        ret = pthread_create(&(pthreadTab[i]), NULL, histo_thread_function, &(threadArgs[i]));
+        myassert(ret == 0, "Client : erreur création thread");
+    }
+
+    for(int i = 0 ; i < nbThreads ; i++){
+        ret = pthread_join(pthreadTab[i],NULL);
+        myassert(ret == 0, "Erreur client : fermeture des threads");
+    }
+
+    ret = pthread_barrier_destroy(&barrier);
+    myassert(ret == 0, "Client : erreur destruction barrière");
+    return tables[0];
+}
+
+//meilleur temps (en secondes) de histoParallel sur BENCH_REPEAT essais
+static double timeHistoParallel(const elt_t *tab, long nb, const HistoParams *params, int nbThreads)
+{
+    double best = -1;
+    for (int r = 0; r < BENCH_REPEAT; r++)
+    {
+        double t0 = ut_getTime();
+        free(histoParallel(tab, nb, params, nbThreads));
+        double t = ut_getTime() - t0;
+        if ((best < 0) || (t < best))
+            best = t;
+    }
+    return best;
+}
+
+//comparaison table de fréquences / comptage d'un seul élément
+static void benchHisto(const Data *data, const elt_t *tab, const HistoParams *params)
+{
+    printf("table de fréquences (%ld classes) / comptage d'un élément :\n", params->nbBins);
+    printf("%8s %12s %12s %10s %14s\n", "threads", "comptage(ms)", "table(ms)", "rapport", "table Mél./s");
+    for (int p = 1; ; p = (2*p < data->nbThreads) ? 2*p : data->nbThreads)
+    {
+        double tCount = timeCountParallel(tab, data->nb, data->elt, p);
+        double tHisto = timeHistoParallel(tab, data->nb, params, p);
+        printf("%8d %12.3f %12.3f %10.2f %14.1f\n", p, tCount * 1e3, tHisto * 1e3, tHisto / tCount, data->nb / tHisto * 1e-6);
+        if (p == data->nbThreads)
+            break;
+    }
+}
+
+//calcul, affichage et vérification de la table de fréquences
+static void localHisto(const Data *data, const elt_t *tab, long result)
+{
+    HistoParams params;
+    histoInit(&params, data->nbBins, data->min, data->max);
+
+    double t0 = ut_getTime();
+    long *histo = histoParallel(tab, data->nb, &params, data->nbThreads);
+    double t = ut_getTime() - t0;
+
+    // affichage si pas trop de classes
+    if (params.nbBins <= 20)
+    {
+        for (long k = 0; k < params.nbBins; k++)
+            printf("[%g,%g[ : %ld\n", params.min + k / params.scale, params.min + (k+1) / params.scale, histo[k]);
+    }
+    if (histo[params.nbBins] != 0)
+        printf("hors intervalle : %ld\n", histo[params.nbBins]);
+
+    // table linéaire pour vérifier
+    long *verif = calloc(params.nbBins + 1, sizeof(long));
+    myassert(verif != NULL, "Client : erreur allocation table de fréquences");
+    for (long i = 0; i < data->nb; i++)
+        verif[histoBin(&params, tab[i])]++;
+    long nbDiff = 0;
+    for (long k = 0; k <= params.nbBins; k++)
+        if (histo[k] != verif[k])
+            nbDiff++;
+
+    // une classe par valeur entière : la classe de elt doit valoir le comptage
+    long eltBin = histoBin(&params, data->elt);
+    bool unitBins = (params.scale == 1) && (floor(params.min) == params.min) && (floor(data->elt) == data->elt);
+    if (unitBins && (eltBin < params.nbBins) && (histo[eltBin] != result))
+        nbDiff++;
+
+    if (nbDiff == 0)
+        printf("=> ok ! la table de fréquences calculée par les threads est correcte\n");
+    else
+        printf("=> PB ! %ld classe(s) de la table de fréquences incorrecte(s)\n", nbDiff);
+    printf("table de fréquences : %.3f ms, %.1f Méléments/s\n", t * 1e3, data->nb / t * 1e-6);
+
+    if (data->bench)
+        benchHisto(data, tab, &params);
+
+    free(verif);
+    free(histo);
+}
+
+//comptage (et vérifications, mesures, table de fréquences) dans tab[0..data->nb[
+static void localCount(const Data *data, const elt_t *tab)
+{
+    double t0 = ut_getTime();
+    long result = countParallel(tab, data->nb, data->elt, data->nbThreads);
+    double t = ut_getTime() - t0;
+
     // résultat (result a été rempli par les threads)
     // affichage du tableau si pas trop gros
     if (data->nb <= 20)
     {
         printf("[");
-        for (int i = 0; i < data->nb; i++)
+        for (long i = 0; i < data->nb; i++)
         {
             if (i != 0)
                 printf(" ");
-            printf("%g", tab[i]);
+            printf(ELT_FMT, tab[i]);
         }
         printf("]\n");
     }
     // recherche linéaire pour vérifier
-    int nbVerif = 0;
-    for (int i = 0; i < data->nb; i++)
+    long nbVerif = 0;
+    for (long i = 0; i < data->nb; i++)
     {
         if (tab[i] == data->elt)
             nbVerif ++;
     }
-    printf("Elément %g présent %d fois (%d attendu)\n", data->elt, result, nbVerif);
+    printf("Elément " ELT_FMT " présent %ld fois (%ld attendu)\n", data->elt, result, nbVerif);
     if (result == nbVerif)
         printf("=> ok ! le résultat calculé par les threads est correct\n");
     else
         printf("=> PB ! le résultat calculé par les threads est incorrect\n");
+    printThroughput(data->nb, t, data->nbThreads);
+
+    if (data->bench)
+        benchThreads(data, tab);
+
+    if (data->nbBins > 0)
+        localHisto(data, tab, result);
+}
+
+//écriture des éléments bruts de tab[0..nb[ dans le fichier <name>
+static void saveTab(const char *name, const elt_t *tab, long nb)
+{
+    int fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    myassert(fd != -1, "Client : erreur création du fichier de sauvegarde");
+
+    const char *buf = (const char *) tab;
+    size_t remaining = nb * sizeof(elt_t);
+    while (remaining > 0)
+    {
+        ssize_t ret = write(fd, buf, remaining);
+        myassert(ret > 0, "Client : erreur écriture du fichier de sauvegarde");
+        buf += ret;
+        remaining -= ret;
+    }
+
+    int ret = close(fd);
+    myassert(ret == 0, "Client : erreur fermeture du fichier de sauvegarde");
+    printf("sauvegarde : %ld éléments " ELT_NAME " dans %s\n", nb, name);
+}
+
+/************************************************************************
+ * Comptage dans un fichier (projection mémoire)
+ ************************************************************************/
+// Le fichier contient des éléments elt_t bruts (cf. --save). S'il tient
+// en mémoire, il est projeté en entier puis traité comme un tableau
+// généré (les blocs des threads commencent sur des pages, cf. chunkStart).
+// Sinon chaque thread parcourt sa tranche du fichier (alignée sur les
+// pages) par fenêtres successives : mmap d'une fenêtre, comptage, munmap,
+// l'espace d'adressage et la mémoire utilisés restent bornés.
+
+//Une structure pour les arguments à passer à un thread de lecture par fenêtres
+typedef struct {
+    elt_t val;
+    int fd;
+    off_t debut;                // premier octet traité (inclus, aligné sur une page)
+    off_t fin;                  // dernier octet traité (exclu)
+    size_t window;              // taille des fenêtres (multiple de la taille d'une page)
+    PaddedCounter *counter;     // compteur privé du thread
+} fileThreadData;
+
+void * file_thread_function(void * arg){
+
+    fileThreadData *data = (fileThreadData*)arg; 
+    long count = 0;
+
+    for (off_t off = data->debut; off < data->fin; off += data->window)
+    {
+        size_t len = (data->fin - off < (off_t) data->window) ? (size_t) (data->fin - off) : data->window;
+
+        // lecture anticipée de la fenêtre suivante pendant le comptage de celle-ci
+        if (off + (off_t) len < data->fin)
+            posix_fadvise(data->fd, off + len, data->window, POSIX_FADV_WILLNEED);
+
+        void *win = mmap(NULL, len, PROT_READ, MAP_PRIVATE, data->fd, off);
+        myassert(win != MAP_FAILED, "Client : erreur projection d'une fenêtre du fichier");
+        posix_madvise(win, len, POSIX_MADV_SEQUENTIAL);
+        count += cnt_countEqual((const elt_t *) win, len / sizeof(elt_t), data->val);
+        int ret = munmap(win, len);
+        myassert(ret == 0, "Client : erreur libération d'une fenêtre du fichier");
+    }
+    data->counter->count = count;
+    return NULL;
+}
+
+//compte les exemplaires de val dans les nb premiers éléments du fichier fd
+//avec nbThreads threads lisant par fenêtres de window octets
+static long countFileWindows(int fd, long nb, elt_t val, int nbThreads, size_t window)
+{
+    pthread_t pthreadTab[nbThreads];
+    fileThreadData threadArgs[nbThreads];
+    PaddedCounter *counters;
+    int ret = posix_memalign((void **) &counters, CACHE_LINE, nbThreads * sizeof(PaddedCounter));
+    myassert(ret == 0, "Client : erreur allocation compteurs");
+
+    long page = sysconf(_SC_PAGESIZE);
+    off_t size = (off_t) nb * sizeof(elt_t);
+    for(int i = 0 ; i < nbThreads ; i++){
+        off_t debut = (off_t) ((long double) size * i / nbThreads);
+        off_t fin = (off_t) ((long double) size * (i+1) / nbThreads);
+        threadArgs[i].val = val;
+        threadArgs[i].fd = fd;
+        threadArgs[i].debut = debut - debut % page;
+        threadArgs[i].fin = (i == nbThreads - 1) ? size : fin - fin % page;
+        threadArgs[i].window = window;
+        threadArgs[i].counter = &(counters[i]);
+        counters[i].count = 0;
+        ret = pthread_create(&(pthreadTab[i]), NULL, file_thread_function, &(threadArgs[i]));
+        myassert(ret == 0, "Client : erreur création thread");
+    }
+
+    for(int i = 0 ; i < nbThreads ; i++){
+        ret = pthread_join(pthreadTab[i],NULL);
+        myassert(ret == 0, "Erreur client : fermeture des threads");
+    }
 
-    //libération des ressources
-    int ret = pthread_mutex_destroy(&mutex);
-    myassert(ret==0, "echec fermeture thread mutex");
+    long result = 0;
+    for(int i = 0 ; i < nbThreads ; i++)
+        result += counters[i].count;
+
+    free(counters);
+    return result;
+}
+
+static void localFile(const Data *data)
+{
+    int fd = open(data->file, O_RDONLY);
+    myassert(fd != -1, "Client : erreur ouverture du fichier d'éléments");
+    struct stat st;
+    int ret = fstat(fd, &st);
+    myassert(ret == 0, "Client : erreur taille du fichier d'éléments");
+
+    // copie des paramètres : le nombre d'éléments vient du fichier
+    Data fileData = *data;
+    fileData.nb = st.st_size / sizeof(elt_t);
+    myassert(fileData.nb > 0, "Client : le fichier ne contient aucun élément");
+    if (st.st_size % sizeof(elt_t) != 0)
+        printf("attention : %ld octet(s) en fin de fichier ignoré(s)\n", (long) (st.st_size % sizeof(elt_t)));
+
+    // projection complète si le fichier tient dans la moitié de la RAM
+    long page = sysconf(_SC_PAGESIZE);
+    double ram = (double) sysconf(_SC_PHYS_PAGES) * page;
+    size_t window = 0;
+    if (data->windowMB > 0)
+        window = (size_t) data->windowMB << 20;
+    else if (st.st_size > ram / 2)
+        window = (size_t) FILE_WINDOW_MB << 20;
+    window -= window % page;
+
+    if (window == 0)
+    {
+        printf("fichier %s : %ld éléments " ELT_NAME " (%.3f Go), projection complète\n",
+               data->file, fileData.nb, st.st_size * 1e-9);
+        size_t len = fileData.nb * sizeof(elt_t);
+        void *tab = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        myassert(tab != MAP_FAILED, "Client : erreur projection du fichier");
+        posix_madvise(tab, len, POSIX_MADV_SEQUENTIAL);
+
+        localCount(&fileData, (const elt_t *) tab);
+
+        ret = munmap(tab, len);
+        myassert(ret == 0, "Client : erreur libération de la projection du fichier");
+    }
+    else
+    {
+        printf("fichier %s : %ld éléments " ELT_NAME " (%.3f Go), fenêtres de %zu Mo par thread\n",
+               data->file, fileData.nb, st.st_size * 1e-9, window >> 20);
+        double t0 = ut_getTime();
+        long result = countFileWindows(fd, fileData.nb, data->elt, data->nbThreads, window);
+        double t = ut_getTime() - t0;
+        // pas de relecture du fichier pour vérifier : il ne tient pas en mémoire
+        printf("Elément " ELT_FMT " présent %ld fois\n", data->elt, result);
+        printThroughput(fileData.nb, t, data->nbThreads);
+        if (data->bench)
+            printf("(--bench : uniquement avec une projection complète)\n");
+    }
+
+    ret = close(fd);
+    myassert(ret == 0, "Client : erreur fermeture du fichier d'éléments");
+}
+
+void lauchThreads(const Data *data)
+{
+    if (data->file != NULL)
+    {
+        localFile(data);
+        return;
+    }
+
+    double tGen = ut_getTime();
+    elt_t * tab = ut_generateDist(&(data->dist), data->nb, data->min, data->max, 0, data->seed, data->nbThreads);
+    tGen = ut_getTime() - tGen;
+    printf("génération (%s, graine %" PRIu64 ") : %.3f ms\n", ut_distName(data->dist.kind), data->seed, tGen * 1e3);
+
+    if (data->save != NULL)
+        saveTab(data->save, tab, data->nb);
+
+    localCount(data, tab);
 
     free(tab);
 }
@@ -286,115 +881,232 @@ void lauchThreads(const Data *data)
 /************************************************************************
  * Partie communication avec le master
  ************************************************************************/
-//envoi des données au master
-void sendData(const Data *data)
+//tableau à insérer (ou NULL selon l'ordre)
+static elt_t * makeData(const Data *data)
 {
-    //envoi de l'ordre au master 
-    int order = data->order;
-    
-    int retw = write(data->fdClientToMaster, &order, sizeof(int)); 
-    myassert(retw != -1, "error sendData : echec envoi order");
-
-    // envoi des paramètres supplémentaires au master (pour CM_ORDER_EXIST,
-    // CM_ORDER_INSERT et CM_ORDER_INSERT_MANY)
-    if(order == CM_ORDER_INSERT){
-        float elt = data->elt;
-        int retw = write(data->fdClientToMaster, &elt, sizeof(float)); 
-        myassert(retw != -1, "echec envoi element");
-    }
-    else if(order == CM_ORDER_EXIST){
-        float elt = data->elt;
-        int retw = write(data->fdClientToMaster, &elt, sizeof(float)); 
-        myassert(retw != -1, "echec envoi element");
-    }
-    else if(order == CM_ORDER_INSERT_MANY){
-        int size = data->nb;
-        int retw = write(data->fdClientToMaster, &size, sizeof(int)); 
-        myassert(retw != -1, "echec envoi taille tableau");
-
-        //ici soit on prend des variables aléatoires
-        //ou on appelle notre fonction qui determine un tableau de valeur 
-        //à partir d'un intervalle et d'un pas calculé à partir de min,
-        //max et nb (VOIR UTILS.C)
-
-        float * tab = ut_generateTab(data->nb, data->min, data->max, 0);
-        //float * tab = arrFromInterval(data->nb, data->min, data->max);
-        retw = write(data->fdClientToMaster, tab, data->nb * sizeof(float)); 
-        myassert(retw != -1, "echec envoi tableau");
-        free(tab);
+    elt_t *tab = NULL;
+
+    // pour CM_ORDER_INSERT_MANY : tableau aléatoire (cf. --dist, --seed)
+    //(ou tableau de valeurs régulières à partir d'un intervalle, cf. arrFromInterval)
+    if (data->order == CM_ORDER_INSERT_MANY)
+    {
+        long nbCores = sysconf(_SC_NPROCESSORS_ONLN);
+        tab = ut_generateDist(&(data->dist), data->nb, data->min, data->max, 0, data->seed, (nbCores < 1) ? 1 : nbCores);
+        //tab = arrFromInterval(data->nb, data->min, data->max);
     }
+    return tab;
 }
 
-//attente de la réponse du master
-void receiveAnswer(const Data *data)
-{   
-    //reception de la réponse du master
-    int receipt; 
-    int retr = read(data->fdMasterToClient, &receipt, sizeof(int));
-    myassert(retr != 0, "error receiveAnswer : echec lecture accusé de recepetion");
-    //printf("CLIENT : J'ai recu l'accusé de recepetion suivant %d !\n", receipt);
-    
-    //répartition des différents affiches et récupération des données supplémentaires 
-    //(si il y en a ) auprès du master
-    if (receipt == CM_ANSWER_EXIST_YES){
-        int quantity;
-        int retr = read(data->fdMasterToClient, &quantity, sizeof(int));
-        myassert(retr != 0, "echec lecture quantite recue");
-
-        printf("élément %f : présent en %d exemplaire(s)\n", data->elt, quantity);
-    }
-    else if(receipt == CM_ANSWER_EXIST_NO){
-        printf("élément %f : absent \n", data->elt);
+//envoi des données au master ; retourne le tableau envoyé (ou NULL), à
+//libérer seulement après la réponse (il a pu être prêté au tube par vmsplice)
+elt_t * sendData(const Data *data)
+{
+    elt_t *tab = makeData(data);
+    cm_sendOrderIn(&(data->session), data->set, data->order, data->elt, tab, data->nb);
+    return tab;
+}
+
+//nom d'un ordre (cf. ligne de commande)
+static const char * orderName(int order)
+{
+    switch (order)
+    {
+      case CM_ORDER_STOP:        return TK_STOP;
+      case CM_ORDER_HOW_MANY:    return TK_HOW_MANY;
+      case CM_ORDER_MINIMUM:     return TK_MINIMUM;
+      case CM_ORDER_MAXIMUM:     return TK_MAXIMUM;
+      case CM_ORDER_EXIST:       return TK_EXIST;
+      case CM_ORDER_SUM:         return TK_SUM;
+      case CM_ORDER_INSERT:      return TK_INSERT;
+      case CM_ORDER_INSERT_MANY: return TK_INSERT_MANY;
+      case CM_ORDER_PRINT:       return TK_PRINT;
+      case CM_ORDER_STATS:       return TK_STATS;
+      case CM_ORDER_TREESTATS:   return TK_TREESTATS;
+      default:                   return "inconnu";
+    }
+}
+
+//raccourcis des exist du master (filtre de Bloom MWC_BLOOM, cache MWC_CACHE)
+static void printExistStats(const CmExistStats *exist)
+{
+    if (exist->cacheCapacity > 0)
+    {
+        double ratio = (exist->cacheLookups > 0) ? 100.0 * exist->cacheHits / exist->cacheLookups : 0.0;
+        printf("\ncache : %.1f Ko, %d entrées sur %d, %llu évictions\n", exist->cacheBytes / 1024.0,
+               exist->cacheEntries, exist->cacheCapacity, (unsigned long long) exist->cacheEvictions);
+        printf("exist : %llu consultations, %llu répondus par le cache (%.1f %%)\n",
+               (unsigned long long) exist->cacheLookups, (unsigned long long) exist->cacheHits, ratio);
+    }
+    if (exist->bloomBytes == 0)
+        return;
+    double rate = (exist->bloomLookups > 0) ? 100.0 * exist->bloomNegatives / exist->bloomLookups : 0.0;
+    printf("\nfiltre de Bloom : %.1f Ko pour %llu éléments, %d hachages, faux positifs visés %.3g %%, estimés %.3g %%\n",
+           exist->bloomBytes / 1024.0, (unsigned long long) exist->bloomCapacity, exist->bloomHashes,
+           100.0 * exist->bloomTargetFp, 100.0 * exist->bloomEstimatedFp);
+    printf("exist : %llu consultations, %llu répondus par le filtre (%.1f %%), %llu faux positifs\n",
+           (unsigned long long) exist->bloomLookups, (unsigned long long) exist->bloomNegatives, rate,
+           (unsigned long long) exist->bloomFalsePositives);
+}
+
+//tableau des statistiques du master (durées en µs)
+static void printStats(const CmOrderStats *stats, int nb)
+{
+    printf("%-11s %9s %8s %7s %11s %9s %9s %9s %9s %9s %9s\n", "ordre", "nombre", "négatifs",
+           "erreurs", "total(ms)", "moy.(µs)", "p50", "p90", "p99", "p99.9", "max");
+    for (int i = 0; i < nb; i++)
+    {
+        const Histogram *h = &(stats[i].latency);
+        printf("%-11s %9llu %8llu %7llu %11.3f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+               orderName(stats[i].order), (unsigned long long) h->count,
+               (unsigned long long) stats[i].misses, (unsigned long long) stats[i].errors,
+               h->sum * 1e-6, hg_mean(h) * 1e-3, hg_percentile(h, 0.50) * 1e-3,
+               hg_percentile(h, 0.90) * 1e-3, hg_percentile(h, 0.99) * 1e-3,
+               hg_percentile(h, 0.999) * 1e-3, h->max * 1e-3);
+    }
+
+    //compteurs de performance du master (mode MWC_PERF=on), moyennes par ordre
+    bool perf = false;
+    for (int i = 0; i < nb; i++)
+        perf = perf || (stats[i].perf.nbSamples > 0);
+    if (! perf)
+        return;
+    printf("\ncompteurs du master par ordre (- : indisponible)\n");
+    printf("%-11s %9s %12s %12s %6s %10s %8s %10s\n", "ordre", "mesures", "cycles", "instructions",
+           "IPC", "déf. cache", "chgt ctx", "cpu(µs)");
+    for (int i = 0; i < nb; i++)
+    {
+        const PcTotals *p = &(stats[i].perf);
+        if (p->nbSamples == 0)
+            continue;
+        char cols[PC_NB_COUNTERS][32];
+        for (int k = 0; k < PC_NB_COUNTERS; k++)
+        {
+            double mean = (double) p->values[k] / p->nbSamples;
+            if (! (p->mask & (1u << k)))
+                snprintf(cols[k], sizeof(cols[k]), "-");
+            else if (k == PC_TASK_CLOCK)
+                snprintf(cols[k], sizeof(cols[k]), "%.1f", mean * 1e-3);
+            else
+                snprintf(cols[k], sizeof(cols[k]), "%.1f", mean);
+        }
+        char ipc[32] = "-";
+        uint32_t both = (1u << PC_CYCLES) | (1u << PC_INSTRUCTIONS);
+        if (((p->mask & both) == both) && (p->values[PC_CYCLES] > 0))
+            snprintf(ipc, sizeof(ipc), "%.2f", (double) p->values[PC_INSTRUCTIONS] / p->values[PC_CYCLES]);
+        printf("%-11s %9llu %12s %12s %6s %10s %8s %10s\n", orderName(stats[i].order),
+               (unsigned long long) p->nbSamples, cols[PC_CYCLES], cols[PC_INSTRUCTIONS], ipc,
+               cols[PC_CACHE_MISSES], cols[PC_CTX_SWITCHES], cols[PC_TASK_CLOCK]);
+    }
+}
+
+//forme de l'arbre des workers
+static void printTreeStats(const CmTreeStats *tree)
+{
+    //hauteur d'un arbre parfaitement équilibré de même taille
+    int optimal = 0;
+    while ((1L << optimal) - 1 < tree->nbWorkers)
+        optimal++;
+
+    printf("workers                : %d (%d processus avec le master)\n", tree->nbWorkers, tree->nbProcesses);
+    printf("profondeur maximale    : %d (%d pour un arbre équilibré)\n", tree->maxDepth, optimal);
+    printf("déséquilibre maximal   : %d (%d worker(s) déséquilibré(s))\n", tree->maxImbalance, tree->nbUnbalanced);
+    printf("mémoire résidente      : %.1f Mo au total\n", tree->rssKB / 1024.0);
+    printf("descripteurs ouverts   : %d au total, %d au plus par processus\n", tree->nbFds, tree->maxFds);
+    if (tree->maxDepth > 2 * optimal)
+        printf("=> l'arbre a dégénéré en liste (insertions triées ?) : "
+               "les ordres parcourent jusqu'à %d workers\n", tree->maxDepth);
+    if (tree->maxDepth == 0)
+        return;
+
+    //histogramme des profondeurs, par tranches si l'arbre est trop profond
+    const int maxLines = 32;
+    const int barWidth = 50;
+    int step = (tree->maxDepth + maxLines - 1) / maxLines;
+    int maxCount = 0;
+    for (int d = 0; d < tree->maxDepth; d += step)
+    {
+        int count = 0;
+        for (int k = d; (k < d + step) && (k < tree->maxDepth); k++)
+            count += tree->depths[k];
+        if (count > maxCount)
+            maxCount = count;
+    }
+    printf("profondeur : workers\n");
+    for (int d = 0; d < tree->maxDepth; d += step)
+    {
+        int last = (d + step < tree->maxDepth) ? d + step - 1 : tree->maxDepth - 1;
+        int count = 0;
+        for (int k = d; k <= last; k++)
+            count += tree->depths[k];
+        int width = (int) ((long) count * barWidth / maxCount);
+        if (last == d)
+            printf("%10d : %6d ", d, count);
+        else
+            printf("%4d..%4d : %6d ", d, last, count);
+        for (int i = 0; i < width; i++)
+            putchar('#');
+        putchar('\n');
+    }
+}
+
+//affichage de la réponse du master
+static void printAnswer(const Data *data, CmAnswer *answer)
+{
+    //répartition des différents affichages
+    if (answer->code == CM_ANSWER_EXIST_YES){
+        printf("élément " ELT_FMT " : présent en %d exemplaire(s)\n", data->elt, answer->quantity);
+    }
+    else if(answer->code == CM_ANSWER_EXIST_NO){
+        printf("élément " ELT_FMT " : absent \n", data->elt);
     } 
-    else if(receipt == CM_ANSWER_INSERT_OK){
-        printf("insertion de l'élément %f : ok\n", data->elt);
+    else if(answer->code == CM_ANSWER_INSERT_OK){
+        printf("insertion de l'élément " ELT_FMT " : ok\n", data->elt);
     }
-    else if(receipt == CM_ANSWER_INSERT_MANY_OK){
-        printf("insertion des %d éléments : ok\n", data->nb);
+    else if(answer->code == CM_ANSWER_INSERT_MANY_OK){
+        printf("insertion des %ld éléments : ok\n", data->nb);
     }
-    else if(receipt == CM_ANSWER_PRINT_OK){
+    else if(answer->code == CM_ANSWER_PRINT_OK){
         printf("affichage ok\n");
     }
-    else if(receipt == CM_ANSWER_SUM_OK){
-        float somme;
-        int retr = read(data->fdMasterToClient, &somme, sizeof(float));
-        myassert(retr != 0, "echec lecture somme recue");
-
-        printf("somme des éléments : %f\n", somme);
+    else if(answer->code == CM_ANSWER_SUM_OK){
+        printf("somme des éléments : " ELT_SUM_FMT "\n", answer->sum);
     }
-    else if(receipt == CM_ANSWER_MINIMUM_EMPTY){
+    else if(answer->code == CM_ANSWER_MINIMUM_EMPTY){
         printf("pas de minimum\n");
     }
-    else if(receipt == CM_ANSWER_MINIMUM_OK){
-        float result; 
-        retr = read(data->fdMasterToClient, &result, sizeof(float));
-        myassert(retr != 0, "echec lecture element");
-
-        printf("minimum : %f\n", result);
+    else if(answer->code == CM_ANSWER_MINIMUM_OK){
+        printf("minimum : " ELT_FMT "\n", answer->elt);
     }
-    else if(receipt == CM_ANSWER_MAXIMUM_EMPTY){
+    else if(answer->code == CM_ANSWER_MAXIMUM_EMPTY){
         printf("pas de maximum\n");
     }
-    else if(receipt == CM_ANSWER_MAXIMUM_OK){
-        float result; 
-        retr = read(data->fdMasterToClient, &result, sizeof(float));
-        myassert(retr != 0, "echec lecture element");
-
-        printf("maximum : %f\n", result);
-    }else if (receipt == CM_ANSWER_STOP_OK){
+    else if(answer->code == CM_ANSWER_MAXIMUM_OK){
+        printf("maximum : " ELT_FMT "\n", answer->elt);
+    }else if (answer->code == CM_ANSWER_STOP_OK){
         printf("le master s'est arrêté \n");
     }
-    else if (receipt == CM_ANSWER_HOW_MANY_OK){
-        int nbTotal;
-        retr = read(data->fdMasterToClient, &nbTotal, sizeof(int));
-        myassert(retr != 0, "echec lecture cardinalité");
-
-        int nbDistinct;
-        retr = read(data->fdMasterToClient, &nbDistinct, sizeof(int));
-        myassert(retr != 0, "echec lecture cardinalité");
-
-        printf("il y a %d élément(s) \nil ya %d élément(s) distinct(s)\n", nbTotal, nbDistinct);
+    else if (answer->code == CM_ANSWER_HOW_MANY_OK){
+        printf("il y a %d élément(s) \nil ya %d élément(s) distinct(s)\n", answer->nbTotal, answer->nbDistinct);
+    }
+    else if (answer->code == CM_ANSWER_STATS_OK){
+        printStats(answer->stats, answer->nbStats);
+        printExistStats(&(answer->exist));
     }
+    else if (answer->code == CM_ANSWER_TREESTATS_OK){
+        printTreeStats(&(answer->tree));
+    }
+    else if (answer->code == CM_ANSWER_ERROR){
+        printf("le master ne connaît pas cet ordre\n");
+    }
+    cm_freeAnswer(answer);
+}
+
+//attente de la réponse du master
+void receiveAnswer(const Data *data)
+{   
+    CmAnswer answer;
+    cm_receiveAnswer(&(data->session), &answer);
+    printAnswer(data, &answer);
 }
 
 
@@ -405,51 +1117,43 @@ int main(int argc, char * argv[])
 {
     Data data;
     parseArgs(argc, argv, &data);
+    if (data.order != CM_ORDER_LOCAL)
+        tr_init("client", false);
+    CmShards shards;
+    if (! cm_shardsInit(&shards))
+        usage(argv[0], "MWC_SHARDS : bornes <b1>,<b2>,... strictement croissantes attendues");
 
     if (data.order == CM_ORDER_LOCAL)
         lauchThreads(&data);
+    else if (shards.nb > 1)
+    {
+        // - plusieurs masters (MWC_SHARDS) : ordre routé, réponses fusionnées
+        elt_t *tab = makeData(&data);
+        CmAnswer answer;
+        cm_routeOrder(&shards, data.set, data.order, data.elt, tab, data.nb, &answer);
+        free(tab);
+        printAnswer(&data, &answer);
+    }
+    else if ((cm_handshakeMode() == CM_HANDSHAKE_FUTEX) && cm_mailboxSupports(data.order))
+    {
+        // - ordre simple par la boîte aux lettres du master (ni sémaphore ni tube)
+        CmMailbox *mailbox = cm_mailboxAttach();
+        CmAnswer answer;
+        cm_mailboxOrderIn(mailbox, data.set, data.order, data.elt, &answer);
+        cm_mailboxDetach(mailbox);
+        printAnswer(&data, &answer);
+    }
     else
     {
-        // - entrée en section critique
-        struct sembuf operationMoins = {0, -1, 0}; //definition des opérations sur les sémaphores
-        struct sembuf operationPlus = {0, +1, 0};
-        
-        int semId1 = semget(KEY1, 1, 0);
-        myassert(semId1 != -1, "error main client.c : echec ouverture sema 1");
-
-        int semId2 = semget(KEY2, 1, 0);
-        myassert(semId2 != -1, "error main client.c : echec ouverture sema 2");
-
-        int retsem2 = semop(semId2, &operationMoins, 1);
-        myassert(retsem2 != -1, "error main client.c : echec 'vendre' sémaphore");
-        
-        // - ouverture des tubes nommés
-        data.fdClientToMaster = open("pipe1", O_WRONLY);
-        myassert(data.fdClientToMaster  != -1, "error main client.c : echec ouverture ecriture pipe ClientToMaster");
-        //printf("CLIENT : ouverture écriture ClienToMaster ok !\n");
-
-        data.fdMasterToClient = open("pipe2", O_RDONLY);
-        myassert(data.fdClientToMaster != -1, "error main client.c : echec ouverture lecture pipe MasterToClient");
-        //printf("CLIENT : ouverture lecture MasterToClient ok !\n");
-
-        sendData(&data);
-        receiveAnswer(&data);
-
-        // - débloque le master
-        int retsem1 = semop(semId1, &operationPlus, 1);
-        myassert(retsem1 != -1, "error main client.c : echec 'acheter' sémaphore 1");
+        // - entrée en section critique, ouverture des tubes nommés
+        cm_openSession(&(data.session));
 
-        // - libération des ressources (fermeture des tubes) 
-        int ret1 = close(data.fdClientToMaster);
-        myassert(ret1 == 0, "error main client : echec fermeture pipe ClientTomaster");
-
-        int ret2 = close(data.fdMasterToClient);
-        myassert(ret2 == 0, "error main client : echec fermeture pipe MasterToClient");
+        elt_t *tab = sendData(&data);
+        receiveAnswer(&data);
+        free(tab);
 
-        //sortie de la section critique
-        //on rend le sémaphore après la bonne execution des closes
-        retsem2 = semop(semId2, &operationPlus, 1);
-        myassert(retsem2 != -1, "error main client.c : echec 'acheter' sémaphore 2");
+        // - fermeture des tubes, déblocage du master, sortie de la section critique
+        cm_closeSession(&(data.session), data.order);
     }
     return EXIT_SUCCESS;
 }
@@ -2,14 +2,892 @@
 #include "config.h"
 #endif
 
-#define _XOPEN_SOURCE
+// vmsplice(), syscall()
+#define _GNU_SOURCE
 
-//TODO include selon ce qu'il y a dans le .h
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/sem.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include "utils.h"
 #include "myassert.h"
 
 #include "client_master.h"
+#include "trace.h"
 
-//TODO fonctions selon ce qu'il y a dans le .h
 
+/************************************************************************
+ * lecture/écriture complètes
+ ************************************************************************/
+void cm_readAll(int fd, void *buf, size_t size)
+{
+    char *dest = (char *) buf;
+    while (size > 0)
+    {
+        ssize_t ret = read(fd, dest, size);
+        myassert(ret > 0, "echec lecture tube");
+        dest += ret;
+        size -= ret;
+    }
+}
+
+void cm_writeAll(int fd, const void *buf, size_t size)
+{
+    const char *src = (const char *) buf;
+    while (size > 0)
+    {
+        ssize_t ret = write(fd, src, size);
+        myassert(ret > 0, "echec écriture tube");
+        src += ret;
+        size -= ret;
+    }
+}
+
+
+// le tampon est prêté au tube (sans recopie) ; à défaut, écriture ordinaire
+static void vmspliceAll(int fd, const void *buf, size_t size)
+{
+    const char *src = (const char *) buf;
+    while (size > 0)
+    {
+        struct iovec iov = { (void *) src, size };
+        ssize_t ret = vmsplice(fd, &iov, 1, 0);
+        if ((ret == -1) && ((errno == EINVAL) || (errno == ENOSYS)))
+        {
+            cm_writeAll(fd, src, size);
+            return;
+        }
+        myassert(ret > 0, "echec écriture tube");
+        src += ret;
+        size -= ret;
+    }
+}
+
+
+/************************************************************************
+ * transmission d'un insertmany
+ ************************************************************************/
+int cm_bulkMode(void)
+{
+    const char *env = getenv(CM_ENV_BULK);
+    if (env == NULL)
+        return CM_BULK_SPLICE;
+    for (int mode = CM_BULK_ELEMENT; mode <= CM_BULK_SPLICE; mode++)
+        if (strcmp(env, cm_bulkName(mode)) == 0)
+            return mode;
+    return CM_BULK_SPLICE;
+}
+
+const char * cm_bulkName(int mode)
+{
+    switch (mode)
+    {
+      case CM_BULK_ELEMENT: return "element";
+      case CM_BULK_COPY:    return "copy";
+      default:              return "splice";
+    }
+}
+
+
+/************************************************************************
+ * statistiques des ordres
+ ************************************************************************/
+// format : int nb, puis pour chaque type d'ordre
+//    int order, uint64_t misses, errors, count, min, max, sum,
+//    int nbBuckets, puis nbBuckets couples (int indice, uint64_t effectif)
+void cm_writeStats(int fd, const CmOrderStats * const stats[], int nb)
+{
+    cm_writeAll(fd, &nb, sizeof(int));
+    for (int i = 0; i < nb; i++)
+    {
+        const CmOrderStats *st = stats[i];
+        const Histogram *h = &(st->latency);
+        uint64_t header[6] = { st->misses, st->errors, h->count, h->min, h->max, h->sum };
+        cm_writeAll(fd, &(st->order), sizeof(int));
+        cm_writeAll(fd, header, sizeof(header));
+        cm_writeAll(fd, &(st->perf), sizeof(PcTotals));
+
+        int nbBuckets = 0;
+        for (int k = 0; k < HG_NB_BUCKETS; k++)
+            if (h->buckets[k] != 0)
+                nbBuckets++;
+        cm_writeAll(fd, &nbBuckets, sizeof(int));
+        for (int k = 0; k < HG_NB_BUCKETS; k++)
+        {
+            if (h->buckets[k] != 0)
+            {
+                cm_writeAll(fd, &k, sizeof(int));
+                cm_writeAll(fd, &(h->buckets[k]), sizeof(uint64_t));
+            }
+        }
+    }
+}
+
+CmOrderStats * cm_readStats(int fd, int *nb)
+{
+    cm_readAll(fd, nb, sizeof(int));
+    myassert(*nb >= 0, "nombre de statistiques incorrect");
+    CmOrderStats *stats = malloc((*nb > 0 ? *nb : 1) * sizeof(CmOrderStats));
+    myassert(stats != NULL, "echec allocation statistiques");
+
+    for (int i = 0; i < *nb; i++)
+    {
+        CmOrderStats *st = &(stats[i]);
+        Histogram *h = &(st->latency);
+        hg_init(h);
+        uint64_t header[6];
+        cm_readAll(fd, &(st->order), sizeof(int));
+        cm_readAll(fd, header, sizeof(header));
+        cm_readAll(fd, &(st->perf), sizeof(PcTotals));
+        st->misses = header[0];
+        st->errors = header[1];
+        h->count = header[2];
+        h->min = header[3];
+        h->max = header[4];
+        h->sum = header[5];
+
+        int nbBuckets;
+        cm_readAll(fd, &nbBuckets, sizeof(int));
+        for (int j = 0; j < nbBuckets; j++)
+        {
+            int k;
+            cm_readAll(fd, &k, sizeof(int));
+            myassert((k >= 0) && (k < HG_NB_BUCKETS), "classe d'histogramme incorrecte");
+            cm_readAll(fd, &(h->buckets[k]), sizeof(uint64_t));
+        }
+    }
+    return stats;
+}
+
+
+/************************************************************************
+ * forme de l'arbre des workers
+ ************************************************************************/
+void cm_writeTreeStats(int fd, const CmTreeStats *tree)
+{
+    myassert(tree->maxDepth >= 0, "profondeur incorrecte");
+    cm_writeAll(fd, tree, offsetof(CmTreeStats, depths));
+    cm_writeAll(fd, tree->depths, tree->maxDepth * sizeof(int));
+}
+
+void cm_readTreeStats(int fd, CmTreeStats *tree)
+{
+    cm_readAll(fd, tree, offsetof(CmTreeStats, depths));
+    myassert(tree->maxDepth >= 0, "profondeur incorrecte");
+    tree->depths = NULL;
+    if (tree->maxDepth > 0)
+    {
+        tree->depths = malloc(tree->maxDepth * sizeof(int));
+        myassert(tree->depths != NULL, "echec allocation des profondeurs");
+        cm_readAll(fd, tree->depths, tree->maxDepth * sizeof(int));
+    }
+}
+
+
+/************************************************************************
+ * espaces de noms
+ ************************************************************************/
+int cm_namespace(void)
+{
+    static int ns = -1;
+    if (ns == -1)
+    {
+        const char *env = getenv(CM_ENV_SHARD);
+        int value = 0;
+        if (env != NULL)
+        {
+            char *end;
+            long l = strtol(env, &end, 10);
+            myassert((end != env) && (*end == '\0') && (l >= 0) && (l < CM_MAX_SHARDS),
+                     "MWC_SHARD incorrecte");
+            value = (int) l;
+        }
+        ns = value;
+    }
+    return ns;
+}
+
+key_t cm_semKey(int ns, int which)
+{
+    return ftok("./", 2 * ns + which);
+}
+
+void cm_name(char *name, const char *base, int ns)
+{
+    if (ns == 0)
+        snprintf(name, CM_NAME_MAX, "%s", base);
+    else
+        snprintf(name, CM_NAME_MAX, "%s.%d", base, ns);
+}
+
+
+/************************************************************************
+ * ouverture/fermeture d'une session
+ ************************************************************************/
+void cm_openSession(CmSession *session)
+{
+    cm_openSessionOn(session, cm_namespace());
+}
+
+void cm_openSessionOn(CmSession *session, int ns)
+{
+    myassert(session != NULL, "il faut une session");
+    tr_event(TR_SESSION, CM_ORDER_NONE, 0, 0);
+
+    // - entrée en section critique
+    struct sembuf operationMoins = {0, -1, 0};
+
+    session->semId1 = semget(cm_semKey(ns, 1), 1, 0);
+    myassert(session->semId1 != -1, "echec ouverture sema 1");
+
+    session->semId2 = semget(cm_semKey(ns, 2), 1, 0);
+    myassert(session->semId2 != -1, "echec ouverture sema 2");
+
+    int retsem2 = semop(session->semId2, &operationMoins, 1);
+    myassert(retsem2 != -1, "echec 'vendre' sémaphore 2");
+
+    // - ouverture des tubes nommés (même ordre que le master)
+    char name[CM_NAME_MAX];
+    cm_name(name, CM_PIPE_CLIENT_TO_MASTER, ns);
+    session->fdClientToMaster = open(name, O_WRONLY);
+    myassert(session->fdClientToMaster != -1, "echec ouverture ecriture pipe ClientToMaster");
+
+    cm_name(name, CM_PIPE_MASTER_TO_CLIENT, ns);
+    session->fdMasterToClient = open(name, O_RDONLY);
+    myassert(session->fdMasterToClient != -1, "echec ouverture lecture pipe MasterToClient");
+}
+
+void cm_closeSession(CmSession *session, int order)
+{
+    myassert(session != NULL, "il faut une session");
+
+    struct sembuf operationPlus = {0, +1, 0};
+
+    // - libération des ressources (fermeture des tubes)
+    //   avant de débloquer le master : sinon il peut rouvrir les tubes
+    //   nommés alors que nos extrémités sont encore ouvertes et lire une
+    //   fin de fichier à la place de l'ordre du client suivant
+    int ret1 = close(session->fdClientToMaster);
+    myassert(ret1 == 0, "echec fermeture pipe ClientTomaster");
+
+    int ret2 = close(session->fdMasterToClient);
+    myassert(ret2 == 0, "echec fermeture pipe MasterToClient");
+
+    // - débloque le master, qui libère à son tour le sémaphore 2 (sortie
+    //   de la section critique) après avoir fermé ses propres extrémités
+    //   (après un ordre stop le master a pu détruire les sémaphores entre temps)
+    int retsem1 = semop(session->semId1, &operationPlus, 1);
+    myassert(retsem1 != -1 || order == CM_ORDER_STOP, "echec 'acheter' sémaphore 1");
+    tr_event(TR_SESSION_END, order, 0, 0);
+}
+
+
+/************************************************************************
+ * envoi d'un ordre, réception d'une réponse
+ ************************************************************************/
+void cm_sendOrder(const CmSession *session, int order, elt_t elt, const elt_t *tab, int nb)
+{
+    cm_sendOrderIn(session, CM_SET_DEFAULT, order, elt, tab, nb);
+}
+
+void cm_sendOrderIn(const CmSession *session, int set, int order, elt_t elt, const elt_t *tab, int nb)
+{
+    myassert(session != NULL, "il faut une session");
+
+    //l'ordre et son ensemble en une seule écriture
+    int header[2] = { order, set };
+    cm_writeAll(session->fdClientToMaster, header, sizeof(header));
+
+    // paramètres supplémentaires
+    if ((order == CM_ORDER_INSERT) || (order == CM_ORDER_EXIST))
+        cm_writeAll(session->fdClientToMaster, &elt, sizeof(elt_t));
+    else if (order == CM_ORDER_INSERT_MANY)
+    {
+        myassert(tab != NULL, "il faut un tableau à insérer");
+        cm_writeAll(session->fdClientToMaster, &nb, sizeof(int));
+        if (cm_bulkMode() == CM_BULK_SPLICE)
+            vmspliceAll(session->fdClientToMaster, tab, nb * sizeof(elt_t));
+        else
+            cm_writeAll(session->fdClientToMaster, tab, nb * sizeof(elt_t));
+    }
+}
+
+void cm_receiveAnswer(const CmSession *session, CmAnswer *answer)
+{
+    myassert(session != NULL, "il faut une session");
+    myassert(answer != NULL, "il faut une réponse");
+    int fd = session->fdMasterToClient;
+
+    answer->nbStats = 0;
+    answer->stats = NULL;
+    answer->tree.depths = NULL;
+    cm_readAll(fd, &(answer->code), sizeof(int));
+
+    // données supplémentaires selon la réponse
+    switch (answer->code)
+    {
+      case CM_ANSWER_EXIST_YES:
+        cm_readAll(fd, &(answer->quantity), sizeof(int));
+        break;
+      case CM_ANSWER_SUM_OK:
+        cm_readAll(fd, &(answer->sum), sizeof(eltsum_t));
+        break;
+      case CM_ANSWER_MINIMUM_OK:
+      case CM_ANSWER_MAXIMUM_OK:
+        cm_readAll(fd, &(answer->elt), sizeof(elt_t));
+        break;
+      case CM_ANSWER_HOW_MANY_OK:
+        cm_readAll(fd, &(answer->nbTotal), sizeof(int));
+        cm_readAll(fd, &(answer->nbDistinct), sizeof(int));
+        break;
+      case CM_ANSWER_STATS_OK:
+        answer->stats = cm_readStats(fd, &(answer->nbStats));
+        cm_readAll(fd, &(answer->exist), sizeof(CmExistStats));
+        break;
+      case CM_ANSWER_TREESTATS_OK:
+        cm_readTreeStats(fd, &(answer->tree));
+        break;
+      default:
+        break;
+    }
+}
+
+void cm_freeAnswer(CmAnswer *answer)
+{
+    free(answer->stats);
+    answer->stats = NULL;
+    answer->nbStats = 0;
+    free(answer->tree.depths);
+    answer->tree.depths = NULL;
+}
+
+
+/************************************************************************
+ * boîte aux lettres en mémoire partagée
+ ************************************************************************/
+// tours d'attente active avant de dormir (seulement s'il y a plusieurs
+// processeurs : sinon celui qui doit répondre ne peut pas avancer)
+#define MAILBOX_SPIN        2000
+// période de vérification que le master est toujours là pendant une attente
+#define MAILBOX_CHECK_NS    100000000ULL
+// pause entre deux parcours d'une boîte pleine
+#define MAILBOX_FULL_NS     1000000L
+
+int cm_handshakeMode(void)
+{
+    const char *env = getenv(CM_ENV_HANDSHAKE);
+    if ((env != NULL) && (strcmp(env, cm_handshakeName(CM_HANDSHAKE_FUTEX)) == 0))
+        return CM_HANDSHAKE_FUTEX;
+    return CM_HANDSHAKE_FIFO;
+}
+
+const char * cm_handshakeName(int mode)
+{
+    return (mode == CM_HANDSHAKE_FUTEX) ? "futex" : "fifo";
+}
+
+bool cm_mailboxSupports(int order)
+{
+    switch (order)
+    {
+      case CM_ORDER_HOW_MANY:
+      case CM_ORDER_MINIMUM:
+      case CM_ORDER_MAXIMUM:
+      case CM_ORDER_EXIST:
+      case CM_ORDER_SUM:
+      case CM_ORDER_INSERT:
+        return true;
+      default:
+        return false;
+    }
+}
+
+bool cm_isReadOrder(int order)
+{
+    return cm_mailboxSupports(order) && (order != CM_ORDER_INSERT);
+}
+
+void cm_futexWait(uint32_t *addr, uint32_t value, uint64_t timeoutNs)
+{
+    struct timespec timeout = { (time_t) (timeoutNs / 1000000000ULL), (long) (timeoutNs % 1000000000ULL) };
+    long ret = syscall(SYS_futex, addr, FUTEX_WAIT, value, (timeoutNs > 0) ? &timeout : NULL, NULL, 0);
+    myassert((ret == 0) || (errno == EAGAIN) || (errno == EINTR) || (errno == ETIMEDOUT), "echec attente futex");
+}
+
+void cm_futexWake(uint32_t *addr, int nb)
+{
+    long ret = syscall(SYS_futex, addr, FUTEX_WAKE, nb, NULL, NULL, 0);
+    myassert(ret != -1, "echec réveil futex");
+}
+
+// false si le master s'est arrêté (normalement ou non)
+static bool mailboxAlive(const CmMailbox *mailbox)
+{
+    if (! __atomic_load_n(&(mailbox->open), __ATOMIC_ACQUIRE))
+        return false;
+    return (kill(mailbox->masterPid, 0) == 0) || (errno != ESRCH);
+}
+
+CmMailbox * cm_mailboxAttach(void)
+{
+    return cm_mailboxAttachOn(cm_namespace());
+}
+
+CmMailbox * cm_mailboxAttachOn(int ns)
+{
+    char name[CM_NAME_MAX];
+    cm_name(name, CM_MAILBOX, ns);
+    int fd = open(name, O_RDWR);
+    myassert(fd != -1, "echec ouverture boîte aux lettres (pas de master ?)");
+    struct stat st;
+    int ret = fstat(fd, &st);
+    myassert((ret == 0) && (st.st_size == (off_t) sizeof(CmMailbox)), "boîte aux lettres incorrecte");
+    CmMailbox *mailbox = mmap(NULL, sizeof(CmMailbox), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    myassert(mailbox != MAP_FAILED, "echec projection boîte aux lettres");
+    close(fd);
+    myassert(mailboxAlive(mailbox), "le master est arrêté");
+    return mailbox;
+}
+
+void cm_mailboxDetach(CmMailbox *mailbox)
+{
+    int ret = munmap(mailbox, sizeof(CmMailbox));
+    myassert(ret == 0, "echec libération boîte aux lettres");
+}
+
+// reprise d'une case réservée (CLAIMED) ou répondue (ANSWER) dont le
+// client est mort sans la libérer : sans cela 64 clients tués suffiraient
+// à bloquer la boîte. Le pid est d'abord remis à 0 par un échange
+// atomique, si bien qu'une seule reprise peut réussir ; seul le master
+// change encore l'état d'une telle case (REQUEST -> SERVING -> ANSWER),
+// d'où l'échange atomique de l'état, annulé s'il a changé entre-temps
+static bool reclaimSlot(CmSlot *slot)
+{
+    uint32_t state = __atomic_load_n(&(slot->state), __ATOMIC_ACQUIRE);
+    if ((state != CM_SLOT_CLAIMED) && (state != CM_SLOT_ANSWER))
+        return false;
+    int owner = __atomic_load_n(&(slot->owner), __ATOMIC_ACQUIRE);
+    if ((owner == 0) || (kill(owner, 0) == 0) || (errno != ESRCH))
+        return false;
+    if (! __atomic_compare_exchange_n(&(slot->owner), &owner, 0, false,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return false;
+    if (__atomic_compare_exchange_n(&(slot->state), &state, CM_SLOT_FREE, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return true;
+    __atomic_store_n(&(slot->owner), owner, __ATOMIC_RELEASE);
+    return false;
+}
+
+// réservation d'une case libre (en commençant par une case propre au
+// processus pour limiter les collisions) ; boîte pleine : reprise des
+// cases des clients morts, puis courte pause avant un nouveau parcours
+static CmSlot * claimSlot(CmMailbox *mailbox)
+{
+    int first = getpid() % CM_MAILBOX_SLOTS;
+    while (true)
+    {
+        for (int i = 0; i < CM_MAILBOX_SLOTS; i++)
+        {
+            CmSlot *slot = &(mailbox->slots[(first + i) % CM_MAILBOX_SLOTS]);
+            uint32_t expected = CM_SLOT_FREE;
+            if (__atomic_compare_exchange_n(&(slot->state), &expected, CM_SLOT_CLAIMED, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            {
+                __atomic_store_n(&(slot->owner), (int) getpid(), __ATOMIC_RELEASE);
+                return slot;
+            }
+        }
+        myassert(mailboxAlive(mailbox), "le master est arrêté");
+        bool reclaimed = false;
+        for (int i = 0; i < CM_MAILBOX_SLOTS; i++)
+            reclaimed |= reclaimSlot(&(mailbox->slots[i]));
+        if (! reclaimed)
+        {
+            struct timespec delay = { 0, MAILBOX_FULL_NS };
+            nanosleep(&delay, NULL);
+        }
+    }
+}
+
+void cm_mailboxOrder(CmMailbox *mailbox, int order, elt_t elt, CmAnswer *answer)
+{
+    cm_mailboxOrderIn(mailbox, CM_SET_DEFAULT, order, elt, answer);
+}
+
+void cm_mailboxOrderIn(CmMailbox *mailbox, int set, int order, elt_t elt, CmAnswer *answer)
+{
+    myassert(mailbox != NULL, "il faut une boîte aux lettres");
+    myassert(cm_mailboxSupports(order), "ordre non accepté par la boîte aux lettres");
+    tr_event(TR_SESSION, order, 0, 0);
+
+    CmSlot *slot = claimSlot(mailbox);
+    slot->order = order;
+    slot->set = set;
+    slot->elt = elt;
+    __atomic_store_n(&(slot->state), CM_SLOT_REQUEST, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&(mailbox->seq), 1, __ATOMIC_SEQ_CST);
+    cm_futexWake(&(mailbox->seq), INT_MAX);
+
+    static long nbCpus = 0;
+    if (nbCpus == 0)
+        nbCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 0; (nbCpus > 1) && (i < MAILBOX_SPIN); i++)
+        if (__atomic_load_n(&(slot->state), __ATOMIC_ACQUIRE) == CM_SLOT_ANSWER)
+            break;
+    uint32_t state;
+    while ((state = __atomic_load_n(&(slot->state), __ATOMIC_ACQUIRE)) != CM_SLOT_ANSWER)
+    {
+        //(REQUEST ou SERVING : on attend un changement de l'état lu)
+        cm_futexWait(&(slot->state), state, MAILBOX_CHECK_NS);
+        //le master répond aux cases en attente avant de fermer la boîte
+        myassert((__atomic_load_n(&(slot->state), __ATOMIC_ACQUIRE) == CM_SLOT_ANSWER)
+                 || mailboxAlive(mailbox), "le master s'est arrêté sans répondre");
+    }
+
+    *answer = slot->answer;
+    answer->nbStats = 0;
+    answer->stats = NULL;
+    answer->tree.depths = NULL;
+    __atomic_store_n(&(slot->owner), 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&(slot->state), CM_SLOT_FREE, __ATOMIC_RELEASE);
+    tr_event(TR_SESSION_END, order, 0, 0);
+}
+
+CmMailbox * cm_mailboxCreate(void)
+{
+    //préparée sous un nom temporaire : un client ne peut pas projeter
+    //un fichier pas encore à la bonne taille
+    char name[CM_NAME_MAX];
+    cm_name(name, CM_MAILBOX, cm_namespace());
+    char tmp[CM_NAME_MAX + 32];
+    snprintf(tmp, sizeof(tmp), "%s.tmp%d", name, (int) getpid());
+    int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    myassert(fd != -1, "echec creation boîte aux lettres");
+    int ret = ftruncate(fd, sizeof(CmMailbox));
+    myassert(ret == 0, "echec dimensionnement boîte aux lettres");
+    CmMailbox *mailbox = mmap(NULL, sizeof(CmMailbox), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    myassert(mailbox != MAP_FAILED, "echec projection boîte aux lettres");
+    close(fd);
+
+    mailbox->masterPid = getpid();
+    __atomic_store_n(&(mailbox->open), 1, __ATOMIC_RELEASE);
+    ret = rename(tmp, name);
+    myassert(ret == 0, "echec publication boîte aux lettres");
+    return mailbox;
+}
+
+void cm_mailboxDestroy(CmMailbox *mailbox)
+{
+    char name[CM_NAME_MAX];
+    cm_name(name, CM_MAILBOX, cm_namespace());
+    int ret = unlink(name);
+    myassert(ret == 0, "echec destruction boîte aux lettres");
+    cm_mailboxDetach(mailbox);
+}
+
+
+/************************************************************************
+ * routeur vers plusieurs masters
+ ************************************************************************/
+bool cm_shardsInit(CmShards *shards)
+{
+    shards->nb = 1;
+    const char *env = getenv(CM_ENV_SHARDS);
+    if ((env == NULL) || (env[0] == '\0'))
+        return true;
+
+    char *copy = strdup(env);
+    myassert(copy != NULL, "echec allocation MWC_SHARDS");
+    bool ok = true;
+    char *save;
+    for (char *tok = strtok_r(copy, ",", &save); ok && (tok != NULL); tok = strtok_r(NULL, ",", &save))
+    {
+        //(conversion exacte : pas de borne 10.5 tronquée pour un type entier ;
+        //nan ou inf, que la première borne ne compare à rien, sont refusés)
+        elt_t bound;
+        ok = elt_parse(tok, &bound) && (shards->nb < CM_MAX_SHARDS);
+#if ! ELT_IS_INTEGER
+        ok = ok && isfinite(bound);
+#endif
+        if (ok)
+        {
+            //bornes strictement croissantes
+            ok = (shards->nb == 1) || (shards->bounds[shards->nb - 2] < bound);
+            shards->bounds[shards->nb - 1] = bound;
+            shards->nb++;
+        }
+    }
+    free(copy);
+    return ok;
+}
+
+int cm_shardOf(const CmShards *shards, elt_t elt)
+{
+    //nombre de bornes <= elt
+    int lo = 0;
+    int hi = shards->nb - 1;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (shards->bounds[mid] <= elt)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// un ordre complet vers un master
+typedef struct {
+    int ns;
+    int set;
+    int order;
+    elt_t elt;
+    const elt_t *tab;
+    int nb;
+    CmAnswer answer;
+    pthread_t thread;
+} ShardCall;
+
+static void callShard(ShardCall *call)
+{
+    if ((cm_handshakeMode() == CM_HANDSHAKE_FUTEX) && cm_mailboxSupports(call->order))
+    {
+        CmMailbox *mailbox = cm_mailboxAttachOn(call->ns);
+        cm_mailboxOrderIn(mailbox, call->set, call->order, call->elt, &(call->answer));
+        cm_mailboxDetach(mailbox);
+    }
+    else
+    {
+        CmSession session;
+        cm_openSessionOn(&session, call->ns);
+        cm_sendOrderIn(&session, call->set, call->order, call->elt, call->tab, call->nb);
+        cm_receiveAnswer(&session, &(call->answer));
+        cm_closeSession(&session, call->order);
+    }
+}
+
+static void * shardThread(void *arg)
+{
+    callShard((ShardCall *) arg);
+    return NULL;
+}
+
+// cumul des statistiques des ordres (même type d'ordre, même case)
+static void mergeOrderStats(CmAnswer *total, const CmAnswer *part)
+{
+    for (int i = 0; i < part->nbStats; i++)
+    {
+        const CmOrderStats *src = &(part->stats[i]);
+        int j = 0;
+        while ((j < total->nbStats) && (total->stats[j].order != src->order))
+            j++;
+        if (j == total->nbStats)
+        {
+            total->stats = realloc(total->stats, (total->nbStats + 1) * sizeof(CmOrderStats));
+            myassert(total->stats != NULL, "echec allocation statistiques");
+            total->stats[j] = *src;
+            total->nbStats++;
+            continue;
+        }
+        CmOrderStats *dst = &(total->stats[j]);
+        dst->misses += src->misses;
+        dst->errors += src->errors;
+        hg_merge(&(dst->latency), &(src->latency));
+        dst->perf.nbSamples += src->perf.nbSamples;
+        dst->perf.mask |= src->perf.mask;
+        for (int k = 0; k < PC_NB_COUNTERS; k++)
+            dst->perf.values[k] += src->perf.values[k];
+    }
+
+    CmExistStats *dst = &(total->exist);
+    const CmExistStats *src = &(part->exist);
+    dst->bloomBytes += src->bloomBytes;
+    dst->bloomCapacity += src->bloomCapacity;
+    dst->bloomHashes = (src->bloomHashes > dst->bloomHashes) ? src->bloomHashes : dst->bloomHashes;
+    dst->bloomTargetFp = (src->bloomTargetFp > dst->bloomTargetFp) ? src->bloomTargetFp : dst->bloomTargetFp;
+    dst->bloomEstimatedFp = (src->bloomEstimatedFp > dst->bloomEstimatedFp) ? src->bloomEstimatedFp : dst->bloomEstimatedFp;
+    dst->bloomLookups += src->bloomLookups;
+    dst->bloomNegatives += src->bloomNegatives;
+    dst->bloomFalsePositives += src->bloomFalsePositives;
+    dst->cacheBytes += src->cacheBytes;
+    dst->cacheCapacity += src->cacheCapacity;
+    dst->cacheEntries += src->cacheEntries;
+    dst->cacheLookups += src->cacheLookups;
+    dst->cacheHits += src->cacheHits;
+    dst->cacheEvictions += src->cacheEvictions;
+}
+
+// cumul des formes d'arbres (une forêt, un arbre par master)
+static void mergeTreeStats(CmTreeStats *total, const CmTreeStats *part)
+{
+    if (part->maxDepth > total->maxDepth)
+    {
+        total->depths = realloc(total->depths, part->maxDepth * sizeof(int));
+        myassert(total->depths != NULL, "echec allocation des profondeurs");
+        for (int d = total->maxDepth; d < part->maxDepth; d++)
+            total->depths[d] = 0;
+        total->maxDepth = part->maxDepth;
+    }
+    for (int d = 0; d < part->maxDepth; d++)
+        total->depths[d] += part->depths[d];
+    total->nbWorkers += part->nbWorkers;
+    total->nbProcesses += part->nbProcesses;
+    total->maxImbalance = (part->maxImbalance > total->maxImbalance) ? part->maxImbalance : total->maxImbalance;
+    total->nbUnbalanced += part->nbUnbalanced;
+    total->rssKB += part->rssKB;
+    total->nbFds += part->nbFds;
+    total->maxFds = (part->maxFds > total->maxFds) ? part->maxFds : total->maxFds;
+}
+
+// ajout de la réponse <part> (libérée) à <total> ; les intervalles des
+// masters sont disjoints, les nombres d'éléments distincts s'additionnent
+static void gather(CmAnswer *total, CmAnswer *part)
+{
+    if ((total->code == CM_ANSWER_ERROR) || (part->code == CM_ANSWER_ERROR))
+    {
+        cm_freeAnswer(total);
+        total->code = CM_ANSWER_ERROR;
+    }
+    else
+    {
+        switch (part->code)
+        {
+          case CM_ANSWER_HOW_MANY_OK:
+            total->nbTotal += part->nbTotal;
+            total->nbDistinct += part->nbDistinct;
+            break;
+          case CM_ANSWER_MINIMUM_OK:
+            if ((total->code == CM_ANSWER_MINIMUM_EMPTY) || (part->elt < total->elt))
+                total->elt = part->elt;
+            total->code = CM_ANSWER_MINIMUM_OK;
+            break;
+          case CM_ANSWER_MAXIMUM_OK:
+            if ((total->code == CM_ANSWER_MAXIMUM_EMPTY) || (part->elt > total->elt))
+                total->elt = part->elt;
+            total->code = CM_ANSWER_MAXIMUM_OK;
+            break;
+          case CM_ANSWER_SUM_OK:
+            total->sum += part->sum;
+            break;
+          case CM_ANSWER_STATS_OK:
+            mergeOrderStats(total, part);
+            break;
+          case CM_ANSWER_TREESTATS_OK:
+            mergeTreeStats(&(total->tree), &(part->tree));
+            break;
+          default:
+            break;
+        }
+    }
+    cm_freeAnswer(part);
+}
+
+void cm_routeOrder(const CmShards *shards, int set, int order, elt_t elt, const elt_t *tab, int nb,
+                   CmAnswer *answer)
+{
+    myassert((shards != NULL) && (shards->nb >= 1), "il faut au moins un master");
+    myassert(answer != NULL, "il faut une réponse");
+
+    ShardCall calls[CM_MAX_SHARDS];
+    memset(calls, 0, sizeof(calls));
+    for (int i = 0; i < shards->nb; i++)
+    {
+        calls[i].ns = (shards->nb == 1) ? cm_namespace() : i;
+        calls[i].set = set;
+        calls[i].order = order;
+        calls[i].elt = elt;
+        calls[i].tab = tab;
+        calls[i].nb = nb;
+    }
+
+    // - un seul master, ou un ordre ponctuel : pas de fusion
+    if ((shards->nb == 1) || (order == CM_ORDER_EXIST) || (order == CM_ORDER_INSERT))
+    {
+        ShardCall *call = &(calls[cm_shardOf(shards, elt)]);
+        callShard(call);
+        *answer = call->answer;
+        return;
+    }
+
+    // - insertmany : découpage du tableau (ordre des éléments conservé) ;
+    //   un master sans élément ne reçoit rien ; un tableau vide part
+    //   tel quel au premier master
+    bool active[CM_MAX_SHARDS];
+    elt_t *parts = NULL;
+    for (int i = 0; i < shards->nb; i++)
+        active[i] = (order != CM_ORDER_INSERT_MANY) || ((i == 0) && (nb == 0));
+    if ((order == CM_ORDER_INSERT_MANY) && (nb > 0))
+    {
+        parts = malloc(nb * sizeof(elt_t));
+        myassert(parts != NULL, "echec allocation découpage insertmany");
+        int counts[CM_MAX_SHARDS] = { 0 };
+        for (int k = 0; k < nb; k++)
+            counts[cm_shardOf(shards, tab[k])]++;
+        int offset = 0;
+        for (int i = 0; i < shards->nb; i++)
+        {
+            calls[i].tab = parts + offset;
+            calls[i].nb = 0;
+            active[i] = (counts[i] > 0);
+            offset += counts[i];
+        }
+        for (int k = 0; k < nb; k++)
+        {
+            ShardCall *call = &(calls[cm_shardOf(shards, tab[k])]);
+            ((elt_t *) call->tab)[call->nb++] = tab[k];
+        }
+    }
+
+    // - envoi : en parallèle, sauf print (affichages dans l'ordre des
+    //   intervalles)
+    for (int i = 0; i < shards->nb; i++)
+    {
+        if (! active[i])
+            continue;
+        if (order == CM_ORDER_PRINT)
+            callShard(&(calls[i]));
+        else
+        {
+            int ret = pthread_create(&(calls[i].thread), NULL, shardThread, &(calls[i]));
+            myassert(ret == 0, "echec création thread du routeur");
+        }
+    }
+
+    // - fusion des réponses
+    bool first = true;
+    for (int i = 0; i < shards->nb; i++)
+    {
+        if (! active[i])
+            continue;
+        if (order != CM_ORDER_PRINT)
+        {
+            int ret = pthread_join(calls[i].thread, NULL);
+            myassert(ret == 0, "echec attente thread du routeur");
+        }
+        if (first)
+            *answer = calls[i].answer;
+        else
+            gather(answer, &(calls[i].answer));
+        first = false;
+    }
+    free(parts);
+}
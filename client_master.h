@@ -1,8 +1,15 @@
 #ifndef CLIENT_MASTER_H
 #define CLIENT_MASTER_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <sys/sem.h>
 
+#include "element.h"
+#include "histogram.h"
+#include "perfcount.h"
+
 // ordres possibles du client pour le master
 #define CM_ORDER_NONE         -1
 #define CM_ORDER_STOP          0
@@ -15,6 +22,8 @@
 #define CM_ORDER_INSERT_MANY  70
 #define CM_ORDER_PRINT        80
 #define CM_ORDER_LOCAL        90      // ne concerne pas le master
+#define CM_ORDER_STATS       100
+#define CM_ORDER_TREESTATS   110
 
 // réponses possibles du master pour le client
 #define CM_ANSWER_STOP_OK             0       // pour ORDER_STOP : arrêt effectué
@@ -29,16 +38,318 @@
 #define CM_ANSWER_INSERT_OK          60       // pour ORDER_INSERT : insertion effectuée
 #define CM_ANSWER_INSERT_MANY_OK     70       // pour ORDER_INSERT_MANY : insertions effectuées
 #define CM_ANSWER_PRINT_OK           80       // pour ORDER_PRINT : affichage effectué
+#define CM_ANSWER_STATS_OK          100       // pour ORDER_STATS : les statistiques suivent
+#define CM_ANSWER_TREESTATS_OK      110       // pour ORDER_TREESTATS : les statistiques suivent
+#define CM_ANSWER_ERROR              -1       // ordre inconnu
+
+// ensembles d'un master : chaque ordre vise un ensemble, identifié par un
+// entier de [0, CM_MAX_SETS[ (cf. option -s du client) ; le master crée
+// l'arbre d'un ensemble à sa première insertion. Envoi sur le tube nommé :
+// l'ordre puis l'ensemble (deux int), puis les paramètres de l'ordre.
+// stop, stats et treestats (forêt des arbres de tous les ensembles)
+// concernent tout le master, les autres ordres seulement l'ensemble visé ;
+// filtre de Bloom, cache, routage direct, instantané et répliques ne
+// suivent que l'ensemble par défaut.
+#define CM_SET_DEFAULT      0
+#define CM_MAX_SETS       256
+
+#define KEY1 (cm_semKey(cm_namespace(), 1))
+#define KEY2 (cm_semKey(cm_namespace(), 2))
+
+// tubes nommés partagés par tous les clients (noms de base, cf. cm_name)
+#define CM_PIPE_CLIENT_TO_MASTER "pipe1"
+#define CM_PIPE_MASTER_TO_CLIENT "pipe2"
+
+
+/******************************************
+ * espaces de noms (plusieurs masters côte à côte)
+ ******************************************/
+// Chaque master a son espace de noms, numéro lu dans la variable
+// d'environnement MWC_SHARD (0 par défaut, noms historiques) :
+//    sémaphores  ftok("./", 2*ns + 1) et ftok("./", 2*ns + 2)
+//    fichiers    pipe1.<ns>, pipe2.<ns>, mailbox.<ns> (pipe1, pipe2,
+//                mailbox pour ns = 0)
+// Les clients lisent la même variable (master unique) ou passent par le
+// routeur (MWC_SHARDS, cf. plus bas).
+#define CM_ENV_SHARD        "MWC_SHARD"
+#define CM_MAX_SHARDS       64
+#define CM_NAME_MAX         64
+
+int cm_namespace(void);
+// clé du sémaphore <which> (1 ou 2) de l'espace <ns>
+key_t cm_semKey(int ns, int which);
+// nom du fichier <base> dans l'espace <ns> (name : CM_NAME_MAX octets)
+void cm_name(char *name, const char *base, int ns);
+
+
+/******************************************
+ * transmission d'un insertmany
+ ******************************************/
+// Choisie par la variable d'environnement MWC_INSERT_MANY (lue par le
+// client et par le master) :
+//    element  un ordre d'insertion du master au premier worker par élément
+//    copy     un seul ordre MW_ORDER_INSERT_MANY : le master lit le tableau
+//             puis le réécrit dans le tube du premier worker
+//    splice   (défaut) idem, mais le master ne lit que l'en-tête et le
+//             tableau passe du tube nommé au tube du premier worker par
+//             splice, sans recopie ; le client l'envoie par vmsplice (le
+//             tableau ne doit pas être modifié avant la réponse)
+#define CM_ENV_BULK         "MWC_INSERT_MANY"
+#define CM_BULK_ELEMENT     0
+#define CM_BULK_COPY        1
+#define CM_BULK_SPLICE      2
+
+int cm_bulkMode(void);
+const char * cm_bulkName(int mode);
+
+
+/******************************************
+ * statistiques des ordres (CM_ORDER_STATS)
+ ******************************************/
+// Le master tient, pour chaque type d'ordre, le nombre d'ordres, de
+// réponses négatives (exist absent, min/max d'un ensemble vide) et
+// d'erreurs, ainsi que l'histogramme des durées de traitement en ns (de
+// la réception de l'ordre à l'envoi de la réponse ; latency.sum est le
+// temps total passé sur ce type d'ordre).
+// Les ordres inconnus sont comptés avec order = CM_ORDER_NONE.
+// perf : compteurs du master pour ce type d'ordre (mode MWC_PERF=on,
+// cf. perfcount.h ; perf.nbSamples vaut 0 sinon).
+typedef struct {
+    int order;
+    uint64_t misses;
+    uint64_t errors;
+    Histogram latency;
+    PcTotals perf;
+} CmOrderStats;
+
+// une case par type d'ordre : CM_STATS_SLOT(CM_ORDER_xxx)
+#define CM_STATS_SLOT(order)    ((order) / 10)
+#define CM_NB_STATS_SLOTS       (CM_STATS_SLOT(CM_ORDER_TREESTATS) + 1)
+
+// envoi/réception de <nb> statistiques (seules les classes non vides des
+// histogrammes sont transmises) ; cm_readStats alloue le tableau
+void cm_writeStats(int fd, const CmOrderStats * const stats[], int nb);
+CmOrderStats * cm_readStats(int fd, int *nb);
+
+
+/******************************************
+ * raccourcis des exist du master (CM_ORDER_STATS)
+ ******************************************/
+// Envoyés tels quels après les statistiques des ordres.
+// Filtre de Bloom (MWC_BLOOM, cf. bloom.h) : bloomBytes vaut 0 sans filtre.
+// Cache des éléments demandés (MWC_CACHE, cf. keycache.h) : cacheCapacity
+// vaut 0 sans cache.
+typedef struct {
+    uint64_t bloomBytes;            // mémoire du filtre
+    uint64_t bloomCapacity;         // éléments distincts prévus
+    int bloomHashes;                // fonctions de hachage
+    double bloomTargetFp;           // taux de faux positifs visé
+    double bloomEstimatedFp;        // taux estimé d'après le remplissage
+    uint64_t bloomLookups;          // exist soumis au filtre
+    uint64_t bloomNegatives;        // exist répondus absents par le filtre seul
+    uint64_t bloomFalsePositives;   // passés aux workers, qui ont répondu absent
+    uint64_t cacheBytes;            // mémoire du cache
+    int cacheCapacity;              // entrées
+    int cacheEntries;               // entrées occupées
+    uint64_t cacheLookups;          // exist soumis au cache
+    uint64_t cacheHits;             // exist répondus par le cache seul
+    uint64_t cacheEvictions;        // entrées remplacées
+} CmExistStats;
+
+
+/******************************************
+ * forme de l'arbre des workers (CM_ORDER_TREESTATS)
+ ******************************************/
+// Permet de voir si l'arbre binaire de recherche a dégénéré en liste
+// (insertions triées) : profondeur proche du nombre de workers. Les arbres
+// de tous les ensembles et des répliques (cf. replica.h) sont additionnés
+// niveau par niveau.
+typedef struct {
+    int maxDepth;       // nombre de niveaux de workers (0 si l'ensemble est vide)
+    int nbWorkers;
+    int nbProcesses;    // workers et master
+    int maxImbalance;   // plus grand écart de hauteur entre deux sous-arbres frères
+    int nbUnbalanced;   // nombre de workers dont cet écart dépasse 1
+    long rssKB;         // mémoire résidente totale (workers et master, Ko)
+    int nbFds;          // descripteurs ouverts au total
+    int maxFds;         // descripteurs ouverts au plus par processus
+    int *depths;        // maxDepth entiers : nombre de workers à chaque profondeur
+} CmTreeStats;
+
+// envoi/réception ; cm_readTreeStats alloue depths
+void cm_writeTreeStats(int fd, const CmTreeStats *tree);
+void cm_readTreeStats(int fd, CmTreeStats *tree);
+
+
+/******************************************
+ * session d'un client avec le master
+ ******************************************/
+// Un ordre = une session :
+//    cm_openSession     prise du sémaphore 2 (un seul client à la fois)
+//                       et ouverture des tubes nommés
+//    cm_sendOrder       envoi de l'ordre et de ses paramètres
+//    cm_receiveAnswer   réception de la réponse complète
+//    cm_closeSession    fermeture des tubes, déblocage du master
+//                       (sémaphore 1) ; le master libère ensuite le
+//                       sémaphore 2 une fois ses extrémités fermées
+// Utilisé par le client et par les outils de mesure.
+typedef struct {
+    int semId1;
+    int semId2;
+    int fdClientToMaster;
+    int fdMasterToClient;
+} CmSession;
+
+// réponse du master (seuls les champs liés à code sont renseignés)
+typedef struct {
+    int code;           // CM_ANSWER_*
+    int quantity;       // CM_ANSWER_EXIST_YES : nombre d'exemplaires
+    int nbTotal;        // CM_ANSWER_HOW_MANY_OK : nombre d'éléments
+    int nbDistinct;     // CM_ANSWER_HOW_MANY_OK : nombre d'éléments distincts
+    elt_t elt;          // CM_ANSWER_MINIMUM_OK, CM_ANSWER_MAXIMUM_OK
+    eltsum_t sum;       // CM_ANSWER_SUM_OK
+    int nbStats;        // CM_ANSWER_STATS_OK : nombre de types d'ordres
+    CmOrderStats *stats;// CM_ANSWER_STATS_OK : statistiques (cf. cm_freeAnswer)
+    CmExistStats exist; // CM_ANSWER_STATS_OK : raccourcis des exist
+    CmTreeStats tree;   // CM_ANSWER_TREESTATS_OK : forme de l'arbre (cf. cm_freeAnswer)
+} CmAnswer;
+
+void cm_openSession(CmSession *session);
+// idem avec le master de l'espace <ns> (cm_openSession : cm_namespace())
+void cm_openSessionOn(CmSession *session, int ns);
+// <order> : après CM_ORDER_STOP les sémaphores ont pu être détruits par le master
+void cm_closeSession(CmSession *session, int order);
+
+// <elt> : pour CM_ORDER_EXIST et CM_ORDER_INSERT
+// <tab>, <nb> : pour CM_ORDER_INSERT_MANY
+// (cm_sendOrder : ensemble CM_SET_DEFAULT)
+void cm_sendOrder(const CmSession *session, int order, elt_t elt, const elt_t *tab, int nb);
+void cm_sendOrderIn(const CmSession *session, int set, int order, elt_t elt, const elt_t *tab, int nb);
+void cm_receiveAnswer(const CmSession *session, CmAnswer *answer);
+// libération des données allouées par cm_receiveAnswer
+void cm_freeAnswer(CmAnswer *answer);
+
+// lecture/écriture complètes de <size> octets (un tube ne contient que 64Ko)
+void cm_readAll(int fd, void *buf, size_t size);
+void cm_writeAll(int fd, const void *buf, size_t size);
+
+
+/******************************************
+ * boîte aux lettres en mémoire partagée (mode basse latence)
+ ******************************************/
+// Choisie par le client avec la variable d'environnement MWC_HANDSHAKE :
+//    fifo   (défaut) une session complète par ordre (cf. ci-dessus)
+//    futex  les ordres simples (cm_mailboxSupports) passent par la boîte
+//           aux lettres du master, sans sémaphore ni tube nommé :
+//              - le client réserve une case libre (compare-and-swap),
+//                y écrit l'ordre, incrémente seq et réveille le master
+//                (FUTEX_WAKE sur seq) ;
+//              - un thread du master attend sur seq (FUTEX_WAIT), traite
+//                les cases en attente et écrit la réponse dans la même
+//                case, puis réveille le client (FUTEX_WAKE sur state) ;
+//              - le client lit la réponse et libère la case.
+//           Les autres ordres utilisent toujours une session.
+// Le master crée toujours la boîte aux lettres (fichier projeté CM_MAILBOX
+// dans le répertoire courant, comme les tubes nommés) ; ses deux threads
+// s'excluent mutuellement pour parler aux workers. Plusieurs threads du
+// master peuvent parcourir la boîte (répliques, cf. replica.h) : chacun
+// prend une case en la passant de REQUEST à SERVING, et un ordre déposé
+// les réveille tous.
+#define CM_ENV_HANDSHAKE    "MWC_HANDSHAKE"
+#define CM_HANDSHAKE_FIFO   0
+#define CM_HANDSHAKE_FUTEX  1
+
+int cm_handshakeMode(void);
+const char * cm_handshakeName(int mode);
+
+#define CM_MAILBOX          "mailbox"
+#define CM_MAILBOX_SLOTS    64
+
+// états d'une case (mot du futex du client)
+#define CM_SLOT_FREE        0
+#define CM_SLOT_CLAIMED     1       // réservée, ordre en cours d'écriture
+#define CM_SLOT_REQUEST     2       // ordre à traiter par le master
+#define CM_SLOT_ANSWER      3       // réponse disponible
+#define CM_SLOT_SERVING     4       // ordre pris par un thread du master
+
+// une case par ligne de cache (les clients ne se gênent pas entre eux) ;
+// dans answer seuls les champs des réponses simples sont utilisés.
+// owner (pid du client, 0 pendant la réservation et une fois la case
+// libérée) permet de reprendre la case d'un client mort avant de la
+// libérer (cf. claimSlot)
+typedef struct {
+    uint32_t state;
+    int owner;
+    int order;
+    int set;
+    elt_t elt;
+    CmAnswer answer;
+} __attribute__((aligned(64))) CmSlot;
+
+typedef struct {
+    uint32_t seq;       // mot du futex du master : une incrémentation par ordre déposé
+    uint32_t open;      // 0 une fois le master arrêté
+    int masterPid;      // pour détecter un master disparu sans fermer la boîte
+    CmSlot slots[CM_MAILBOX_SLOTS];
+} CmMailbox;
+
+// ordres acceptés par la boîte aux lettres (réponse de taille fixe)
+bool cm_mailboxSupports(int order);
+// parmi eux, les lectures (howmany, min, max, exist, sum)
+bool cm_isReadOrder(int order);
+
+// côté client : projection de la boîte aux lettres du master (erreur s'il
+// n'y a pas de master), ordre complet (réservation, envoi, attente de la
+// réponse, libération de la case)
+CmMailbox * cm_mailboxAttach(void);
+CmMailbox * cm_mailboxAttachOn(int ns);
+void cm_mailboxDetach(CmMailbox *mailbox);
+void cm_mailboxOrder(CmMailbox *mailbox, int order, elt_t elt, CmAnswer *answer);
+void cm_mailboxOrderIn(CmMailbox *mailbox, int set, int order, elt_t elt, CmAnswer *answer);
+
+// côté master : création (publiée sous le nom CM_MAILBOX de son espace
+// une fois prête) et destruction
+CmMailbox * cm_mailboxCreate(void);
+void cm_mailboxDestroy(CmMailbox *mailbox);
+
+// attente tant que *addr vaut <value> (réveils parasites possibles ;
+// <timeoutNs> à 0 : sans limite) et réveil de <nb> attentes sur addr
+void cm_futexWait(uint32_t *addr, uint32_t value, uint64_t timeoutNs);
+void cm_futexWake(uint32_t *addr, int nb);
+
+
+/******************************************
+ * routeur vers plusieurs masters (partitionnement par intervalles)
+ ******************************************/
+// Variable d'environnement MWC_SHARDS=<b1>,...,<bk> (côté client, bornes
+// strictement croissantes) : k+1 masters d'espaces 0..k, le master i
+// possédant les éléments de [b(i), b(i+1)[ (b0 = -inf, b(k+1) = +inf).
+// Sans la variable, un seul master, celui de cm_namespace().
+// cm_routeOrder traite un ordre complet :
+//    exist, insert   envoyés au seul master propriétaire
+//    insertmany      tableau découpé, une part par master concerné
+//    autres ordres   envoyés à tous les masters en parallèle (un thread
+//                    chacun), réponses fusionnées : howmany et sum
+//                    additionnés, min/max des ensembles non vides,
+//                    statistiques cumulées (cf. cm_freeAnswer) ; print
+//                    est envoyé dans l'ordre des masters, pour un
+//                    affichage trié
+// Chaque master est joint par session, ou par sa boîte aux lettres en
+// mode MWC_HANDSHAKE=futex pour les ordres qu'elle accepte.
+// Une réponse d'erreur d'un master donne une réponse d'erreur.
+#define CM_ENV_SHARDS       "MWC_SHARDS"
 
-//TODO
-// Vous pouvez mettre ici des informations soit communes au client et au
-// master, soit liées aux deux :
-// . structures de données
-// . création/libération/initialisation de ressources (sémaphores, tubes, ...)
-// . communications
-//END TODO
+typedef struct {
+    int nb;                             // nombre de masters
+    elt_t bounds[CM_MAX_SHARDS - 1];    // nb - 1 bornes
+} CmShards;
 
-#define KEY1 (ftok("./", 1))
-#define KEY2 (ftok("./", 2))
+// false si MWC_SHARDS est incorrecte
+bool cm_shardsInit(CmShards *shards);
+// indice du master propriétaire de <elt>
+int cm_shardOf(const CmShards *shards, elt_t elt);
+// (ordre pour l'ensemble <set> de chaque master)
+void cm_routeOrder(const CmShards *shards, int set, int order, elt_t elt, const elt_t *tab, int nb,
+                   CmAnswer *answer);
 
 #endif
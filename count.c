@@ -0,0 +1,265 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "myassert.h"
+
+#include "count.h"
+
+#if defined __x86_64__ || defined __i386__
+    #define CNT_X86
+    #include <immintrin.h>
+#endif
+
+
+/************************************************************************
+ * noyau scalaire (toujours disponible)
+ ************************************************************************/
+static long countScalar(const elt_t *tab, long n, elt_t val)
+{
+    long count = 0;
+    for (long i = 0; i < n; i++)
+        count += (tab[i] == val);
+    return count;
+}
+
+
+#ifdef CNT_X86
+/************************************************************************
+ * primitives vectorielles selon le type des éléments
+ ************************************************************************/
+// Les comparaisons SSE2/AVX2 produisent -1 (tous les bits à 1) dans chaque
+// voie égale : on soustrait ce résultat d'un accumulateur par voie.
+// Les voies font la taille d'un élément (lane_t) ; on vide les
+// accumulateurs tous les CNT_BLOCK vecteurs pour éviter tout débordement.
+// AVX-512 produit directement un masque de bits que l'on compte.
+#define CNT_BLOCK (1L << 24)
+
+#if defined ELT_DOUBLE
+    typedef uint64_t lane_t;
+    #define SSE_T               __m128d
+    #define SSE_SET1(x)         _mm_set1_pd(x)
+    #define SSE_EQ(p, v)        _mm_castpd_si128(_mm_cmpeq_pd(_mm_loadu_pd(p), (v)))
+    #define SSE_SUB(a, b)       _mm_sub_epi64((a), (b))
+    #define AVX_T               __m256d
+    #define AVX_SET1(x)         _mm256_set1_pd(x)
+    #define AVX_EQ(p, v)        _mm256_castpd_si256(_mm256_cmp_pd(_mm256_loadu_pd(p), (v), _CMP_EQ_OQ))
+    #define AVX_SUB(a, b)       _mm256_sub_epi64((a), (b))
+    #define AVX512_T            __m512d
+    #define AVX512_SET1(x)      _mm512_set1_pd(x)
+    #define AVX512_EQ(p, v)     _mm512_cmpeq_pd_mask(_mm512_loadu_pd(p), (v))
+#elif defined ELT_INT32
+    typedef uint32_t lane_t;
+    #define SSE_T               __m128i
+    #define SSE_SET1(x)         _mm_set1_epi32(x)
+    #define SSE_EQ(p, v)        _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *) (p)), (v))
+    #define SSE_SUB(a, b)       _mm_sub_epi32((a), (b))
+    #define AVX_T               __m256i
+    #define AVX_SET1(x)         _mm256_set1_epi32(x)
+    #define AVX_EQ(p, v)        _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *) (p)), (v))
+    #define AVX_SUB(a, b)       _mm256_sub_epi32((a), (b))
+    #define AVX512_T            __m512i
+    #define AVX512_SET1(x)      _mm512_set1_epi32(x)
+    #define AVX512_EQ(p, v)     _mm512_cmpeq_epi32_mask(_mm512_loadu_si512(p), (v))
+#elif defined ELT_INT64
+    typedef uint64_t lane_t;
+    // SSE2 n'a pas de comparaison 64 bits : égalité des deux moitiés 32 bits
+    __attribute__((target("sse2")))
+    static inline __m128i sse2_cmpeq_epi64(__m128i a, __m128i b)
+    {
+        __m128i c = _mm_cmpeq_epi32(a, b);
+        return _mm_and_si128(c, _mm_shuffle_epi32(c, _MM_SHUFFLE(2, 3, 0, 1)));
+    }
+    #define SSE_T               __m128i
+    #define SSE_SET1(x)         _mm_set1_epi64x(x)
+    #define SSE_EQ(p, v)        sse2_cmpeq_epi64(_mm_loadu_si128((const __m128i *) (p)), (v))
+    #define SSE_SUB(a, b)       _mm_sub_epi64((a), (b))
+    #define AVX_T               __m256i
+    #define AVX_SET1(x)         _mm256_set1_epi64x(x)
+    #define AVX_EQ(p, v)        _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *) (p)), (v))
+    #define AVX_SUB(a, b)       _mm256_sub_epi64((a), (b))
+    #define AVX512_T            __m512i
+    #define AVX512_SET1(x)      _mm512_set1_epi64(x)
+    #define AVX512_EQ(p, v)     _mm512_cmpeq_epi64_mask(_mm512_loadu_si512(p), (v))
+#else
+    typedef uint32_t lane_t;
+    #define SSE_T               __m128
+    #define SSE_SET1(x)         _mm_set1_ps(x)
+    #define SSE_EQ(p, v)        _mm_castps_si128(_mm_cmpeq_ps(_mm_loadu_ps(p), (v)))
+    #define SSE_SUB(a, b)       _mm_sub_epi32((a), (b))
+    #define AVX_T               __m256
+    #define AVX_SET1(x)         _mm256_set1_ps(x)
+    #define AVX_EQ(p, v)        _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(p), (v), _CMP_EQ_OQ))
+    #define AVX_SUB(a, b)       _mm256_sub_epi32((a), (b))
+    #define AVX512_T            __m512
+    #define AVX512_SET1(x)      _mm512_set1_ps(x)
+    #define AVX512_EQ(p, v)     _mm512_cmpeq_ps_mask(_mm512_loadu_ps(p), (v))
+#endif
+
+
+/************************************************************************
+ * noyau SSE2 (16 octets par comparaison)
+ ************************************************************************/
+__attribute__((target("sse2")))
+static long countSse2(const elt_t *tab, long n, elt_t val)
+{
+    const long lanes = 16 / sizeof(elt_t);
+    SSE_T v = SSE_SET1(val);
+    long count = 0;
+    long i = 0;
+
+    while (i + lanes <= n)
+    {
+        long end = (n - i > CNT_BLOCK * lanes) ? i + CNT_BLOCK * lanes : n;
+        __m128i acc = _mm_setzero_si128();
+        for (; i + lanes <= end; i += lanes)
+            acc = SSE_SUB(acc, SSE_EQ(tab + i, v));
+
+        lane_t partial[16 / sizeof(lane_t)];
+        _mm_storeu_si128((__m128i *) partial, acc);
+        for (unsigned k = 0; k < 16 / sizeof(lane_t); k++)
+            count += partial[k];
+    }
+    return count + countScalar(tab + i, n - i, val);
+}
+
+
+/************************************************************************
+ * noyau AVX2 (32 octets par comparaison, deux accumulateurs)
+ ************************************************************************/
+__attribute__((target("avx2")))
+static long countAvx2(const elt_t *tab, long n, elt_t val)
+{
+    const long lanes = 32 / sizeof(elt_t);
+    AVX_T v = AVX_SET1(val);
+    long count = 0;
+    long i = 0;
+
+    while (i + 2*lanes <= n)
+    {
+        long end = (n - i > CNT_BLOCK * lanes) ? i + CNT_BLOCK * lanes : n;
+        __m256i acc1 = _mm256_setzero_si256();
+        __m256i acc2 = _mm256_setzero_si256();
+        for (; i + 2*lanes <= end; i += 2*lanes)
+        {
+            acc1 = AVX_SUB(acc1, AVX_EQ(tab + i, v));
+            acc2 = AVX_SUB(acc2, AVX_EQ(tab + i + lanes, v));
+        }
+
+        lane_t partial1[32 / sizeof(lane_t)];
+        lane_t partial2[32 / sizeof(lane_t)];
+        _mm256_storeu_si256((__m256i *) partial1, acc1);
+        _mm256_storeu_si256((__m256i *) partial2, acc2);
+        for (unsigned k = 0; k < 32 / sizeof(lane_t); k++)
+            count += (long) partial1[k] + (long) partial2[k];
+    }
+    return count + countScalar(tab + i, n - i, val);
+}
+
+
+/************************************************************************
+ * noyau AVX-512 (64 octets par comparaison, masque de bits)
+ ************************************************************************/
+__attribute__((target("avx512f")))
+static long countAvx512(const elt_t *tab, long n, elt_t val)
+{
+    const long lanes = 64 / sizeof(elt_t);
+    AVX512_T v = AVX512_SET1(val);
+    long count = 0;
+    long i = 0;
+
+    for (; i + 2*lanes <= n; i += 2*lanes)
+    {
+        count += __builtin_popcount((unsigned) AVX512_EQ(tab + i, v));
+        count += __builtin_popcount((unsigned) AVX512_EQ(tab + i + lanes, v));
+    }
+    return count + countScalar(tab + i, n - i, val);
+}
+#endif
+
+
+/************************************************************************
+ * table de fréquences
+ ************************************************************************/
+void cnt_histogram(const elt_t *tab, long n, double min, double scale, long nbBins, long *table)
+{
+    myassert(n >= 0, "la taille doit être positive");
+    for (long i = 0; i < n; i++)
+    {
+        double x = ((double) tab[i] - min) * scale;
+        long k = ((x >= 0) && (x < nbBins)) ? (long) x : nbBins;
+        table[k]++;
+    }
+}
+
+
+/************************************************************************
+ * choix du noyau à l'exécution
+ ************************************************************************/
+typedef long (*CountKernel)(const elt_t *tab, long n, elt_t val);
+
+typedef struct {
+    const char *name;
+    CountKernel kernel;
+    bool supported;
+} KernelChoice;
+
+static CountKernel chosenKernel = countScalar;
+static const char *chosenName = "scalar";
+static pthread_once_t chosenOnce = PTHREAD_ONCE_INIT;
+
+static void chooseKernel(void)
+{
+    // du plus rapide au plus lent
+    KernelChoice choices[] = {
+#ifdef CNT_X86
+        { "avx512", countAvx512, __builtin_cpu_supports("avx512f") },
+        { "avx2",   countAvx2,   __builtin_cpu_supports("avx2") },
+        { "sse2",   countSse2,   __builtin_cpu_supports("sse2") },
+#endif
+        { "scalar", countScalar, true },
+    };
+    int nbChoices = sizeof(choices) / sizeof(choices[0]);
+
+    // un noyau imposé n'est retenu que si le processeur le supporte
+    const char *forced = getenv("MWC_SIMD");
+    int first = 0;
+    if (forced != NULL)
+    {
+        for (int i = 0; i < nbChoices; i++)
+            if (strcmp(choices[i].name, forced) == 0)
+                first = i;
+    }
+
+    for (int i = first; i < nbChoices; i++)
+    {
+        if (choices[i].supported)
+        {
+            chosenKernel = choices[i].kernel;
+            chosenName = choices[i].name;
+            break;
+        }
+    }
+}
+
+long cnt_countEqual(const elt_t *tab, long n, elt_t val)
+{
+    myassert(n >= 0, "la taille doit être positive");
+    int ret = pthread_once(&chosenOnce, chooseKernel);
+    myassert(ret == 0, "echec choix du noyau de comptage");
+    return chosenKernel(tab, n, val);
+}
+
+const char * cnt_kernelName(void)
+{
+    int ret = pthread_once(&chosenOnce, chooseKernel);
+    myassert(ret == 0, "echec choix du noyau de comptage");
+    return chosenName;
+}
@@ -0,0 +1,25 @@
+#ifndef COUNT_H
+#define COUNT_H
+
+#include "element.h"
+
+/******************************************
+ * comptage vectorisé (mode local)
+ ******************************************/
+// Le noyau est choisi au premier appel selon le processeur (CPUID) :
+// AVX-512, AVX2, SSE2, ou boucle scalaire en dernier recours.
+// La variable d'environnement MWC_SIMD (avx512, avx2, sse2, scalar) permet
+// d'imposer un noyau moins rapide (par exemple pour les comparer).
+
+// nombre d'exemplaires de <val> dans tab[0..n[
+long cnt_countEqual(const elt_t *tab, long n, elt_t val);
+
+// ajoute à table[] la classe de chaque élément de tab[0..n[ : la classe k
+// couvre [min + k/scale, min + (k+1)/scale[ pour k dans 0..nbBins-1, la case
+// table[nbBins] reçoit les éléments hors de [min, min + nbBins/scale[
+void cnt_histogram(const elt_t *tab, long n, double min, double scale, long nbBins, long *table);
+
+// nom du noyau utilisé par cnt_countEqual
+const char * cnt_kernelName(void);
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef ELEMENT_H
+#define ELEMENT_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+
+/******************************************
+ * type des éléments de l'ensemble
+ ******************************************/
+// Le type est choisi à la compilation (cf. variable ELT du Makefile) :
+//    -DELT_FLOAT (défaut), -DELT_DOUBLE, -DELT_INT32 ou -DELT_INT64
+// Tout le code (client, master, workers, protocoles) utilise uniquement
+// elt_t, eltsum_t et les macros ci-dessous : les messages transportent
+// sizeof(elt_t) octets par élément et sizeof(eltsum_t) octets par somme.
+//
+// . elt_t          : un élément
+// . eltsum_t       : une somme d'éléments (plus large pour éviter les débordements)
+// . ELT_NAME       : nom du type (pour les affichages et les benchmarks)
+// . ELT_FMT        : format printf d'un élément
+// . ELT_ARG_FMT    : format printf sans perte (passage d'un élément en ligne de commande)
+// . ELT_SUM_FMT    : format printf d'une somme
+// . ELT_FROM_STR   : conversion chaîne -> élément (sans vérification, pour
+//                    une chaîne écrite avec ELT_ARG_FMT ; cf. elt_parse)
+// . ELT_FROM_REAL  : conversion double -> élément (troncature pour les entiers)
+// . ELT_IS_INTEGER : 1 si le type est entier (la précision des tirages est alors 0)
+
+#if defined ELT_DOUBLE
+    typedef double elt_t;
+    typedef double eltsum_t;
+    #define ELT_NAME            "double"
+    #define ELT_FMT             "%g"
+    #define ELT_ARG_FMT         "%.17g"
+    #define ELT_SUM_FMT         "%g"
+    #define ELT_FROM_STR(s)     strtod((s), NULL)
+    #define ELT_FROM_REAL(d)    ((elt_t) (d))
+    #define ELT_IS_INTEGER      0
+#elif defined ELT_INT32
+    typedef int32_t elt_t;
+    typedef int64_t eltsum_t;
+    #define ELT_NAME            "int32"
+    #define ELT_FMT             "%" PRId32
+    #define ELT_ARG_FMT         "%" PRId32
+    #define ELT_SUM_FMT         "%" PRId64
+    #define ELT_FROM_STR(s)     ((elt_t) strtol((s), NULL, 10))
+    #define ELT_FROM_REAL(d)    ((elt_t) (d))
+    #define ELT_IS_INTEGER      1
+#elif defined ELT_INT64
+    typedef int64_t elt_t;
+    typedef int64_t eltsum_t;
+    #define ELT_NAME            "int64"
+    #define ELT_FMT             "%" PRId64
+    #define ELT_ARG_FMT         "%" PRId64
+    #define ELT_SUM_FMT         "%" PRId64
+    #define ELT_FROM_STR(s)     ((elt_t) strtoll((s), NULL, 10))
+    #define ELT_FROM_REAL(d)    ((elt_t) (d))
+    #define ELT_IS_INTEGER      1
+#else
+    #ifndef ELT_FLOAT
+        #define ELT_FLOAT
+    #endif
+    typedef float elt_t;
+    typedef double eltsum_t;
+    #define ELT_NAME            "float"
+    #define ELT_FMT             "%g"
+    #define ELT_ARG_FMT         "%.9g"
+    #define ELT_SUM_FMT         "%g"
+    #define ELT_FROM_STR(s)     strtof((s), NULL)
+    #define ELT_FROM_REAL(d)    ((elt_t) (d))
+    #define ELT_IS_INTEGER      0
+#endif
+
+// conversion vérifiée chaîne -> élément (saisies de l'utilisateur) : false
+// si la chaîne n'est pas entièrement un élément représentable du type
+// ("abc", "", "10.5" ou "3000000000" pour int32)
+static inline bool elt_parse(const char *s, elt_t *elt)
+{
+    char *end;
+    errno = 0;
+#if ELT_IS_INTEGER
+    long long value = strtoll(s, &end, 10);
+    *elt = (elt_t) value;
+    bool exact = ((long long) *elt == value);
+#elif defined ELT_FLOAT
+    *elt = strtof(s, &end);
+    bool exact = true;
+#else
+    *elt = strtod(s, &end);
+    bool exact = true;
+#endif
+    return exact && (errno == 0) && (end != s) && (*end == '\0');
+}
+
+// splitmix64 : bon mélange de tous les bits en quelques instructions
+static inline uint64_t elt_mix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// hachage d'un élément (filtre de Bloom, cache des clés, instantané)
+static inline uint64_t elt_hash(elt_t elt)
+{
+    //0 et -0 sont le même élément pour les workers (comparaison ==)
+    if (elt == 0)
+        elt = 0;
+    uint64_t x = 0;
+    memcpy(&x, &elt, sizeof(elt_t));
+    return elt_mix(x);
+}
+
+#endif
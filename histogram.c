@@ -0,0 +1,145 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "myassert.h"
+
+#include "histogram.h"
+
+// largeur maximale des barres de hg_print
+#define HG_BAR_WIDTH 50
+
+
+/************************************************************************
+ * enregistrement
+ ************************************************************************/
+void hg_init(Histogram *h)
+{
+    myassert(h != NULL, "il faut un histogramme");
+    memset(h, 0, sizeof(Histogram));
+}
+
+void hg_recordCorrected(Histogram *h, uint64_t value, uint64_t interval)
+{
+    hg_record(h, value);
+    if (interval == 0)
+        return;
+    for (uint64_t missing = value; missing > interval; )
+    {
+        missing -= interval;
+        hg_record(h, missing);
+    }
+}
+
+void hg_merge(Histogram *dst, const Histogram *src)
+{
+    if (src->count == 0)
+        return;
+    if ((dst->count == 0) || (src->min < dst->min))
+        dst->min = src->min;
+    if (src->max > dst->max)
+        dst->max = src->max;
+    dst->count += src->count;
+    dst->sum += src->sum;
+    for (int i = 0; i < HG_NB_BUCKETS; i++)
+        dst->buckets[i] += src->buckets[i];
+}
+
+
+/************************************************************************
+ * lecture
+ ************************************************************************/
+uint64_t hg_bucketLow(int bucket)
+{
+    if (bucket < HG_SUB_COUNT)
+        return bucket;
+    int shift = (bucket >> HG_SUB_BITS) - 1;
+    uint64_t sub = (bucket & (HG_SUB_COUNT - 1)) + HG_SUB_COUNT;
+    return sub << shift;
+}
+
+uint64_t hg_bucketHigh(int bucket)
+{
+    if (bucket < HG_SUB_COUNT)
+        return bucket;
+    int shift = (bucket >> HG_SUB_BITS) - 1;
+    return hg_bucketLow(bucket) + ((uint64_t) 1 << shift) - 1;
+}
+
+uint64_t hg_percentile(const Histogram *h, double p)
+{
+    if (h->count == 0)
+        return 0;
+    // rang le plus proche : plus petite valeur v telle que count(<= v) >= p * count
+    uint64_t rank = (uint64_t) (p * h->count + 0.5);
+    if (rank < 1)
+        rank = 1;
+    if (rank > h->count)
+        rank = h->count;
+    uint64_t seen = 0;
+    for (int i = 0; i < HG_NB_BUCKETS; i++)
+    {
+        seen += h->buckets[i];
+        if (seen >= rank)
+        {
+            uint64_t high = hg_bucketHigh(i);
+            return (high < h->max) ? high : h->max;
+        }
+    }
+    return h->max;
+}
+
+double hg_mean(const Histogram *h)
+{
+    return (h->count == 0) ? 0 : (double) h->sum / h->count;
+}
+
+
+/************************************************************************
+ * affichage
+ ************************************************************************/
+void hg_print(const Histogram *h, FILE *f, const char *title, double scale, const char *unit)
+{
+    static const double percentiles[] = { 0.50, 0.90, 0.99, 0.999, 0.9999 };
+    int nbPercentiles = sizeof(percentiles) / sizeof(percentiles[0]);
+
+    fprintf(f, "%s : %llu valeur(s)\n", title, (unsigned long long) h->count);
+    if (h->count == 0)
+        return;
+    fprintf(f, "   min %.1f %s, moyenne %.1f %s, max %.1f %s\n", h->min / scale, unit,
+            hg_mean(h) / scale, unit, h->max / scale, unit);
+    for (int i = 0; i < nbPercentiles; i++)
+        fprintf(f, "   p%-7g %12.1f %s\n", percentiles[i] * 100, hg_percentile(h, percentiles[i]) / scale, unit);
+
+    // regroupement par puissance de 2 (toutes les sous-classes d'une même puissance)
+    uint64_t groups[64 - HG_SUB_BITS + 1];
+    uint64_t biggest = 0;
+    int first = -1, last = -1;
+    for (int g = 0; g < 64 - HG_SUB_BITS + 1; g++)
+    {
+        groups[g] = 0;
+        for (int k = 0; k < HG_SUB_COUNT; k++)
+            groups[g] += h->buckets[g * HG_SUB_COUNT + k];
+        if (groups[g] > 0)
+        {
+            if (first == -1)
+                first = g;
+            last = g;
+        }
+        if (groups[g] > biggest)
+            biggest = groups[g];
+    }
+    for (int g = first; g <= last; g++)
+    {
+        int width = (int) (groups[g] * HG_BAR_WIDTH / biggest);
+        fprintf(f, "   [%10.1f, %10.1f] %s %10llu |", hg_bucketLow(g * HG_SUB_COUNT) / scale,
+                hg_bucketHigh(g * HG_SUB_COUNT + HG_SUB_COUNT - 1) / scale, unit, (unsigned long long) groups[g]);
+        for (int k = 0; k < width; k++)
+            fputc('#', f);
+        fputc('\n', f);
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/******************************************
+ * histogramme de latences (log-linéaire)
+ ******************************************/
+// Même principe que HdrHistogram : les valeurs (entiers positifs, par
+// exemple des durées en ns) sont rangées dans des classes dont la largeur
+// double à chaque puissance de 2, chaque puissance étant découpée en
+// 2^HG_SUB_BITS sous-classes. L'erreur relative est donc au plus de
+// 1/2^HG_SUB_BITS (~3%), quelle que soit la valeur, pour une taille fixe.
+// L'enregistrement est en O(1), sans allocation ni flottant, et deux
+// histogrammes s'additionnent (hg_merge).
+#define HG_SUB_BITS     5
+#define HG_SUB_COUNT    (1 << HG_SUB_BITS)
+#define HG_NB_BUCKETS   ((64 - HG_SUB_BITS + 1) * HG_SUB_COUNT)
+
+typedef struct {
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+    uint64_t buckets[HG_NB_BUCKETS];
+} Histogram;
+
+void hg_init(Histogram *h);
+
+// indice de la classe de <value>
+static inline int hg_bucket(uint64_t value)
+{
+    if (value < HG_SUB_COUNT)
+        return (int) value;
+    int exp = 63 - __builtin_clzll(value);          // value dans [2^exp, 2^(exp+1)[
+    int shift = exp - HG_SUB_BITS;
+    return ((shift + 1) << HG_SUB_BITS) + (int) ((value >> shift) - HG_SUB_COUNT);
+}
+
+// ajout d'une valeur (fonction inline : utilisable dans les chemins critiques)
+static inline void hg_record(Histogram *h, uint64_t value)
+{
+    h->buckets[hg_bucket(value)]++;
+    h->count++;
+    h->sum += value;
+    if ((h->count == 1) || (value < h->min))
+        h->min = value;
+    if (value > h->max)
+        h->max = value;
+}
+
+// ajout d'une valeur mesurée alors qu'une valeur était attendue toutes les
+// <interval> unités : si <value> dépasse <interval>, les valeurs qu'auraient
+// mesurées les requêtes bloquées pendant ce temps (value - interval,
+// value - 2*interval, ...) sont ajoutées (correction de l'omission coordonnée)
+void hg_recordCorrected(Histogram *h, uint64_t value, uint64_t interval);
+
+// dst += src
+void hg_merge(Histogram *dst, const Histogram *src);
+
+// plus grande valeur de la classe contenant le percentile <p> (dans [0,1])
+uint64_t hg_percentile(const Histogram *h, double p);
+
+double hg_mean(const Histogram *h);
+
+// bornes [low, high] des valeurs d'une classe
+uint64_t hg_bucketLow(int bucket);
+uint64_t hg_bucketHigh(int bucket);
+
+// affichage des percentiles et d'un histogramme en barres par puissance
+// de 2 ; les valeurs sont divisées par <scale> et affichées avec <unit>
+void hg_print(const Histogram *h, FILE *f, const char *title, double scale, const char *unit);
+
+#endif
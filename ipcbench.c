@@ -0,0 +1,723 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// sched_setaffinity, CPU_*, syscall()
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <linux/futex.h>
+
+#include "utils.h"
+#include "myassert.h"
+
+#include "histogram.h"
+
+
+/************************************************************************
+ * Mesure des moyens de communication entre deux processus
+ *
+ * Avant de remplacer les tubes nommés et les sémaphores SysV (client <->
+ * master) ou les tubes anonymes (master <-> workers), le programme mesure,
+ * entre un processus et son fils, chaque moyen de transport candidat :
+ *    pipe       deux tubes anonymes (comme master <-> workers)
+ *    fifo       deux tubes nommés (comme client <-> master, sans sémaphores)
+ *    stream     socketpair AF_UNIX SOCK_STREAM
+ *    seqpacket  socketpair AF_UNIX SOCK_SEQPACKET
+ *    eventfd    anneau en mémoire partagée, places libres et messages
+ *               comptés par deux eventfd (mode sémaphore) par sens
+ *    futex      boîte aux lettres d'un message en mémoire partagée,
+ *               attente (éventuellement active) puis futex
+ * Pour chaque taille de message :
+ *  - latence : <iter> allers-retours d'un message de <taille> octets,
+ *    renvoyé tel quel par le fils (moyenne, p50, p99 et maximum en µs) ;
+ *  - débit : <iter> messages envoyés à la suite, un seul accusé de
+ *    réception à la fin (messages/s et Mo/s).
+ * Chaque mesure est faite sans placement des processus (none), avec les
+ * deux processus sur le même processeur (same) et sur deux processeurs
+ * différents (split, seulement s'il y en a au moins deux autorisés).
+ * Les résultats sont affichés et ajoutés à un fichier CSV, avec la
+ * machine et la version du noyau pour les comparer entre elles.
+ ************************************************************************/
+
+// options
+#define OPT_ITER        "--iter="       // allers-retours (et messages du débit) par mesure
+#define OPT_SIZES       "--sizes="      // tailles des messages, séparées par des virgules
+#define OPT_TRANSPORTS  "--transports=" // moyens de transport mesurés
+#define OPT_PIN         "--pin="        // placements mesurés (none, same, split)
+#define OPT_SPIN        "--spin="       // futex : tours d'attente active avant de dormir
+#define OPT_OUT         "--out="        // fichier CSV (complété, créé si besoin)
+#define OPT_LABEL       "--label="      // étiquette des lignes (par exemple le commit)
+
+// tailles par défaut : celles du protocole
+//    4       un ordre ou une réponse (int)
+//    8       en-tête d'un ordre master -> worker (MwOrderHeader)
+//    16      un ordre et son élément (int64 ou double, avec remplissage)
+//    4096    insertmany de 1024 float
+//    65536   insertmany de 16384 float (capacité par défaut d'un tube)
+static const size_t defaultSizes[] = { 4, 8, 16, 4096, 65536 };
+#define NB_DEFAULT_SIZES ((int) (sizeof(defaultSizes) / sizeof(defaultSizes[0])))
+#define MAX_SIZES 32
+
+// allers-retours d'échauffement avant chaque mesure
+#define WARMUP_DIVISOR 10
+
+// anneau eventfd : nombre d'emplacements par sens
+#define RING_SLOTS 16
+
+// boîte aux lettres : alignement (une ligne de cache par en-tête)
+#define MAILBOX_ALIGN 64
+
+// sens des messages
+#define TO_CHILD    0
+#define TO_PARENT   1
+
+// placements
+#define PIN_NONE    0
+#define PIN_SAME    1
+#define PIN_SPLIT   2
+#define NB_PINS     3
+static const char * const pinNames[NB_PINS] = { "none", "same", "split" };
+
+
+/************************************************************************
+ * canal de communication entre le père et le fils
+ ************************************************************************/
+// Créé par le père avant fork, puis complété par chaque processus (tubes
+// nommés) : chacun en a sa propre copie.
+typedef struct {
+    size_t size;            // taille des messages
+    int spin;               // futex : tours d'attente active
+    int fds[2][2];          // sens d : fds[d][0] lecture, fds[d][1] écriture
+    char fifos[2][64];      // tubes nommés de chaque sens
+    int items[2];           // eventfd : messages disponibles dans chaque sens
+    int spaces[2];          // eventfd : emplacements libres dans chaque sens
+    unsigned next[2];       // anneau : prochain emplacement (propre au processus)
+    char *shm;              // mémoire partagée (anneaux ou boîtes aux lettres)
+    size_t shmSize;
+} Channel;
+
+typedef struct {
+    const char *name;
+    void (*create)(Channel *ch);                            // avant fork
+    void (*open)(Channel *ch, bool parent);                 // après fork (NULL : rien)
+    void (*send)(Channel *ch, int dir, const char *buf, size_t size);
+    void (*recv)(Channel *ch, int dir, char *buf, size_t size);
+} Transport;
+
+
+/************************************************************************
+ * transports par descripteurs (tubes, sockets)
+ ************************************************************************/
+static void fdSend(Channel *ch, int dir, const char *buf, size_t size)
+{
+    size_t done = 0;
+    while (done < size)
+    {
+        ssize_t ret = write(ch->fds[dir][1], buf + done, size - done);
+        myassert(ret > 0, "echec écriture d'un message");
+        done += ret;
+    }
+}
+
+static void fdRecv(Channel *ch, int dir, char *buf, size_t size)
+{
+    size_t done = 0;
+    while (done < size)
+    {
+        ssize_t ret = read(ch->fds[dir][0], buf + done, size - done);
+        myassert(ret > 0, "echec lecture d'un message");
+        done += ret;
+    }
+}
+
+// seqpacket : un message par écriture et par lecture
+static void packetSend(Channel *ch, int dir, const char *buf, size_t size)
+{
+    ssize_t ret = write(ch->fds[dir][1], buf, size);
+    myassert(ret == (ssize_t) size, "echec écriture d'un paquet");
+}
+
+static void packetRecv(Channel *ch, int dir, char *buf, size_t size)
+{
+    ssize_t ret = read(ch->fds[dir][0], buf, size);
+    myassert(ret == (ssize_t) size, "echec lecture d'un paquet");
+}
+
+static void pipeCreate(Channel *ch)
+{
+    for (int d = 0; d < 2; d++)
+    {
+        int ret = pipe(ch->fds[d]);
+        myassert(ret == 0, "echec création d'un tube");
+    }
+}
+
+static void fifoCreate(Channel *ch)
+{
+    for (int d = 0; d < 2; d++)
+    {
+        snprintf(ch->fifos[d], sizeof(ch->fifos[d]), "/tmp/ipcbench-%d.%d", (int) getpid(), d);
+        unlink(ch->fifos[d]);
+        int ret = mkfifo(ch->fifos[d], 0600);
+        myassert(ret == 0, "echec création d'un tube nommé");
+    }
+}
+
+// même ordre d'ouverture des deux côtés (TO_CHILD puis TO_PARENT) :
+// chaque ouverture attend celle de l'autre extrémité
+static void fifoOpen(Channel *ch, bool parent)
+{
+    for (int d = 0; d < 2; d++)
+    {
+        bool writer = ((d == TO_CHILD) == parent);
+        int fd = open(ch->fifos[d], writer ? O_WRONLY : O_RDONLY);
+        myassert(fd != -1, "echec ouverture d'un tube nommé");
+        ch->fds[d][writer ? 1 : 0] = fd;
+    }
+}
+
+// une seule paire de sockets : le père écrit et lit sur l'une, le fils sur l'autre
+static void socketCreate(Channel *ch, int type)
+{
+    int sv[2];
+    int ret = socketpair(AF_UNIX, type, 0, sv);
+    myassert(ret == 0, "echec création des sockets");
+    ch->fds[TO_CHILD][1] = sv[0];
+    ch->fds[TO_CHILD][0] = sv[1];
+    ch->fds[TO_PARENT][1] = sv[1];
+    ch->fds[TO_PARENT][0] = sv[0];
+}
+
+static void streamCreate(Channel *ch)
+{
+    socketCreate(ch, SOCK_STREAM);
+}
+
+static void seqpacketCreate(Channel *ch)
+{
+    socketCreate(ch, SOCK_SEQPACKET);
+    // un message entier doit tenir dans le tampon d'émission
+    int bufSize = (int) (4 * ch->size);
+    for (int i = 0; i < 2; i++)
+        setsockopt(ch->fds[TO_CHILD][i], SOL_SOCKET, SO_SNDBUF, &bufSize, sizeof(bufSize));
+}
+
+
+/************************************************************************
+ * anneau en mémoire partagée et eventfd
+ ************************************************************************/
+// Par sens : RING_SLOTS emplacements de <size> octets, un eventfd compte
+// les messages disponibles et un autre les emplacements libres (mode
+// sémaphore : chaque lecture décrémente de 1 ou bloque). Les indices des
+// emplacements restent locaux : un seul écrivain et un seul lecteur par sens.
+static char * ringSlot(Channel *ch, int dir, unsigned index)
+{
+    return ch->shm + ((size_t) dir * RING_SLOTS + (index % RING_SLOTS)) * ch->size;
+}
+
+static void eventfdCreate(Channel *ch)
+{
+    ch->shmSize = 2 * RING_SLOTS * ch->size;
+    ch->shm = mmap(NULL, ch->shmSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    myassert(ch->shm != MAP_FAILED, "echec projection de l'anneau");
+    for (int d = 0; d < 2; d++)
+    {
+        ch->items[d] = eventfd(0, EFD_SEMAPHORE);
+        ch->spaces[d] = eventfd(RING_SLOTS, EFD_SEMAPHORE);
+        myassert((ch->items[d] != -1) && (ch->spaces[d] != -1), "echec création d'un eventfd");
+        ch->next[d] = 0;
+    }
+}
+
+static void eventfdSend(Channel *ch, int dir, const char *buf, size_t size)
+{
+    uint64_t one = 1;
+    ssize_t ret = read(ch->spaces[dir], &one, sizeof(one));
+    myassert(ret == sizeof(one), "echec attente d'un emplacement libre");
+    memcpy(ringSlot(ch, dir, ch->next[dir]++), buf, size);
+    one = 1;
+    ret = write(ch->items[dir], &one, sizeof(one));
+    myassert(ret == sizeof(one), "echec signalement d'un message");
+}
+
+static void eventfdRecv(Channel *ch, int dir, char *buf, size_t size)
+{
+    uint64_t one = 1;
+    ssize_t ret = read(ch->items[dir], &one, sizeof(one));
+    myassert(ret == sizeof(one), "echec attente d'un message");
+    memcpy(buf, ringSlot(ch, dir, ch->next[dir]++), size);
+    one = 1;
+    ret = write(ch->spaces[dir], &one, sizeof(one));
+    myassert(ret == sizeof(one), "echec libération d'un emplacement");
+}
+
+
+/************************************************************************
+ * boîte aux lettres et futex
+ ************************************************************************/
+// Par sens, une boîte d'un seul message. L'attente se fait d'abord
+// activement (<spin> tours, utile seulement sur deux processeurs) puis
+// avec FUTEX_WAIT ; le réveil (FUTEX_WAKE) n'est demandé que si l'autre
+// processus dort : un échange sans attente ne fait aucun appel système.
+typedef struct {
+    uint32_t full;          // 1 : un message attend d'être lu
+    uint32_t waiters;       // processus endormis sur full
+} MailboxHead;
+
+static size_t mailboxStride(const Channel *ch)
+{
+    return MAILBOX_ALIGN + ((ch->size + MAILBOX_ALIGN - 1) / MAILBOX_ALIGN) * MAILBOX_ALIGN;
+}
+
+static MailboxHead * mailbox(Channel *ch, int dir)
+{
+    return (MailboxHead *) (ch->shm + dir * mailboxStride(ch));
+}
+
+static void futexCreate(Channel *ch)
+{
+    ch->shmSize = 2 * mailboxStride(ch);
+    ch->shm = mmap(NULL, ch->shmSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    myassert(ch->shm != MAP_FAILED, "echec projection des boîtes aux lettres");
+}
+
+// attente de full != <value>
+static void mailboxWait(Channel *ch, MailboxHead *box, uint32_t value)
+{
+    for (int i = 0; i < ch->spin; i++)
+        if (__atomic_load_n(&(box->full), __ATOMIC_ACQUIRE) != value)
+            return;
+    while (__atomic_load_n(&(box->full), __ATOMIC_SEQ_CST) == value)
+    {
+        __atomic_add_fetch(&(box->waiters), 1, __ATOMIC_SEQ_CST);
+        // le noyau revérifie full : pas de réveil perdu
+        long ret = syscall(SYS_futex, &(box->full), FUTEX_WAIT, value, NULL, NULL, 0);
+        myassert((ret == 0) || (errno == EAGAIN) || (errno == EINTR), "echec attente futex");
+        __atomic_sub_fetch(&(box->waiters), 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+static void mailboxSet(MailboxHead *box, uint32_t value)
+{
+    __atomic_store_n(&(box->full), value, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&(box->waiters), __ATOMIC_SEQ_CST) != 0)
+    {
+        long ret = syscall(SYS_futex, &(box->full), FUTEX_WAKE, 1, NULL, NULL, 0);
+        myassert(ret != -1, "echec réveil futex");
+    }
+}
+
+static void futexSend(Channel *ch, int dir, const char *buf, size_t size)
+{
+    MailboxHead *box = mailbox(ch, dir);
+    mailboxWait(ch, box, 1);
+    memcpy((char *) box + MAILBOX_ALIGN, buf, size);
+    mailboxSet(box, 1);
+}
+
+static void futexRecv(Channel *ch, int dir, char *buf, size_t size)
+{
+    MailboxHead *box = mailbox(ch, dir);
+    mailboxWait(ch, box, 0);
+    memcpy(buf, (char *) box + MAILBOX_ALIGN, size);
+    mailboxSet(box, 0);
+}
+
+
+/************************************************************************
+ * liste des transports
+ ************************************************************************/
+static const Transport transports[] = {
+    { "pipe",      pipeCreate,      NULL,     fdSend,      fdRecv },
+    { "fifo",      fifoCreate,      fifoOpen, fdSend,      fdRecv },
+    { "stream",    streamCreate,    NULL,     fdSend,      fdRecv },
+    { "seqpacket", seqpacketCreate, NULL,     packetSend,  packetRecv },
+    { "eventfd",   eventfdCreate,   NULL,     eventfdSend, eventfdRecv },
+    { "futex",     futexCreate,     NULL,     futexSend,   futexRecv },
+};
+#define NB_TRANSPORTS ((int) (sizeof(transports) / sizeof(transports[0])))
+
+// fermeture de tout ce qui a été créé, quel que soit le transport
+static void channelDestroy(Channel *ch)
+{
+    for (int d = 0; d < 2; d++)
+    {
+        for (int i = 0; i < 2; i++)
+            if ((ch->fds[d][i] != -1) && ((d == 0) || (ch->fds[d][i] != ch->fds[0][1 - i])))
+                close(ch->fds[d][i]);
+        if (ch->items[d] != -1)
+            close(ch->items[d]);
+        if (ch->spaces[d] != -1)
+            close(ch->spaces[d]);
+        if (ch->fifos[d][0] != '\0')
+            unlink(ch->fifos[d]);
+    }
+    if (ch->shm != NULL)
+        munmap(ch->shm, ch->shmSize);
+}
+
+
+/************************************************************************
+ * paramètres du benchmark
+ ************************************************************************/
+typedef struct {
+    int iter;
+    size_t sizes[MAX_SIZES];
+    int nbSizes;
+    bool transports[NB_TRANSPORTS];
+    bool pins[NB_PINS];
+    int spin;
+    const char *out;
+    const char *label;
+    int cpus[2];            // deux premiers processeurs autorisés
+    int nbCpus;
+} Data;
+
+// résultats d'une mesure
+typedef struct {
+    const char *transport;
+    const char *pin;
+    size_t size;
+    int iterations;
+    double mean;            // aller-retour, en secondes
+    double p50;
+    double p99;
+    double max;
+    double msgRate;         // débit, messages par seconde
+    double byteRate;        // débit, octets par seconde
+} IpcResult;
+
+
+/************************************************************************
+ * Usage et analyse des arguments passés en ligne de commande
+ ************************************************************************/
+static void usage(const char *exeName, const char *message)
+{
+    fprintf(stderr, "usage : %s [options]\n", exeName);
+    fprintf(stderr, "   " OPT_ITER "<iter>                allers-retours et messages par mesure (défaut 10000)\n");
+    fprintf(stderr, "   " OPT_SIZES "<t1,t2,...>         tailles des messages en octets (défaut 4,8,16,4096,65536)\n");
+    fprintf(stderr, "   " OPT_TRANSPORTS "<n1,n2,...>    parmi pipe,fifo,stream,seqpacket,eventfd,futex (défaut tous)\n");
+    fprintf(stderr, "   " OPT_PIN "<p1,p2,...>           parmi none,same,split (défaut tous)\n");
+    fprintf(stderr, "   " OPT_SPIN "<tours>               futex : attente active avant de dormir (défaut 0)\n");
+    fprintf(stderr, "   " OPT_OUT "<fichier>              résultats CSV (défaut ipc.csv, complété)\n");
+    fprintf(stderr, "   " OPT_LABEL "<étiquette>          première colonne du CSV (par exemple le commit)\n");
+    if (message != NULL)
+        fprintf(stderr, "message :\n    %s\n", message);
+    exit(EXIT_FAILURE);
+}
+
+// sélection de noms dans une liste séparée par des virgules
+static void parseNames(const char *exeName, const char *list, const char * const names[],
+                       int nbNames, bool selected[])
+{
+    char copy[256];
+    snprintf(copy, sizeof(copy), "%s", list);
+    for (int k = 0; k < nbNames; k++)
+        selected[k] = false;
+    for (char *name = strtok(copy, ","); name != NULL; name = strtok(NULL, ","))
+    {
+        int k = 0;
+        while ((k < nbNames) && (strcmp(name, names[k]) != 0))
+            k++;
+        if (k == nbNames)
+            usage(exeName, "nom inconnu dans une liste");
+        selected[k] = true;
+    }
+}
+
+static void parseArgs(int argc, char * argv[], Data *data)
+{
+    data->iter = 10000;
+    data->nbSizes = NB_DEFAULT_SIZES;
+    for (int i = 0; i < NB_DEFAULT_SIZES; i++)
+        data->sizes[i] = defaultSizes[i];
+    for (int k = 0; k < NB_TRANSPORTS; k++)
+        data->transports[k] = true;
+    for (int k = 0; k < NB_PINS; k++)
+        data->pins[k] = true;
+    data->spin = 0;
+    data->out = "ipc.csv";
+    data->label = "-";
+
+    const char *transportNames[NB_TRANSPORTS];
+    for (int k = 0; k < NB_TRANSPORTS; k++)
+        transportNames[k] = transports[k].name;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], OPT_ITER, strlen(OPT_ITER)) == 0)
+            data->iter = strtol(argv[i] + strlen(OPT_ITER), NULL, 10);
+        else if (strncmp(argv[i], OPT_SIZES, strlen(OPT_SIZES)) == 0)
+        {
+            const char *p = argv[i] + strlen(OPT_SIZES);
+            data->nbSizes = 0;
+            while (*p != '\0')
+            {
+                char *end;
+                long size = strtol(p, &end, 10);
+                if ((end == p) || (size <= 0) || (data->nbSizes == MAX_SIZES))
+                    usage(argv[0], "liste de tailles incorrecte");
+                data->sizes[data->nbSizes++] = size;
+                p = (*end == ',') ? end + 1 : end;
+                if ((*end != ',') && (*end != '\0'))
+                    usage(argv[0], "liste de tailles incorrecte");
+            }
+        }
+        else if (strncmp(argv[i], OPT_TRANSPORTS, strlen(OPT_TRANSPORTS)) == 0)
+            parseNames(argv[0], argv[i] + strlen(OPT_TRANSPORTS), transportNames, NB_TRANSPORTS,
+                       data->transports);
+        else if (strncmp(argv[i], OPT_PIN, strlen(OPT_PIN)) == 0)
+            parseNames(argv[0], argv[i] + strlen(OPT_PIN), pinNames, NB_PINS, data->pins);
+        else if (strncmp(argv[i], OPT_SPIN, strlen(OPT_SPIN)) == 0)
+            data->spin = strtol(argv[i] + strlen(OPT_SPIN), NULL, 10);
+        else if (strncmp(argv[i], OPT_OUT, strlen(OPT_OUT)) == 0)
+            data->out = argv[i] + strlen(OPT_OUT);
+        else if (strncmp(argv[i], OPT_LABEL, strlen(OPT_LABEL)) == 0)
+            data->label = argv[i] + strlen(OPT_LABEL);
+        else
+            usage(argv[0], "option inconnue");
+    }
+    if (data->iter <= 0)
+        usage(argv[0], "le nombre d'itérations doit être strictement positif");
+    if (data->nbSizes == 0)
+        usage(argv[0], "aucune taille de message");
+}
+
+
+/************************************************************************
+ * placement des processus
+ ************************************************************************/
+static void findCpus(Data *data)
+{
+    cpu_set_t set;
+    int ret = sched_getaffinity(0, sizeof(set), &set);
+    myassert(ret == 0, "echec lecture des processeurs autorisés");
+    int found = 0;
+    for (int cpu = 0; (cpu < CPU_SETSIZE) && (found < 2); cpu++)
+        if (CPU_ISSET(cpu, &set))
+            data->cpus[found++] = cpu;
+    data->nbCpus = CPU_COUNT(&set);
+}
+
+// <cpu> == -1 : tous les processeurs de <all>
+static void pinTo(int cpu, const cpu_set_t *all)
+{
+    cpu_set_t set;
+    if (cpu == -1)
+        set = *all;
+    else
+    {
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+    }
+    int ret = sched_setaffinity(0, sizeof(set), &set);
+    myassert(ret == 0, "echec placement d'un processus");
+}
+
+
+/************************************************************************
+ * mesures
+ ************************************************************************/
+// le fils renvoie chaque message de l'aller-retour, puis accuse réception
+// des messages du débit
+static void childLoop(const Transport *t, Channel *ch, int nbRoundTrips, int nbStream)
+{
+    char *buf = malloc(ch->size);
+    myassert(buf != NULL, "echec allocation du message");
+    for (int i = 0; i < nbRoundTrips; i++)
+    {
+        t->recv(ch, TO_CHILD, buf, ch->size);
+        t->send(ch, TO_PARENT, buf, ch->size);
+    }
+    for (int i = 0; i < nbStream; i++)
+        t->recv(ch, TO_CHILD, buf, ch->size);
+    t->send(ch, TO_PARENT, buf, ch->size);
+    free(buf);
+}
+
+static void parentLoop(const Transport *t, Channel *ch, int warmup, int iter, IpcResult *res)
+{
+    char *buf = malloc(ch->size);
+    char *echo = malloc(ch->size);
+    myassert((buf != NULL) && (echo != NULL), "echec allocation des messages");
+    memset(buf, 0x5a, ch->size);
+
+    Histogram hist;
+    hg_init(&hist);
+    uint64_t max = 0;
+    for (int i = 0; i < warmup + iter; i++)
+    {
+        buf[0] = (char) i;
+        uint64_t start = ut_getTimeNs();
+        t->send(ch, TO_CHILD, buf, ch->size);
+        t->recv(ch, TO_PARENT, echo, ch->size);
+        uint64_t elapsed = ut_getTimeNs() - start;
+        myassert(echo[0] == buf[0], "message renvoyé incorrect");
+        if (i < warmup)
+            continue;
+        hg_record(&hist, elapsed);
+        if (elapsed > max)
+            max = elapsed;
+    }
+    res->iterations = iter;
+    res->mean = hg_mean(&hist) * 1e-9;
+    res->p50 = hg_percentile(&hist, 0.50) * 1e-9;
+    res->p99 = hg_percentile(&hist, 0.99) * 1e-9;
+    res->max = max * 1e-9;
+
+    uint64_t start = ut_getTimeNs();
+    for (int i = 0; i < iter; i++)
+        t->send(ch, TO_CHILD, buf, ch->size);
+    t->recv(ch, TO_PARENT, echo, ch->size);
+    double elapsed = (ut_getTimeNs() - start) * 1e-9;
+    res->msgRate = iter / elapsed;
+    res->byteRate = (double) iter * ch->size / elapsed;
+
+    free(buf);
+    free(echo);
+}
+
+static void runOne(const Data *data, const Transport *t, int pin, size_t size, IpcResult *res)
+{
+    Channel ch;
+    memset(&ch, 0, sizeof(ch));
+    for (int d = 0; d < 2; d++)
+    {
+        ch.fds[d][0] = ch.fds[d][1] = -1;
+        ch.items[d] = ch.spaces[d] = -1;
+    }
+    ch.size = size;
+    ch.spin = data->spin;
+    t->create(&ch);
+
+    cpu_set_t all;
+    int ret = sched_getaffinity(0, sizeof(all), &all);
+    myassert(ret == 0, "echec lecture des processeurs autorisés");
+    int parentCpu = (pin == PIN_NONE) ? -1 : data->cpus[0];
+    int childCpu = (pin == PIN_NONE) ? -1 : data->cpus[(pin == PIN_SPLIT) ? 1 : 0];
+    pinTo(parentCpu, &all);
+
+    int warmup = data->iter / WARMUP_DIVISOR;
+    fflush(stdout);
+    pid_t pid = fork();
+    myassert(pid != -1, "echec fork");
+    if (pid == 0)
+    {
+        pinTo(childCpu, &all);
+        if (t->open != NULL)
+            t->open(&ch, false);
+        childLoop(t, &ch, warmup + data->iter, data->iter);
+        channelDestroy(&ch);
+        exit(EXIT_SUCCESS);
+    }
+
+    if (t->open != NULL)
+        t->open(&ch, true);
+    res->transport = t->name;
+    res->pin = pinNames[pin];
+    res->size = size;
+    parentLoop(t, &ch, warmup, data->iter, res);
+
+    int status;
+    ret = waitpid(pid, &status, 0);
+    myassert((ret == pid) && WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_SUCCESS), "echec du fils");
+    channelDestroy(&ch);
+    pinTo(-1, &all);
+}
+
+
+/************************************************************************
+ * Affichage et enregistrement des résultats
+ ************************************************************************/
+static void printResult(const IpcResult *res)
+{
+    printf("%-10s %-6s %8zu %10.2f %10.2f %10.2f %10.2f %12.0f %10.1f\n", res->transport, res->pin,
+           res->size, res->mean * 1e6, res->p50 * 1e6, res->p99 * 1e6, res->max * 1e6, res->msgRate,
+           res->byteRate * 1e-6);
+}
+
+// ajout au fichier CSV (en-tête si le fichier est vide)
+static void writeResults(const Data *data, const IpcResult *results, int n)
+{
+    struct utsname uts;
+    int ret = uname(&uts);
+    myassert(ret == 0, "echec lecture du nom du système");
+
+    FILE *f = fopen(data->out, "a");
+    myassert(f != NULL, "echec ouverture du fichier de résultats");
+    if (ftell(f) == 0)
+        fprintf(f, "label,host,kernel,arch,cpus,transport,pin,size,iterations,"
+                "rtt_mean_us,rtt_p50_us,rtt_p99_us,rtt_max_us,msgs_per_s,mb_per_s\n");
+    for (int i = 0; i < n; i++)
+        fprintf(f, "%s,%s,%s,%s,%d,%s,%s,%zu,%d,%.3f,%.3f,%.3f,%.3f,%.1f,%.3f\n", data->label,
+                uts.nodename, uts.release, uts.machine, data->nbCpus, results[i].transport,
+                results[i].pin, results[i].size, results[i].iterations, results[i].mean * 1e6,
+                results[i].p50 * 1e6, results[i].p99 * 1e6, results[i].max * 1e6,
+                results[i].msgRate, results[i].byteRate * 1e-6);
+    ret = fclose(f);
+    myassert(ret == 0, "echec fermeture du fichier de résultats");
+    printf("résultats ajoutés à %s\n", data->out);
+}
+
+
+/************************************************************************
+ * Fonction principale
+ ************************************************************************/
+int main(int argc, char * argv[])
+{
+    Data data;
+    parseArgs(argc, argv, &data);
+    findCpus(&data);
+
+    if (data.pins[PIN_SPLIT] && (data.nbCpus < 2))
+    {
+        printf("un seul processeur autorisé : placement split ignoré\n");
+        data.pins[PIN_SPLIT] = false;
+    }
+    printf("%d allers-retours et %d messages par mesure, %d processeur(s)\n", data.iter, data.iter,
+           data.nbCpus);
+
+    IpcResult *results = malloc(NB_TRANSPORTS * NB_PINS * data.nbSizes * sizeof(IpcResult));
+    myassert(results != NULL, "echec allocation des résultats");
+    int nbResults = 0;
+
+    printf("%-10s %-6s %8s %10s %10s %10s %10s %12s %10s\n", "transport", "cpu", "taille",
+           "moy.(µs)", "p50(µs)", "p99(µs)", "max(µs)", "débit(/s)", "débit(Mo/s)");
+    for (int k = 0; k < NB_TRANSPORTS; k++)
+    {
+        if (! data.transports[k])
+            continue;
+        for (int pin = 0; pin < NB_PINS; pin++)
+        {
+            if (! data.pins[pin])
+                continue;
+            for (int s = 0; s < data.nbSizes; s++)
+            {
+                runOne(&data, &(transports[k]), pin, data.sizes[s], &(results[nbResults]));
+                printResult(&(results[nbResults]));
+                nbResults++;
+            }
+        }
+    }
+
+    if (nbResults > 0)
+        writeResults(&data, results, nbResults);
+    free(results);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,155 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "myassert.h"
+
+#include "keycache.h"
+
+
+/************************************************************************
+ * paramètres
+ ************************************************************************/
+bool kc_parse(const char *spec, int *capacity)
+{
+    if ((spec == NULL) || (spec[0] == '\0'))
+        return false;
+    char *end;
+    long n = strtol(spec, &end, 10);
+    if ((*end != '\0') || (n < 1) || (n > (1 << 28)))
+        return false;
+    *capacity = (int) n;
+    return true;
+}
+
+void kc_init(KeyCache *cache, int capacity)
+{
+    myassert(capacity > 0, "capacité du cache incorrecte");
+
+    cache->capacity = capacity;
+    cache->nb = 0;
+    cache->hand = 0;
+    cache->entries = malloc(capacity * sizeof(KcEntry));
+    myassert(cache->entries != NULL, "echec allocation du cache");
+
+    //au moins deux alvéoles par entrée : chaînes courtes
+    cache->nbBuckets = 1;
+    while (cache->nbBuckets < 2 * capacity)
+        cache->nbBuckets *= 2;
+    cache->buckets = malloc(cache->nbBuckets * sizeof(int));
+    myassert(cache->buckets != NULL, "echec allocation du cache");
+    for (int i = 0; i < cache->nbBuckets; i++)
+        cache->buckets[i] = -1;
+
+    cache->lookups = 0;
+    cache->hits = 0;
+    cache->evictions = 0;
+}
+
+void kc_end(KeyCache *cache)
+{
+    free(cache->entries);
+    free(cache->buckets);
+    cache->entries = NULL;
+    cache->buckets = NULL;
+    cache->capacity = 0;
+    cache->nb = 0;
+}
+
+
+/************************************************************************
+ * recherche
+ ************************************************************************/
+static int bucketOf(const KeyCache *cache, elt_t elt)
+{
+    return (int) (elt_hash(elt) & (uint64_t) (cache->nbBuckets - 1));
+}
+
+static int find(const KeyCache *cache, elt_t elt)
+{
+    int i = cache->buckets[bucketOf(cache, elt)];
+    while ((i != -1) && (cache->entries[i].elt != elt))
+        i = cache->entries[i].next;
+    return i;
+}
+
+bool kc_lookup(KeyCache *cache, elt_t elt, int *count)
+{
+    cache->lookups++;
+    int i = find(cache, elt);
+    if (i == -1)
+        return false;
+    cache->hits++;
+    cache->entries[i].referenced = true;
+    *count = cache->entries[i].count;
+    return true;
+}
+
+
+/************************************************************************
+ * mises à jour
+ ************************************************************************/
+// retrait de l'entrée <index> de son alvéole
+static void detach(KeyCache *cache, int index)
+{
+    int *link = &(cache->buckets[bucketOf(cache, cache->entries[index].elt)]);
+    while (*link != index)
+        link = &(cache->entries[*link].next);
+    *link = cache->entries[index].next;
+}
+
+// horloge : première entrée non référencée à partir de l'aiguille
+static int victim(KeyCache *cache)
+{
+    while (cache->entries[cache->hand].referenced)
+    {
+        cache->entries[cache->hand].referenced = false;
+        cache->hand = (cache->hand + 1) % cache->capacity;
+    }
+    int index = cache->hand;
+    cache->hand = (cache->hand + 1) % cache->capacity;
+    return index;
+}
+
+void kc_put(KeyCache *cache, elt_t elt, int count)
+{
+    int i = find(cache, elt);
+    if (i != -1)
+    {
+        cache->entries[i].count = count;
+        return;
+    }
+
+    if (cache->nb < cache->capacity)
+        i = cache->nb++;
+    else
+    {
+        i = victim(cache);
+        detach(cache, i);
+        cache->evictions++;
+    }
+
+    int bucket = bucketOf(cache, elt);
+    cache->entries[i].elt = elt;
+    cache->entries[i].count = count;
+    //une entrée neuve n'est pas référencée : un élément demandé une seule
+    //fois part au prochain tour de l'aiguille
+    cache->entries[i].referenced = false;
+    cache->entries[i].next = cache->buckets[bucket];
+    cache->buckets[bucket] = i;
+}
+
+void kc_increment(KeyCache *cache, elt_t elt)
+{
+    int i = find(cache, elt);
+    if (i != -1)
+        cache->entries[i].count++;
+}
+
+size_t kc_bytes(const KeyCache *cache)
+{
+    return cache->capacity * sizeof(KcEntry) + cache->nbBuckets * sizeof(int);
+}
@@ -0,0 +1,62 @@
+#ifndef KEYCACHE_H
+#define KEYCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "element.h"
+
+/******************************************
+ * cache des éléments les plus demandés
+ ******************************************/
+// Mode optionnel du master (variable d'environnement MWC_CACHE) :
+//    MWC_CACHE=<nbEntrées>
+// Le cache associe à un élément présent sa cardinalité, telle que donnée
+// par le dernier exist qui a interrogé les workers. Un exist d'un élément
+// du cache est répondu par le master seul. Un insert d'un élément du cache
+// incrémente sa cardinalité sur place (aucun ordre ne retire d'élément :
+// le cache n'a jamais besoin d'être invalidé).
+// Plein, le cache évince selon l'algorithme de l'horloge (CLOCK) : chaque
+// entrée a un bit de référence, mis à 1 à chaque consultation réussie ;
+// l'aiguille avance en remettant les bits à 0 jusqu'à une entrée non
+// référencée, qui est remplacée.
+
+#define KC_ENV_MODE     "MWC_CACHE"
+
+typedef struct {
+    elt_t elt;
+    int count;
+    int next;               // entrée suivante dans la même alvéole, -1 sinon
+    bool referenced;
+} KcEntry;
+
+typedef struct {
+    int capacity;
+    int nb;
+    int hand;               // aiguille de l'horloge
+    KcEntry *entries;
+    int nbBuckets;          // puissance de 2
+    int *buckets;           // première entrée de chaque alvéole, -1 sinon
+    uint64_t lookups;
+    uint64_t hits;
+    uint64_t evictions;
+} KeyCache;
+
+// lecture de MWC_CACHE ; false si le mode n'est pas demandé ou incorrect
+bool kc_parse(const char *spec, int *capacity);
+
+void kc_init(KeyCache *cache, int capacity);
+void kc_end(KeyCache *cache);
+
+// true et *count si l'élément est dans le cache
+bool kc_lookup(KeyCache *cache, elt_t elt, int *count);
+// ajout (ou mise à jour) de la cardinalité d'un élément
+void kc_put(KeyCache *cache, elt_t elt, int count);
+// un exemplaire de plus, si l'élément est dans le cache
+void kc_increment(KeyCache *cache, elt_t elt);
+
+// mémoire occupée par les entrées et les alvéoles
+size_t kc_bytes(const KeyCache *cache);
+
+#endif
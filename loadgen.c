@@ -0,0 +1,420 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "utils.h"
+#include "myassert.h"
+#include "histogram.h"
+
+#include "client_master.h"
+
+
+/************************************************************************
+ * Générateur de charge : <clients> clients simultanés
+ *
+ * Chaque client (un thread) enchaîne des sessions complètes avec le
+ * master, comme ./client : lectures (exist) ou écritures (insert) selon
+ * la proportion --reads, sur des éléments tirés dans [min,max[.
+ * Le master doit être lancé à part.
+ *
+ * . boucle fermée (défaut) : un client envoie l'ordre suivant dès la
+ *   réponse reçue ; avec --rate, les clients s'espacent pour viser le
+ *   débit demandé, et une réponse plus longue que l'intervalle prévu
+ *   est corrigée (cf. hg_recordCorrected)
+ * . boucle ouverte (--open, --rate obligatoire) : les ordres suivent un
+ *   calendrier fixe ; la latence est mesurée depuis l'instant prévu et
+ *   non depuis l'envoi effectif, si bien que l'attente due aux ordres
+ *   précédents bloqués est comptée (pas d'omission coordonnée)
+ *
+ * Le temps de service (envoi -> réponse, sans correction) est affiché à
+ * part, ainsi que sa partie passée à attendre son tour (sémaphore 2) :
+ * c'est la contention sur la boucle du master, qui sert un client à la fois.
+ *
+ * Avec MWC_HANDSHAKE=futex, les ordres passent par la boîte aux lettres du
+ * master (sans session). Avec --bulk, un écrivain de plus enchaîne des
+ * insertmany pendant la mesure : on voit la latence des lectures pendant
+ * les chargements (cf. MWC_SNAPSHOT côté master).
+ ************************************************************************/
+
+// options
+#define OPT_CLIENTS  "--clients="       // nombre de clients simultanés
+#define OPT_DURATION "--duration="      // durée de la mesure (en secondes)
+#define OPT_READS    "--reads="         // proportion de lectures dans [0,1]
+#define OPT_RATE     "--rate="          // débit visé (ordres/s, tous clients confondus)
+#define OPT_OPEN     "--open"           // boucle ouverte
+#define OPT_MIN      "--min="           // intervalle des éléments [min,max[
+#define OPT_MAX      "--max="
+#define OPT_PRELOAD  "--preload="       // éléments insérés (insertmany) avant la mesure
+#define OPT_SEED     "--seed="          // graine des tirages
+#define OPT_BULK     "--bulk="          // taille des insertmany enchaînés pendant la mesure
+
+// délai entre la création des clients et le début de la mesure (ns)
+#define START_DELAY 50000000ULL
+
+
+/************************************************************************
+ * paramètres
+ ************************************************************************/
+typedef struct {
+    int nbClients;
+    double duration;
+    double reads;
+    double rate;
+    bool open;
+    double min;
+    double max;
+    int preload;
+    uint64_t seed;
+    int bulk;
+    CmMailbox *mailbox;     // NULL : sessions par tubes nommés
+} Data;
+
+// un client (arguments et résultats d'un thread)
+typedef struct {
+    int id;
+    const Data *params;
+    uint64_t start;         // début commun de la mesure (ns)
+    uint64_t end;           // fin commune de la mesure (ns)
+    long nbReads;
+    long nbWrites;
+    long nbErrors;
+    Histogram latency;      // latence (corrigée), en ns
+    Histogram service;      // temps de service (envoi -> réponse), en ns
+    Histogram wait;         // attente de la session (sémaphore 2), en ns
+} ClientData;
+
+// l'écrivain des insertmany (--bulk)
+typedef struct {
+    const Data *params;
+    uint64_t start;
+    uint64_t end;
+    long nbBatches;
+    Histogram duration;     // durée d'un insertmany, en ns
+} BulkData;
+
+
+/************************************************************************
+ * Usage et analyse des arguments passés en ligne de commande
+ ************************************************************************/
+static void usage(const char *exeName, const char *message)
+{
+    fprintf(stderr, "usage : %s [options]       (le master doit être lancé)\n", exeName);
+    fprintf(stderr, "   " OPT_CLIENTS "<nb>      clients simultanés (défaut 4)\n");
+    fprintf(stderr, "   " OPT_DURATION "<s>      durée de la mesure en secondes (défaut 5)\n");
+    fprintf(stderr, "   " OPT_READS "<p>         proportion de lectures (exist) dans [0,1], le reste en\n"
+                    "                     écritures (insert) (défaut 0.9)\n");
+    fprintf(stderr, "   " OPT_RATE "<r>          débit visé en ordres/s, tous clients confondus\n"
+                    "                     (défaut : aussi vite que possible)\n");
+    fprintf(stderr, "   " OPT_OPEN "            boucle ouverte (calendrier fixe, " OPT_RATE " obligatoire)\n");
+    fprintf(stderr, "   " OPT_MIN "<min> " OPT_MAX "<max>  intervalle [<min>,<max>[ des éléments (défaut [0,100[)\n");
+    fprintf(stderr, "   " OPT_PRELOAD "<nb>      éléments insérés avant la mesure (défaut 0)\n");
+    fprintf(stderr, "   " OPT_SEED "<graine>     graine des tirages\n");
+    fprintf(stderr, "   " OPT_BULK "<nb>         un écrivain de plus enchaîne des insertmany de <nb>\n"
+                    "                     éléments pendant la mesure (défaut 0 : aucun)\n");
+    if (message != NULL)
+        fprintf(stderr, "message :\n    %s\n", message);
+    exit(EXIT_FAILURE);
+}
+
+static void parseArgs(int argc, char * argv[], Data *data)
+{
+    data->nbClients = 4;
+    data->duration = 5;
+    data->reads = 0.9;
+    data->rate = 0;
+    data->open = false;
+    data->min = 0;
+    data->max = 100;
+    data->preload = 0;
+    data->seed = ut_defaultSeed();
+    data->bulk = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], OPT_CLIENTS, strlen(OPT_CLIENTS)) == 0)
+            data->nbClients = strtol(argv[i] + strlen(OPT_CLIENTS), NULL, 10);
+        else if (strncmp(argv[i], OPT_DURATION, strlen(OPT_DURATION)) == 0)
+            data->duration = strtod(argv[i] + strlen(OPT_DURATION), NULL);
+        else if (strncmp(argv[i], OPT_READS, strlen(OPT_READS)) == 0)
+            data->reads = strtod(argv[i] + strlen(OPT_READS), NULL);
+        else if (strncmp(argv[i], OPT_RATE, strlen(OPT_RATE)) == 0)
+            data->rate = strtod(argv[i] + strlen(OPT_RATE), NULL);
+        else if (strcmp(argv[i], OPT_OPEN) == 0)
+            data->open = true;
+        else if (strncmp(argv[i], OPT_MIN, strlen(OPT_MIN)) == 0)
+            data->min = strtod(argv[i] + strlen(OPT_MIN), NULL);
+        else if (strncmp(argv[i], OPT_MAX, strlen(OPT_MAX)) == 0)
+            data->max = strtod(argv[i] + strlen(OPT_MAX), NULL);
+        else if (strncmp(argv[i], OPT_PRELOAD, strlen(OPT_PRELOAD)) == 0)
+            data->preload = strtol(argv[i] + strlen(OPT_PRELOAD), NULL, 10);
+        else if (strncmp(argv[i], OPT_SEED, strlen(OPT_SEED)) == 0)
+            data->seed = strtoull(argv[i] + strlen(OPT_SEED), NULL, 10);
+        else if (strncmp(argv[i], OPT_BULK, strlen(OPT_BULK)) == 0)
+            data->bulk = strtol(argv[i] + strlen(OPT_BULK), NULL, 10);
+        else
+            usage(argv[0], "option inconnue");
+    }
+
+    if (data->nbClients < 1)
+        usage(argv[0], OPT_CLIENTS " : il faut au moins un client");
+    if (data->duration <= 0)
+        usage(argv[0], OPT_DURATION " : la durée doit être strictement positive");
+    if ((data->reads < 0) || (data->reads > 1))
+        usage(argv[0], OPT_READS " : la proportion doit être dans [0,1]");
+    if (data->rate < 0)
+        usage(argv[0], OPT_RATE " : le débit doit être positif");
+    if (data->open && (data->rate == 0))
+        usage(argv[0], OPT_OPEN " : il faut préciser le débit (" OPT_RATE ")");
+    if (data->max <= data->min)
+        usage(argv[0], OPT_MAX " : max doit être strictement supérieur à min");
+    if (data->preload < 0)
+        usage(argv[0], OPT_PRELOAD " : le nombre d'éléments doit être positif");
+    if (data->bulk < 0)
+        usage(argv[0], OPT_BULK " : le nombre d'éléments doit être positif");
+}
+
+
+/************************************************************************
+ * un client
+ ************************************************************************/
+static void sleepUntil(uint64_t ns)
+{
+    struct timespec ts = { (time_t) (ns / 1000000000), (long) (ns % 1000000000) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+        ;
+}
+
+// une session complète (ou un ordre de la boîte aux lettres) ; retourne
+// la réponse du master et l'instant d'obtention de la session (ns)
+static int request(const Data *params, int order, elt_t elt, uint64_t *opened)
+{
+    CmSession session;
+    CmAnswer answer;
+    if (params->mailbox != NULL)
+    {
+        *opened = ut_getTimeNs();
+        cm_mailboxOrder(params->mailbox, order, elt, &answer);
+        return answer.code;
+    }
+    cm_openSession(&session);
+    *opened = ut_getTimeNs();
+    cm_sendOrder(&session, order, elt, NULL, 0);
+    cm_receiveAnswer(&session, &answer);
+    cm_closeSession(&session, order);
+    return answer.code;
+}
+
+void * client_function(void * arg){
+
+    ClientData *data = (ClientData *) arg;
+    const Data *params = data->params;
+    UtRng rng;
+    ut_rngInit(&rng, params->seed, data->id);
+
+    // intervalle entre deux ordres d'un même client (0 : pas de calendrier) ;
+    // les clients sont décalés pour ne pas partir tous ensemble
+    uint64_t interval = (params->rate > 0) ? (uint64_t) (params->nbClients * 1e9 / params->rate) : 0;
+    uint64_t intended = data->start + interval * data->id / params->nbClients;
+    sleepUntil(data->start);
+
+    while (true)
+    {
+        if (interval > 0)
+        {
+            if (intended >= data->end)
+                break;
+            sleepUntil(intended);
+        }
+
+        uint64_t sent = ut_getTimeNs();
+        if ((interval == 0) && (sent >= data->end))
+            break;
+
+        elt_t elt = ELT_FROM_REAL(ut_rngReal(&rng, params->min, params->max, 0));
+        bool isRead = ut_rngUnit(&rng) < params->reads;
+        uint64_t opened;
+        int code = request(params, isRead ? CM_ORDER_EXIST : CM_ORDER_INSERT, elt, &opened);
+        uint64_t done = ut_getTimeNs();
+
+        if (isRead)
+        {
+            data->nbReads++;
+            if ((code != CM_ANSWER_EXIST_YES) && (code != CM_ANSWER_EXIST_NO))
+                data->nbErrors++;
+        }
+        else
+        {
+            data->nbWrites++;
+            if (code != CM_ANSWER_INSERT_OK)
+                data->nbErrors++;
+        }
+
+        hg_record(&(data->service), done - sent);
+        hg_record(&(data->wait), opened - sent);
+        if (params->open)
+        {
+            // calendrier fixe : latence depuis l'instant prévu
+            hg_record(&(data->latency), done - intended);
+            intended += interval;
+        }
+        else
+        {
+            // boucle fermée : un ordre trop long retarde les suivants,
+            // on ajoute les mesures qu'ils auraient dû produire
+            hg_recordCorrected(&(data->latency), done - sent, interval);
+            if (interval > 0)
+                intended = (intended + interval > done) ? intended + interval : done;
+        }
+    }
+    return NULL;
+}
+
+
+/************************************************************************
+ * écrivain des insertmany
+ ************************************************************************/
+void * bulk_function(void * arg){
+
+    BulkData *data = (BulkData *) arg;
+    const Data *params = data->params;
+    elt_t *tab = ut_generateTabSeed(params->bulk, params->min, params->max, 0, params->seed, 1);
+    sleepUntil(data->start);
+
+    while (ut_getTimeNs() < data->end)
+    {
+        uint64_t sent = ut_getTimeNs();
+        CmSession session;
+        CmAnswer answer;
+        cm_openSession(&session);
+        cm_sendOrder(&session, CM_ORDER_INSERT_MANY, 0, tab, params->bulk);
+        cm_receiveAnswer(&session, &answer);
+        cm_closeSession(&session, CM_ORDER_INSERT_MANY);
+        myassert(answer.code == CM_ANSWER_INSERT_MANY_OK, "echec d'un insertmany");
+        hg_record(&(data->duration), ut_getTimeNs() - sent);
+        data->nbBatches++;
+    }
+    free(tab);
+    return NULL;
+}
+
+
+/************************************************************************
+ * Fonction principale
+ ************************************************************************/
+int main(int argc, char * argv[])
+{
+    Data data;
+    parseArgs(argc, argv, &data);
+
+    if (data.preload > 0)
+    {
+        elt_t *tab = ut_generateTabSeed(data.preload, data.min, data.max, 0, data.seed, 1);
+        CmSession session;
+        CmAnswer answer;
+        cm_openSession(&session);
+        cm_sendOrder(&session, CM_ORDER_INSERT_MANY, 0, tab, data.preload);
+        cm_receiveAnswer(&session, &answer);
+        cm_closeSession(&session, CM_ORDER_INSERT_MANY);
+        myassert(answer.code == CM_ANSWER_INSERT_MANY_OK, "echec du préchargement");
+        free(tab);
+    }
+
+    data.mailbox = NULL;
+    if (cm_handshakeMode() == CM_HANDSHAKE_FUTEX)
+        data.mailbox = cm_mailboxAttach();
+
+    printf("%d client(s) (%s), %.0f%% de lectures, boucle %s, débit visé : ", data.nbClients,
+           cm_handshakeName(cm_handshakeMode()), data.reads * 100, data.open ? "ouverte" : "fermée");
+    if (data.rate > 0)
+        printf("%.1f ordres/s\n", data.rate);
+    else
+        printf("maximal\n");
+
+    ClientData *clients = malloc(data.nbClients * sizeof(ClientData));
+    myassert(clients != NULL, "echec allocation des clients");
+    pthread_t threads[data.nbClients];
+
+    uint64_t start = ut_getTimeNs() + START_DELAY;
+    uint64_t end = start + (uint64_t) (data.duration * 1e9);
+    for (int i = 0; i < data.nbClients; i++)
+    {
+        clients[i].id = i;
+        clients[i].params = &data;
+        clients[i].start = start;
+        clients[i].end = end;
+        clients[i].nbReads = 0;
+        clients[i].nbWrites = 0;
+        clients[i].nbErrors = 0;
+        hg_init(&(clients[i].latency));
+        hg_init(&(clients[i].service));
+        hg_init(&(clients[i].wait));
+        int ret = pthread_create(&(threads[i]), NULL, client_function, &(clients[i]));
+        myassert(ret == 0, "echec création d'un client");
+    }
+    BulkData bulk = { &data, start, end, 0, { 0 } };
+    hg_init(&(bulk.duration));
+    pthread_t bulkThread;
+    if (data.bulk > 0)
+    {
+        int ret = pthread_create(&bulkThread, NULL, bulk_function, &bulk);
+        myassert(ret == 0, "echec création de l'écrivain");
+    }
+
+    // regroupement des résultats
+    Histogram latency, service, wait;
+    hg_init(&latency);
+    hg_init(&service);
+    hg_init(&wait);
+    long nbReads = 0, nbWrites = 0, nbErrors = 0;
+    long fewest = -1, most = 0;
+    for (int i = 0; i < data.nbClients; i++)
+    {
+        int ret = pthread_join(threads[i], NULL);
+        myassert(ret == 0, "echec attente d'un client");
+        long nb = clients[i].nbReads + clients[i].nbWrites;
+        nbReads += clients[i].nbReads;
+        nbWrites += clients[i].nbWrites;
+        nbErrors += clients[i].nbErrors;
+        if ((fewest == -1) || (nb < fewest))
+            fewest = nb;
+        if (nb > most)
+            most = nb;
+        hg_merge(&latency, &(clients[i].latency));
+        hg_merge(&service, &(clients[i].service));
+        hg_merge(&wait, &(clients[i].wait));
+    }
+    if (data.bulk > 0)
+    {
+        int ret = pthread_join(bulkThread, NULL);
+        myassert(ret == 0, "echec attente de l'écrivain");
+    }
+    double elapsed = (ut_getTimeNs() - start) * 1e-9;
+
+    printf("%ld ordres (%ld lectures, %ld écritures, %ld erreur(s)) en %.3f s : %.1f ordres/s\n",
+           nbReads + nbWrites, nbReads, nbWrites, nbErrors, elapsed, (nbReads + nbWrites) / elapsed);
+    printf("ordres par client : de %ld à %ld\n", fewest, most);
+    hg_print(&latency, stdout, data.open ? "latence depuis l'instant prévu" : "latence (corrigée)", 1e3, "µs");
+    hg_print(&service, stdout, "temps de service", 1e3, "µs");
+    hg_print(&wait, stdout, "dont attente de la session (master occupé)", 1e3, "µs");
+    if (data.bulk > 0)
+    {
+        printf("%ld insertmany de %d éléments pendant la mesure\n", bulk.nbBatches, data.bulk);
+        hg_print(&(bulk.duration), stdout, "durée d'un insertmany", 1e6, "ms");
+    }
+
+    if (data.mailbox != NULL)
+        cm_mailboxDetach(data.mailbox);
+
+    free(clients);
+    return EXIT_SUCCESS;
+}
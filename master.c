@@ -2,41 +2,144 @@
 #include "config.h"
 #endif
 
+// splice()
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <sys/sem.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <poll.h>
+#include <pthread.h>
 
 #include "utils.h"
 #include "myassert.h"
 
 #include "client_master.h"
 #include "master_worker.h"
+#include "trace.h"
+#include "perfcount.h"
+#include "masterio.h"
+#include "routing.h"
+#include "bloom.h"
+#include "keycache.h"
+#include "snapshot.h"
+#include "replica.h"
 
 /************************************************************************
  * Données persistantes d'un master
  ************************************************************************/
+typedef struct ReplicaThread ReplicaThread;
+
+// racine de l'arbre d'un ensemble (cf. CM_SET_DEFAULT), créée à sa
+// première insertion
 typedef struct
 {
-    // communication avec le client
-    int fdClientToMaster;
-    int fdMasterToClient;
-    // données internes
     bool hasChild;
-    bool isInInsertMany;
-    float elementInsertMany;
+    pid_t pid;                  // premier worker
     // communication avec le premier worker (double tubes)
     int fdWorker1ToMaster;
     int fdMasterToWorker1;
     // communication en provenance de tous les workers (un seul tube en lecture)
     int fdAnyWorkerToMaster;
+} SetRoot;
+
+typedef struct
+{
+    // communication avec le client (tubes nommés de l'espace MWC_SHARD)
+    char pipeClientToMaster[CM_NAME_MAX];
+    char pipeMasterToClient[CM_NAME_MAX];
+    int fdClientToMaster;
+    int fdMasterToClient;
+    // données internes : un arbre de workers par ensemble ; root est celui
+    // de l'ordre en cours (cf. selectSet, sous data->lock)
+    SetRoot sets[CM_MAX_SETS];
+    int set;
+    SetRoot *root;
+    // statistiques par type d'ordre (cf. CM_ORDER_STATS)
+    CmOrderStats stats[CM_NB_STATS_SLOTS];
+    CmOrderStats unknownStats;
+    bool miss;              // réponse négative pour l'ordre en cours
+    // dernier identifiant de trace attribué (cf. trace.h)
+    uint32_t lastTraceId;
+    // compteurs de performance ouverts (mode MWC_PERF=on, cf. perfcount.h)
+    bool perfOn;
+    // entrées/sorties bloquantes ou io_uring (MWC_IO, cf. masterio.h)
+    int ioMode;
+    // transmission des insertmany (MWC_INSERT_MANY, cf. client_master.h)
+    int bulkMode;
+    uint64_t bulkCopied;    // octets de tableaux lus puis réécrits par le master
+    uint64_t bulkSpliced;   // octets de tableaux transmis par splice
+    // boîte aux lettres (cf. client_master.h), servie par un second thread ;
+    // le verrou est pris pendant tout le traitement d'un ordre, quel que
+    // soit son canal (workers, statistiques, trace, masterio)
+    CmMailbox *mailbox;
+    pthread_t mailboxThread;
+    pthread_mutex_t lock;
+    bool stopping;          // ordre stop traité : la boîte aux lettres répond une erreur
+    uint64_t nbMailboxOrders;
+    // routage direct (MWC_ROUTE, cf. routing.h) : les inscriptions sont lues
+    // par un troisième thread, la table est protégée par son propre verrou
+    int routeMode;
+    int fdRoute;            // lecture des inscriptions (-1 tant qu'il n'y a pas de worker)
+    RtTable routes;
+    bool routesComplete;    // toutes les inscriptions reçues avec leur descripteur
+    pthread_t routesThread;
+    pthread_mutex_t routesLock;
+    uint64_t nbDirect;      // ordres envoyés directement au worker concerné
+    uint64_t nbAbsent;      // exist répondus par la table seule
+    // filtre de Bloom des éléments insérés (MWC_BLOOM, cf. bloom.h)
+    bool bloomOn;
+    BloomFilter bloom;
+    // cache des éléments demandés (MWC_CACHE, cf. keycache.h)
+    bool cacheOn;
+    KeyCache cache;
+    // instantané des lectures concurrentes (MWC_SNAPSHOT, cf. snapshot.h)
+    bool snapshotOn;
+    Snapshot snapshot;
+    Histogram snapshotLatency;  // lectures répondues par l'instantané (thread boîte aux lettres)
+    // répliques de l'arbre pour les lectures (MWC_REPLICAS, cf. replica.h),
+    // un thread chacune
+    int nbReplicas;
+    bool replicaBarrier;        // lecture de ses propres écritures
+    RpJournal journal;
+    ReplicaThread *replicas;
+    bool replicasRunning;
+    // insertions acquittées par l'arbre principal, pas encore validées pour
+    // l'instantané et les répliques (cf. commitWrites)
+    elt_t *staged;
+    int nbStaged;
+    int stagedCapacity;
+    bool inBatch;               // insertmany en cours : validation à la fin
+    // compteurs des raccourcis des exist (envoyés avec CM_ORDER_STATS)
+    CmExistStats exist;
 } Data;
 
+// une réplique et son thread
+struct ReplicaThread
+{
+    Data *data;
+    Replica replica;
+    pthread_mutex_t lock;   // échanges avec l'arbre (thread de la réplique, treestats)
+    pthread_t thread;
+    uint64_t applied;       // rang du journal déjà rejoué
+    elt_t *buf;             // copie du journal à rejouer
+    uint64_t bufCapacity;
+    uint64_t nbReads;
+    uint64_t nbBatches;
+};
+
 
 /************************************************************************
  * Usage et analyse des arguments passés en ligne de commande
@@ -57,319 +160,521 @@ void init(Data *data)
 {
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
-    data->hasChild = false ;
-    data->isInInsertMany = false;
-    data->elementInsertMany = 0;
+    for (int i = 0; i < CM_MAX_SETS; i++)
+        data->sets[i].hasChild = false;
+    data->set = CM_SET_DEFAULT;
+    data->root = &(data->sets[CM_SET_DEFAULT]);
+
+    for (int i = 0; i < CM_NB_STATS_SLOTS; i++)
+    {
+        data->stats[i].order = i * 10;
+        data->stats[i].misses = 0;
+        data->stats[i].errors = 0;
+        hg_init(&(data->stats[i].latency));
+        memset(&(data->stats[i].perf), 0, sizeof(PcTotals));
+    }
+    data->unknownStats.order = CM_ORDER_NONE;
+    data->unknownStats.misses = 0;
+    data->unknownStats.errors = 0;
+    hg_init(&(data->unknownStats.latency));
+    memset(&(data->unknownStats.perf), 0, sizeof(PcTotals));
+    data->miss = false;
+    data->lastTraceId = 0;
+
+    data->perfOn = pc_init();
+    const char *perfMode = getenv(PC_ENV_MODE);
+    if ((perfMode != NULL) && (strcmp(perfMode, "on") == 0) && ! data->perfOn)
+        fprintf(stderr, "[master] compteurs de performance indisponibles (perf_event_paranoid ?)\n");
+    if (data->perfOn)
+        pc_dumpHeader();
+
+    data->ioMode = mio_init();
+    data->bulkMode = cm_bulkMode();
+    data->bulkCopied = 0;
+    data->bulkSpliced = 0;
+
+    int ret = pthread_mutex_init(&(data->lock), NULL);
+    myassert(ret == 0, "echec initialisation verrou");
+    data->stopping = false;
+    data->nbMailboxOrders = 0;
+
+    data->routeMode = rt_mode();
+    data->fdRoute = -1;
+    rt_init(&(data->routes));
+    data->routesComplete = true;
+    ret = pthread_mutex_init(&(data->routesLock), NULL);
+    myassert(ret == 0, "echec initialisation verrou");
+    data->nbDirect = 0;
+    data->nbAbsent = 0;
+
+    memset(&(data->exist), 0, sizeof(CmExistStats));
+    const char *bloomSpec = getenv(BF_ENV_MODE);
+    uint64_t capacity;
+    double fpRate;
+    data->bloomOn = bf_parse(bloomSpec, &capacity, &fpRate);
+    if ((bloomSpec != NULL) && ! data->bloomOn)
+        fprintf(stderr, "[master] " BF_ENV_MODE " incorrect (<nbElements>[:<taux>]) : pas de filtre\n");
+    if (data->bloomOn){
+      bf_init(&(data->bloom), capacity, fpRate);
+      data->exist.bloomBytes = bf_bytes(&(data->bloom));
+      data->exist.bloomCapacity = capacity;
+      data->exist.bloomHashes = data->bloom.nbHashes;
+      data->exist.bloomTargetFp = fpRate;
+    }
+
+    const char *cacheSpec = getenv(KC_ENV_MODE);
+    int cacheCapacity;
+    data->cacheOn = kc_parse(cacheSpec, &cacheCapacity);
+    if ((cacheSpec != NULL) && ! data->cacheOn)
+        fprintf(stderr, "[master] " KC_ENV_MODE " incorrect (<nbEntrées>) : pas de cache\n");
+    if (data->cacheOn){
+      kc_init(&(data->cache), cacheCapacity);
+      data->exist.cacheBytes = kc_bytes(&(data->cache));
+      data->exist.cacheCapacity = cacheCapacity;
+    }
+
+    data->snapshotOn = sn_parse(getenv(SN_ENV_MODE));
+    if (data->snapshotOn)
+      sn_init(&(data->snapshot));
+    hg_init(&(data->snapshotLatency));
+
+    const char *replicaSpec = getenv(RP_ENV_MODE);
+    if (! rp_parse(replicaSpec, &(data->nbReplicas), &(data->replicaBarrier))){
+      data->nbReplicas = 0;
+      if (replicaSpec != NULL)
+        fprintf(stderr, "[master] " RP_ENV_MODE " incorrect (<nb>[:ryw], au plus %d) : pas de réplique\n", RP_MAX);
+    }
+    data->replicas = NULL;
+    data->replicasRunning = false;
+    if (data->nbReplicas > 0)
+      rp_journalInit(&(data->journal));
+
+    data->staged = NULL;
+    data->nbStaged = 0;
+    data->stagedCapacity = 0;
+    data->inBatch = false;
+    //un descripteur par worker : autant que permis
+    if (data->routeMode == RT_DIRECT){
+      struct rlimit limit;
+      if (getrlimit(RLIMIT_NOFILE, &limit) == 0){
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+      }
+    }
+}
+
+
+/************************************************************************
+ * envoi d'un ordre au premier worker
+ ************************************************************************/
+//même format que mw_writeOrder, mais par les entrées/sorties du master
+static void writeOrderTo(int fd, int order)
+{
+    MwOrderHeader header = { order, tr_traceId };
+    mio_write(fd, &header, sizeof(header));
+}
+
+static void writeOrder(Data *data, int order)
+{
+    writeOrderTo(data->root->fdMasterToWorker1, order);
+}
+
+
+/************************************************************************
+ * ensembles
+ ************************************************************************/
+//arbre visé par l'ordre en cours (sous data->lock)
+static void selectSet(Data *data, int set)
+{
+    data->set = set;
+    data->root = &(data->sets[set]);
+}
+
+//lecture et abandon des paramètres d'un ordre refusé
+static void skipParameters(Data *data, int order)
+{
+    if ((order == CM_ORDER_EXIST) || (order == CM_ORDER_INSERT)){
+      elt_t elt;
+      mio_read(data->fdClientToMaster, &elt, sizeof(elt_t));
+    }
+    else if (order == CM_ORDER_INSERT_MANY){
+      int size;
+      mio_read(data->fdClientToMaster, &size, sizeof(int));
+      elt_t buf[1024];
+      while (size > 0){
+        int nb = (size < 1024) ? size : 1024;
+        mio_read(data->fdClientToMaster, buf, nb * sizeof(elt_t));
+        size -= nb;
+      }
+    }
+}
+
+//filtre de Bloom, cache, routage direct, instantané et répliques ne
+//suivent que l'ensemble par défaut
+static bool defaultSet(const Data *data)
+{
+    return data->set == CM_SET_DEFAULT;
+}
+
+
+/************************************************************************
+ * table de routage (mode direct)
+ ************************************************************************/
+//élément absent à coup sûr (cf. findRoute)
+#define ROUTE_ABSENT    -2
+
+//lecture des inscriptions en attente
+static void drainRoutes(Data *data)
+{
+    pthread_mutex_lock(&(data->routesLock));
+    elt_t elt;
+    int fd;
+    int ret;
+    while ((ret = rt_receive(data->fdRoute, &elt, &fd)) != 0)
+    {
+      if (ret == 1)
+        rt_add(&(data->routes), elt, fd);
+      else
+        data->routesComplete = false;
+    }
+    pthread_mutex_unlock(&(data->routesLock));
+}
+
+//les inscriptions sont lues au fil de l'eau : pendant un insertmany, les
+//workers qui créent des fils ne restent pas bloqués sur une socket pleine
+static void * routesLoop(void *arg)
+{
+    Data *data = (Data *) arg;
+    struct pollfd pfd = { data->fdRoute, POLLIN, 0 };
+
+    while (true)
+    {
+      int ret = poll(&pfd, 1, -1);
+      myassert((ret > 0) || (errno == EINTR), "echec attente inscriptions");
+      drainRoutes(data);
+      //plus aucun worker, ou socket fermée par closeRoutes
+      if (pfd.revents & (POLLHUP | POLLERR | POLLNVAL))
+        break;
+    }
+    return NULL;
+}
+
+//début du routage direct, à la création du premier worker
+static void startRoutes(Data *data, int fdRoute, elt_t rootElt)
+{
+    data->fdRoute = fdRoute;
+    int fd = fcntl(data->root->fdMasterToWorker1, F_DUPFD_CLOEXEC, 0);
+    myassert(fd != -1, "echec copie canal du premier worker");
+    rt_add(&(data->routes), rootElt, fd);
+    int ret = pthread_create(&(data->routesThread), NULL, routesLoop, data);
+    myassert(ret == 0, "echec création thread des inscriptions");
+}
+
+static void closeRoutes(Data *data)
+{
+    if (data->fdRoute != -1){
+      shutdown(data->fdRoute, SHUT_RDWR);
+      int ret = pthread_join(data->routesThread, NULL);
+      myassert(ret == 0, "echec attente thread des inscriptions");
+      close(data->fdRoute);
+      data->fdRoute = -1;
+    }
+    rt_end(&(data->routes));
+    pthread_mutex_destroy(&(data->routesLock));
+}
+
+//canal du worker qui gère <elt> ; -1 s'il faut passer par l'arbre,
+//ROUTE_ABSENT si l'élément n'est pas dans l'ensemble
+//(toute inscription précède l'accusé de réception de création du worker
+//inscrit : après drainRoutes, la table contient tous les workers connus)
+static int findRoute(Data *data, elt_t elt)
+{
+    if ((data->routeMode != RT_DIRECT) || ! defaultSet(data) || ! data->root->hasChild)
+      return -1;
+    pthread_mutex_lock(&(data->routesLock));
+    int fd = rt_find(&(data->routes), elt);
+    if ((fd == -1) && data->routesComplete)
+      fd = ROUTE_ABSENT;
+    pthread_mutex_unlock(&(data->routesLock));
+    return fd;
 }
 
 
 /************************************************************************
  * fin du master
  ************************************************************************/
+static void stopReplicas(Data *data);
+
 void orderStop(Data *data)
 {
-    TRACE0("[master] ordre stop\n");
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
-    //cas pas de premier worker
-    if (data->hasChild){
-      //envoi de l'ordre d'arrêt au premier worker
-      int orderToSend = MW_ORDER_STOP;
-      int retw = write(data->fdMasterToWorker1, &orderToSend, sizeof(int));
-      myassert(retw != -1, "echec envoi ordre stop au worker 1");  
-      //attente de la fin du worker1 
-      wait(NULL);
+    //les répliques d'abord : ensuite le premier worker est le seul fils
+    stopReplicas(data);
+
+    //arrêt de l'arbre de chaque ensemble (cas pas de premier worker : rien)
+    for (int i = 0; i < CM_MAX_SETS; i++){
+      SetRoot *root = &(data->sets[i]);
+      if (root->hasChild){
+        //envoi de l'ordre d'arrêt au premier worker
+        writeOrderTo(root->fdMasterToWorker1, MW_ORDER_STOP);
+        mio_flush();
+        //attente de la fin du worker1 
+        waitpid(root->pid, NULL, 0);
+        root->hasChild = false;
+      }
     }
     // - envoi de l'accusé de réception au client 
     int receiptToSend = MW_ORDER_STOP;
-    int retw = write(data->fdMasterToClient, &receiptToSend, sizeof(int));
-    myassert(retw != -1, "echec envoi accusé de receptin stop au client");  
+    mio_write(data->fdMasterToClient, &receiptToSend, sizeof(int));
 
 }
 
 
 /************************************************************************
- * quel est la cardinalité de l'ensemble
+ * réponse d'un ordre simple
  ************************************************************************/
-void orderHowMany(Data *data)
-{
-    TRACE0("[master] ordre how many\n");
-    myassert(data != NULL, "il faut l'environnement d'exécution");
-
-    //initialisation nos variables
-    int nbTotal = 0 ;
-    int nbDistinct = 0; 
-    int receiptToSend ;
+//Les ordres simples (cf. cm_mailboxSupports) arrivent par les tubes nommés
+//ou par la boîte aux lettres : leur réponse est d'abord construite dans un
+//CmAnswer (answerXxx), puis envoyée par le canal de l'ordre.
 
-    //cas aucun worker
-    if (!data->hasChild){
+//envoi au client d'une réponse simple (format lu par cm_receiveAnswer)
+static void writeAnswer(Data *data, const CmAnswer *answer)
+{
+    mio_write(data->fdMasterToClient, &(answer->code), sizeof(int));
+    switch (answer->code)
+    {
+      case CM_ANSWER_EXIST_YES:
+        mio_write(data->fdMasterToClient, &(answer->quantity), sizeof(int));
+        break;
+      case CM_ANSWER_SUM_OK:
+        mio_write(data->fdMasterToClient, &(answer->sum), sizeof(eltsum_t));
+        break;
+      case CM_ANSWER_MINIMUM_OK:
+      case CM_ANSWER_MAXIMUM_OK:
+        mio_write(data->fdMasterToClient, &(answer->elt), sizeof(elt_t));
+        break;
+      case CM_ANSWER_HOW_MANY_OK:
+        mio_write(data->fdMasterToClient, &(answer->nbTotal), sizeof(int));
+        mio_write(data->fdMasterToClient, &(answer->nbDistinct), sizeof(int));
+        break;
+      default:
+        break;
+    }
+}
 
-      //envoi de l'accusé de reception au client 
-      receiptToSend = CM_ANSWER_HOW_MANY_OK ;
-      int retw = write(data->fdMasterToClient, &receiptToSend, sizeof(int));
-      myassert(retw != -1, "echec envoi accusé de reception");
 
-      //envoi des deux cardinalités aux clients ici (0)
-      retw = write(data->fdMasterToClient, &nbTotal, sizeof(int));
-      myassert(retw != -1, "echec envoi cardinalité");
+/************************************************************************
+ * quel est la cardinalité de l'ensemble
+ ************************************************************************/
+static void answerHowMany(Data *data, CmAnswer *answer)
+{
+    //cas aucun worker : les deux cardinalités valent 0
+    answer->code = CM_ANSWER_HOW_MANY_OK;
+    answer->nbTotal = 0;
+    answer->nbDistinct = 0;
 
-      retw = write(data->fdMasterToClient, &nbDistinct, sizeof(int));
-      myassert(retw != -1, "echec envoi cardinalité");
-    }
     //si il y au moins un worker
-    else { 
+    if (data->root->hasChild){
       //envoi l'ordre au worker
-      int order = MW_ORDER_HOW_MANY ;
-      int retw = write(data->fdMasterToWorker1, &order, sizeof(int));
-      myassert(retw != -1, "echec envoi order");
-
-      //recepetion de l'accusé de reception
-      int receipt ;
-      int retr = read(data->fdWorker1ToMaster, &receipt, sizeof(int));
-      myassert(retr != 0, "echec lecture accusé de reception");
+      writeOrder(data, MW_ORDER_HOW_MANY);
 
-      //reception des deux cardinalités 
-      retr = read(data->fdWorker1ToMaster, &nbTotal, sizeof(int));
-      myassert(retr != 0, "echec lecture cardinalité");
-
-      retr = read(data->fdWorker1ToMaster, &nbDistinct, sizeof(int));
-      myassert(retr != 0, "echec lecture cardinalité");
+      //recepetion de l'accusé de reception et des deux cardinalités (lectures liées)
+      int counts[2];
+      mio_readLinked(data->root->fdWorker1ToMaster, &(answer->code), sizeof(int), counts, sizeof(counts));
+      answer->nbTotal = counts[0];
+      answer->nbDistinct = counts[1];
+    }
+}
 
-      //envoi de l'accusé de reception au client
-      retw = write(data->fdMasterToClient, &receipt, sizeof(int));
-      myassert(retw != -1, "echec envoi accusé de reception");
-      
-      //envoi de nos deux cardinalités au client
-      retw = write(data->fdMasterToClient, &nbTotal, sizeof(int));
-      myassert(retw != -1, "echec envoi somme");
+void orderHowMany(Data *data)
+{
+    myassert(data != NULL, "il faut l'environnement d'exécution");
 
-      retw = write(data->fdMasterToClient, &nbDistinct, sizeof(int));
-      myassert(retw != -1, "echec envoi somme");
-    }
+    CmAnswer answer;
+    answerHowMany(data, &answer);
+    writeAnswer(data, &answer);
 }
 
 
 /************************************************************************
  * quel est la minimum de l'ensemble
  ************************************************************************/
-void orderMinimum(Data *data)
+static void answerMinimum(Data *data, CmAnswer *answer)
 {
-    TRACE0("[master] ordre minimum\n");
-    myassert(data != NULL, "il faut l'environnement d'exécution");
-
     //si ensemble vide (pas de premier worker)
-    if (!data->hasChild){
-      //envoi de l'accusé de reception prévu au client
-      int receiptSent = CM_ANSWER_MINIMUM_EMPTY;
-      int retw = write(data->fdMasterToClient, &receiptSent, sizeof(int));
-      myassert(retw != -1, "echec envoi accusé de reception");
+    if (!data->root->hasChild){
+      data->miss = true;
+      answer->code = CM_ANSWER_MINIMUM_EMPTY;
     }
     //sinon
     else{
       //envoi au premier worker de l'ordre minimum 
-      int orderToSend = MW_ORDER_MINIMUM;
-      int retw = write(data->fdMasterToWorker1, &orderToSend, sizeof(int));
-      myassert(retw != -1, "echec envoi ordre"); 
-
-      //reception de l'accusé de réception venant du worker concerné
-      int receipt ;
-      int retr = read(data->fdAnyWorkerToMaster, &receipt, sizeof(int));
-      myassert(retr != 0, "echec lecture accusé de reception");
+      writeOrder(data, MW_ORDER_MINIMUM);
 
-      //reception du résultat venant du worker concerné
-      float result; 
-      retr = read(data->fdAnyWorkerToMaster, &result, sizeof(float));
-      myassert(retr != 0, "echec lecture element");
+      //reception de l'accusé de réception et du résultat venant du worker concerné
+      mio_readLinked(data->root->fdAnyWorkerToMaster, &(answer->code), sizeof(int), &(answer->elt), sizeof(elt_t));
+    }
+}
 
-      //envoi de l'accusé de réception au client
-      retw = write(data->fdMasterToClient, &receipt, sizeof(int));
-      myassert(retw != -1, "echec envoi accusé de reception"); 
+void orderMinimum(Data *data)
+{
+    myassert(data != NULL, "il faut l'environnement d'exécution");
 
-      //envoi du résultat au client
-      retw = write(data->fdMasterToClient, &result, sizeof(float));
-      myassert(retw != -1, "echec envoi element"); 
-    }
+    CmAnswer answer;
+    answerMinimum(data, &answer);
+    writeAnswer(data, &answer);
 }
 
 
 /************************************************************************
  * quel est la maximum de l'ensemble
  ************************************************************************/
-void orderMaximum(Data *data)
+static void answerMaximum(Data *data, CmAnswer *answer)
 {
-    TRACE0("[master] ordre maximum\n");
-    myassert(data != NULL, "il faut l'environnement d'exécution");
-
     //si ensemble vide (pas de premier worker)
-    if (!data->hasChild){
-      //envoi de l'accusé de reception prévu au client
-      int receiptSent = CM_ANSWER_MAXIMUM_EMPTY;
-      int retw = write(data->fdMasterToClient, &receiptSent, sizeof(int));
-      myassert(retw != -1, "echec envoi accusé de reception");
+    if (!data->root->hasChild){
+      data->miss = true;
+      answer->code = CM_ANSWER_MAXIMUM_EMPTY;
     }
     //sinon
     else{
       //envoi au premier worker de l'ordre maximim 
-      int orderToSend = MW_ORDER_MAXIMUM;
-      int retw = write(data->fdMasterToWorker1, &orderToSend, sizeof(int));
-      myassert(retw != -1, "echec envoi ordre"); 
-
-      //reception de l'accusé de réception venant du worker concerné
-      int receipt ;
-      int retr = read(data->fdAnyWorkerToMaster, &receipt, sizeof(int));
-      myassert(retr != 0, "echec lecture accusé de reception") ;
+      writeOrder(data, MW_ORDER_MAXIMUM);
 
-      //reception du résultat venant du worker concerné
-      float result; 
-      retr = read(data->fdAnyWorkerToMaster, &result, sizeof(float));
-      myassert(retr != 0, "echec lecture element");
+      //reception de l'accusé de réception et du résultat venant du worker concerné
+      mio_readLinked(data->root->fdAnyWorkerToMaster, &(answer->code), sizeof(int), &(answer->elt), sizeof(elt_t));
+    }
+}
 
-      //envoi de l'accusé de réception au client
-      retw = write(data->fdMasterToClient, &receipt, sizeof(int));
-      myassert(retw != -1, "echec envoi accusé de reception"); 
+void orderMaximum(Data *data)
+{
+    myassert(data != NULL, "il faut l'environnement d'exécution");
 
-      //envoi du résultat au client
-      retw = write(data->fdMasterToClient, &result, sizeof(float));
-      myassert(retw != -1, "echec envoi element"); 
-    }
+    CmAnswer answer;
+    answerMaximum(data, &answer);
+    writeAnswer(data, &answer);
 }
 
 
 /************************************************************************
  * test d'existence
  ************************************************************************/
-void orderExist(Data *data)
+static void answerExist(Data *data, elt_t myElt, CmAnswer *answer)
 {
-    TRACE0("[master] ordre existence\n");
-    myassert(data != NULL, "il faut l'environnement d'exécution");
+    //cache : cardinalité d'un élément déjà demandé
+    if (data->cacheOn && defaultSet(data) && kc_lookup(&(data->cache), myElt, &(answer->quantity))){
+      answer->code = CM_ANSWER_EXIST_YES;
+      return;
+    }
 
-    //reception de l'élément à insérer en provenance du client
-    float myElt;
-    int retr = read(data->fdClientToMaster, &myElt, sizeof(float));
-    myassert(retr != 0, "echec lecture elt float");
+    //filtre de Bloom : un élément jamais inséré est absent
+    bool bloomMaybe = false;
+    if (data->bloomOn && defaultSet(data) && data->root->hasChild){
+      data->exist.bloomLookups++;
+      if (! bf_mayContain(&(data->bloom), myElt)){
+        data->exist.bloomNegatives++;
+        data->miss = true;
+        answer->code = CM_ANSWER_EXIST_NO;
+        return;
+      }
+      bloomMaybe = true;
+    }
 
-    //si pas de premier worker
-    if(!data->hasChild){
-      //envoi de l'accusé de reception prévu
-      int receiptSent = CM_ANSWER_EXIST_NO;
-      int retw = write(data->fdMasterToClient, &receiptSent, sizeof(int));
-      myassert(retw != -1, "error orderMaximum : echec envoi accusé de reception");
+    //routage direct : worker concerné, ou aucun
+    int fdRoute = findRoute(data, myElt);
+    if (fdRoute == ROUTE_ABSENT)
+      data->nbAbsent++;
+    else if (fdRoute != -1)
+      data->nbDirect++;
+
+    //si pas de premier worker (ou élément absent de la table de routage)
+    if(!data->root->hasChild || (fdRoute == ROUTE_ABSENT)){
+      data->miss = true;
+      answer->code = CM_ANSWER_EXIST_NO;
     }
     //si il y a au moins un worker 
     else{
-      //envoi de l'ordre au premier worker 
-      int orderToSend = MW_ORDER_EXIST ; 
-      int retw = write(data->fdMasterToWorker1, &orderToSend, sizeof(int));
-      myassert(retw != -1, "echec envoi ordre au worker 1");    
+      //envoi de l'ordre au premier worker (ou directement au worker concerné)
+      int fdTo = (fdRoute != -1) ? fdRoute : data->root->fdMasterToWorker1;
+      writeOrderTo(fdTo, MW_ORDER_EXIST);
 
       //envoi de l'élément à vérifier
-      retw = write(data->fdMasterToWorker1, &myElt, sizeof(float));
-      myassert(retw != -1, "echec envoi element");
+      mio_write(fdTo, &myElt, sizeof(elt_t));
 
       //reception de la réponse du worker concerné 
       int receiptReceived;
-      int retr = read(data->fdAnyWorkerToMaster, &receiptReceived, sizeof(int));
-      myassert(retr != 0, "echec lecture accusé de reception");
-      //printf("MASTER : j'ai recu la reponse : %d\n", receiptReceived);
+      mio_read(data->root->fdAnyWorkerToMaster, &receiptReceived, sizeof(int));
 
       //si l'élément n'existe pas 
       if (receiptReceived == MW_ANSWER_EXIST_NO){
-        //envoi de l'accusé de reception au client
-        int receiptToSend = receiptReceived+1 ; //conversion pour la réponse du worker et celle du client
-        int retw = write(data->fdMasterToClient, &receiptToSend, sizeof(int));
-        myassert(retw != -1, "echec envoi accusé de reception");
+        data->miss = true;
+        answer->code = receiptReceived+1 ; //conversion pour la réponse du worker et celle du client
       }
       //si l'élément existe 
       else {
           //reception de la cardinalité de l'élément 
-          int quantity;
-          int retr = read(data->fdAnyWorkerToMaster, &quantity, sizeof(int));
-          myassert(retr != 0, "echec lecture quantite recue");
-
-          //envoi de l'accusé de reception au client
-          int receiptToSend = receiptReceived-1 ; //conversion pour la réponse du worker et celle du client
-          int retw = write(data->fdMasterToClient, &receiptToSend, sizeof(int));
-          myassert(retw != -1, "echec envoi accusé de reception");
+          mio_read(data->root->fdAnyWorkerToMaster, &(answer->quantity), sizeof(int));
+          answer->code = receiptReceived-1 ; //conversion pour la réponse du worker et celle du client
+          if (data->cacheOn && defaultSet(data))
+            kc_put(&(data->cache), myElt, answer->quantity);
+      }
+    }
 
-          //envoi de la cardinalité au client 
-          retw = write(data->fdMasterToClient, &quantity, sizeof(int));
-          myassert(retw != -1, "echec envoi quantite");
+    if (bloomMaybe && (answer->code == CM_ANSWER_EXIST_NO))
+      data->exist.bloomFalsePositives++;
+}
 
-      }
+void orderExist(Data *data)
+{
+    myassert(data != NULL, "il faut l'environnement d'exécution");
 
-    }
+    //reception de l'élément à insérer en provenance du client
+    elt_t myElt;
+    mio_read(data->fdClientToMaster, &myElt, sizeof(elt_t));
 
+    CmAnswer answer;
+    answerExist(data, myElt, &answer);
+    writeAnswer(data, &answer);
 }
 
 /************************************************************************
  * somme
  ************************************************************************/
-void orderSum(Data *data)
+static void answerSum(Data *data, CmAnswer *answer)
 {
-    TRACE0("[master] ordre somme\n");
-    myassert(data != NULL, "il faut l'environnement d'exécution");
-    float resultToSend = 0 ;
-    int receiptToSend;
-    
-    //cas pas de premier worker 
-    if (!data->hasChild){
-      //envoi de l'accusé de reception au client 
-      receiptToSend = CM_ANSWER_SUM_OK ;
-      int retw = write(data->fdMasterToClient, &receiptToSend, sizeof(int));
-      myassert(retw != -1, "echec envoi accusé de reception");
+    //cas pas de premier worker : la somme vaut 0
+    answer->code = CM_ANSWER_SUM_OK;
+    answer->sum = 0;
 
-      //envoi du résultat de la somme au client (ici 0)
-      retw = write(data->fdMasterToClient, &resultToSend, sizeof(float));
-      myassert(retw != -1, "echec envoi somme");
-    }
     //si il existe au moins un worker 
-    else {
+    if (data->root->hasChild){
       //envoi de l'ordre vers le premier worker
-      int order = MW_ORDER_SUM ;
-      int retw = write(data->fdMasterToWorker1, &order, sizeof(int));
-      myassert(retw != -1, "echec envoi order");
+      writeOrder(data, MW_ORDER_SUM);
 
-      //reception de la réponse du premier worker
-      int receipt ;
-      int retr = read(data->fdWorker1ToMaster, &receipt, sizeof(int));
-      myassert(retr != 0, "echec lecture accusé de reception");
-
-      //reception du résultat de la somme venant du premier worker
-      retr = read(data->fdWorker1ToMaster, &resultToSend, sizeof(float));
-      myassert(retr != 0, "echec lecture somme");
+      //reception de la réponse et du résultat de la somme venant du premier worker
+      mio_readLinked(data->root->fdWorker1ToMaster, &(answer->code), sizeof(int), &(answer->sum), sizeof(eltsum_t));
+    }
+}
 
-      //envoi de l'accusé de reception au client
-      retw = write(data->fdMasterToClient, &receipt, sizeof(int));
-      myassert(retw != -1, "echec envoi accusé de reception");
+void orderSum(Data *data)
+{
+    myassert(data != NULL, "il faut l'environnement d'exécution");
 
-      //envoi du résultat de la somme au client
-      retw = write(data->fdMasterToClient, &resultToSend, sizeof(float));
-      myassert(retw != -1, "echec envoi somme");
-    }
+    CmAnswer answer;
+    answerSum(data, &answer);
+    writeAnswer(data, &answer);
 }
 
 /************************************************************************
  * insertion d'un élément
  ************************************************************************/
-void orderInsert(Data *data)
+//envoi de l'élément au premier worker, créé avec cet élément s'il n'existe
+//pas encore ; le worker concerné répond sur fdAnyWorkerToMaster
+static void sendInsert(Data *data, elt_t myElt)
 {
-    TRACE0("[master] ordre insertion\n");
-    myassert(data != NULL, "il faut l'environnement d'exécution");
-
-    float myElt;
-    //si on est dans un cas insertmany on récupère l'élément à inserer depuis data 
-    if (data->isInInsertMany){
-      myElt = data->elementInsertMany;
-    }
-    //sinon on receptionne l'élément depuis le client
-    else {
-      // - reception de l'élément à insérer en provenance du client
-      int retr = read(data->fdClientToMaster, &myElt, sizeof(float));
-      myassert(retr != 0, "echec lecture elt float");
-    }
-
     // - si pas de premier worker
-    if(!data->hasChild){
+    if(!data->root->hasChild){
 
       //création des tubes anonymes
       int fdsMastertoWorker1[2];
@@ -378,8 +683,16 @@ void orderInsert(Data *data)
       pipe(fdsWorker1toMaster);
       int fdsAnyWorkertoMaster[2];
       pipe(fdsAnyWorkertoMaster);
+      //inscriptions des workers (routage direct)
+      int fdsRoute[2] = { -1, -1 };
+      if ((data->routeMode == RT_DIRECT) && defaultSet(data)){
+        //(aucun autre processus lancé par le master n'en hérite)
+        int ret = socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fdsRoute);
+        myassert(ret == 0, "echec création socket des inscriptions");
+      }
 
       //on fork le master
+      mio_flush();
       int f1 = fork();
       //si on est dans le fils, le fils devient alors le premier worker 
       if(f1 == 0){
@@ -388,10 +701,14 @@ void orderInsert(Data *data)
         close(fdsMastertoWorker1[1]);
         close(fdsWorker1toMaster[0]);
         close(fdsAnyWorkertoMaster[0]);
+        if (fdsRoute[0] != -1){
+          close(fdsRoute[0]);
+          fcntl(fdsRoute[1], F_SETFD, 0);     //transmis au premier worker
+        }
 
         //on convertit nos arguments en string
         char myEltString[50];
-        sprintf(myEltString,"%f",myElt);
+        sprintf(myEltString, ELT_ARG_FMT, myElt);
 
         char fdInString[50];
         sprintf(fdInString,"%d",fdsMastertoWorker1[0]);
@@ -402,8 +719,12 @@ void orderInsert(Data *data)
         char fdtoMasterString[50];
         sprintf(fdtoMasterString, "%d", fdsAnyWorkertoMaster[1]);
 
+        char fdRouteString[50];
+        sprintf(fdRouteString, "%d", fdsRoute[1]);
+
         // - crée le premier worker avec l'élément reçu du client
-        execl("worker", "./worker", myEltString, fdInString, fdOutString, fdtoMasterString, NULL); 
+        execl("worker", "./worker", myEltString, fdInString, fdOutString, fdtoMasterString, fdtoMasterString,
+              fdRouteString, NULL); 
       }
       // alors on est dans le père 
       else{
@@ -412,92 +733,249 @@ void orderInsert(Data *data)
         close(fdsMastertoWorker1[0]);
         close(fdsWorker1toMaster[1]);
         close(fdsAnyWorkertoMaster[1]);
+        //(les premiers workers des autres ensembles n'en héritent pas)
+        fcntl(fdsMastertoWorker1[1], F_SETFD, FD_CLOEXEC);
+        fcntl(fdsWorker1toMaster[0], F_SETFD, FD_CLOEXEC);
+        fcntl(fdsAnyWorkertoMaster[0], F_SETFD, FD_CLOEXEC);
 
         //on renseigne les file descriptors permettant de communiquer avec le worker1 et celui du retour des workers
-        data->fdMasterToWorker1=fdsMastertoWorker1[1];
-        data->fdWorker1ToMaster=fdsWorker1toMaster[0];
-        data->fdAnyWorkerToMaster=fdsAnyWorkertoMaster[0];
+        data->root->fdMasterToWorker1=fdsMastertoWorker1[1];
+        data->root->fdWorker1ToMaster=fdsWorker1toMaster[0];
+        data->root->fdAnyWorkerToMaster=fdsAnyWorkertoMaster[0];
 
         //et maintenant on a un premier worker (enfant)
-        data->hasChild = true ;
+        data->root->pid = f1;
+        data->root->hasChild = true ;
+
+        if (fdsRoute[0] != -1){
+          close(fdsRoute[1]);
+          startRoutes(data, fdsRoute[0], myElt);
+        }
       }
     }
     // si on a deja un premier worker (enfant)
     else {
     //envoie au premier worker de l'ordre insertion 
-    int orderToSend = MW_ORDER_INSERT ; 
-    int retw = write(data->fdMasterToWorker1, &orderToSend, sizeof(int));
-    myassert(retw != -1, "echec envoi ordre au worker 1");    
+    writeOrder(data, MW_ORDER_INSERT);
 
     //envoie au premier worker l'élément à insérer
-    retw = write(data->fdMasterToWorker1, &myElt, sizeof(float));
-    myassert(retw != -1, "echec envoi element");
+    mio_write(data->root->fdMasterToWorker1, &myElt, sizeof(elt_t));
     }
+}
 
-    //si on est pas dans un cas d'insert many on procède normalement
-    if (!data->isInInsertMany){
-    //reception de l'accusé de réception venant du worker concerné
-    int receiptReceived;
-    int retr = read(data->fdAnyWorkerToMaster, &receiptReceived, sizeof(int));
-    myassert(retr != 0, "echec lecture accusé de reception");
+/************************************************************************
+ * validation des écritures (instantané, répliques)
+ ************************************************************************/
+//l'instantané et les répliques doivent connaître chaque élément inséré
+//(de l'ensemble par défaut)
+static bool keepsWrites(const Data *data)
+{
+    return defaultSet(data) && (data->snapshotOn || (data->nbReplicas > 0));
+}
 
-    //envoi de l'accusé de réception au client
-    int receiptToSend = receiptReceived ; 
-    int retw = write(data->fdMasterToClient, &receiptToSend, sizeof(int));
-    myassert(retw != -1, "echec envoi accusé de reception");
+//éléments acquittés par l'arbre principal, en attente de validation
+static void stageWrites(Data *data, const elt_t *elts, int nb)
+{
+    if (data->nbStaged + nb > data->stagedCapacity){
+      while (data->nbStaged + nb > data->stagedCapacity)
+        data->stagedCapacity = (data->stagedCapacity == 0) ? 1024 : 2 * data->stagedCapacity;
+      data->staged = realloc(data->staged, data->stagedCapacity * sizeof(elt_t));
+      myassert(data->staged != NULL, "echec allocation des écritures en attente");
     }
-    //si on est dans un cas d'insert many
-    else {
-      data->isInInsertMany = false;
+    memcpy(&(data->staged[data->nbStaged]), elts, nb * sizeof(elt_t));
+    data->nbStaged += nb;
+}
+
+//tout ce qui est en attente devient visible d'un coup (avant l'accusé de
+//réception au client)
+static void commitWrites(Data *data)
+{
+    if (data->snapshotOn)
+      sn_commit(&(data->snapshot), data->staged, data->nbStaged);
+
+    if ((data->nbReplicas > 0) && (data->nbStaged > 0)){
+      //le début du journal rejoué par toutes les répliques peut être oublié
+      uint64_t applied = UINT64_MAX;
+      for (int i = 0; i < data->nbReplicas; i++){
+        uint64_t a = __atomic_load_n(&(data->replicas[i].applied), __ATOMIC_ACQUIRE);
+        applied = (a < applied) ? a : applied;
+      }
+      rp_journalAppend(&(data->journal), data->staged, data->nbStaged, applied);
+      //les répliques attendent sur seq, comme la boîte aux lettres
+      __atomic_add_fetch(&(data->mailbox->seq), 1, __ATOMIC_SEQ_CST);
+      cm_futexWake(&(data->mailbox->seq), INT_MAX);
     }
+    data->nbStaged = 0;
 }
 
+static void answerInsert(Data *data, elt_t myElt, CmAnswer *answer)
+{
+    //routage direct : un élément déjà présent va directement à son worker
+    int fdRoute = findRoute(data, myElt);
+    if (fdRoute >= 0){
+      data->nbDirect++;
+      writeOrderTo(fdRoute, MW_ORDER_INSERT);
+      mio_write(fdRoute, &myElt, sizeof(elt_t));
+    }
+    else
+      sendInsert(data, myElt);
+
+    //reception de l'accusé de réception venant du worker concerné
+    mio_read(data->root->fdAnyWorkerToMaster, &(answer->code), sizeof(int));
+    if (data->bloomOn && defaultSet(data))
+      bf_add(&(data->bloom), myElt);
+    if (data->cacheOn && defaultSet(data))
+      kc_increment(&(data->cache), myElt);
+    //(dans un insertmany, la validation attend la fin du lot)
+    if (keepsWrites(data)){
+      stageWrites(data, &myElt, 1);
+      if (! data->inBatch)
+        commitWrites(data);
+    }
 
-/************************************************************************
- * insertion d'un tableau d'éléments
- ************************************************************************/
-void orderInsertMany(Data *data)
+    //un worker éventuellement créé s'est inscrit avant son accusé de réception
+    if (data->fdRoute != -1)
+      drainRoutes(data);
+}
+
+void orderInsert(Data *data)
 {
-    TRACE0("[master] ordre insertion tableau\n");
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
-    //reception de la taille du tableau d'éléments à insérer en provenance du client
-    int size; 
-    int retr = read(data->fdClientToMaster, &size, sizeof(int));
-    myassert(retr != 0, "echec lecture taille du tableau");
+    // - reception de l'élément à insérer en provenance du client
+    elt_t myElt;
+    mio_read(data->fdClientToMaster, &myElt, sizeof(elt_t));
+
+    CmAnswer answer;
+    answerInsert(data, myElt, &answer);
+    writeAnswer(data, &answer);
+}
 
-    //printf(" la taille du tableau est %d \n", size);
 
+/************************************************************************
+ * insertion d'un tableau d'éléments
+ ************************************************************************/
+//un ordre d'insertion par élément
+static void insertManyElements(Data *data, int size)
+{
     //reception du tableau d'éléments à insérer en provenance du client
-    float tab[size];
-    retr = read(data->fdClientToMaster, &tab, size * sizeof(float));
-    myassert(retr != 0, "echec lecture tableau");
+    //(un tube ne contient que 64Ko : lu en plusieurs fois si besoin)
+    elt_t *tab = malloc(size * sizeof(elt_t));
+    myassert(tab != NULL, "echec allocation tableau");
+    mio_read(data->fdClientToMaster, tab, size * sizeof(elt_t));
+    data->bulkCopied += size * sizeof(elt_t);
 
     //on insère chaque élément 
     for (int i = 0; i<size; i++){
-      //on active notre variable qui indique qu'on est dans un cas InsertMany
-      data->isInInsertMany=true;
-      //on passe dans data l'element à inserer
-      data->elementInsertMany=tab[i];
+      CmAnswer answer;
+      answerInsert(data, tab[i], &answer);
+    }
 
-      //on envoie l'ordre d'insertion 
-      orderInsert(data);
+    free(tab);
+}
 
-      //on intercepte l'accusé de reception prévu par l'ordre insert
-      int receiptReceived;
-      retr = read(data->fdAnyWorkerToMaster, &receiptReceived, sizeof(int));
-      myassert(retr != 0, "echec lecture accusé de reception");
+//transfert de <size> octets d'un tube à l'autre sans passer par le master
+//(retourne le nombre d'octets non transférés si splice n'est pas possible)
+static size_t spliceAll(int fdIn, int fdOut, size_t size)
+{
+    while (size > 0)
+    {
+      ssize_t ret = splice(fdIn, NULL, fdOut, NULL, size, SPLICE_F_MOVE);
+      if ((ret == -1) && (errno == EINVAL))
+        break;
+      myassert(ret > 0, "echec transfert tableau");
+      size -= ret;
     }
+    return size;
+}
+
+//filtre de Bloom, cache, instantané et répliques doivent voir chaque
+//élément inséré
+static bool seesElements(const Data *data)
+{
+    return (defaultSet(data) && (data->bloomOn || data->cacheOn)) || keepsWrites(data);
+}
+
+//un seul ordre MW_ORDER_INSERT_MANY pour tout le tableau
+static void insertManyBulk(Data *data, int size)
+{
+    //sans premier worker : il est créé avec le premier élément
+    int first = 0;
+    if (!data->root->hasChild && size > 0){
+      elt_t myElt;
+      mio_read(data->fdClientToMaster, &myElt, sizeof(elt_t));
+      CmAnswer answer;
+      answerInsert(data, myElt, &answer);
+      first = 1;
+    }
+    int rest = size - first;
+    if (rest == 0)
+      return;
+
+    //en-tête de l'ordre, puis le tableau
+    writeOrder(data, MW_ORDER_INSERT_MANY);
+    mio_write(data->root->fdMasterToWorker1, &rest, sizeof(int));
+    size_t toCopy = rest * sizeof(elt_t);
+    //(le master doit-il voir les éléments : pas de splice)
+    if ((data->bulkMode == CM_BULK_SPLICE) && ! seesElements(data)){
+      mio_flush();
+      size_t left = spliceAll(data->fdClientToMaster, data->root->fdMasterToWorker1, toCopy);
+      data->bulkSpliced += toCopy - left;
+      toCopy = left;
+    }
+    if (toCopy > 0){
+      char *tab = malloc(toCopy);
+      myassert(tab != NULL, "echec allocation tableau");
+      mio_read(data->fdClientToMaster, tab, toCopy);
+      bool tracked = defaultSet(data) && (data->bloomOn || data->cacheOn);
+      for (size_t i = 0; tracked && (i < toCopy / sizeof(elt_t)); i++){
+        elt_t elt = ((const elt_t *) tab)[i];
+        if (data->bloomOn)
+          bf_add(&(data->bloom), elt);
+        if (data->cacheOn)
+          kc_increment(&(data->cache), elt);
+      }
+      if (keepsWrites(data))
+        stageWrites(data, (const elt_t *) tab, toCopy / sizeof(elt_t));
+      mio_write(data->root->fdMasterToWorker1, tab, toCopy);
+      mio_flush();
+      free(tab);
+      data->bulkCopied += toCopy;
+    }
+
+    //le premier worker répond une fois tout l'arbre à jour
+    int receiptReceived;
+    mio_read(data->root->fdWorker1ToMaster, &receiptReceived, sizeof(int));
+    myassert(receiptReceived == MW_ANSWER_INSERT_MANY, "accusé de reception inattendu");
+
+    //inscriptions des workers créés, pas encore lues par le thread
+    if (data->fdRoute != -1)
+      drainRoutes(data);
+}
+
+void orderInsertMany(Data *data)
+{
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    //reception de la taille du tableau d'éléments à insérer en provenance du client
+    int size; 
+    mio_read(data->fdClientToMaster, &size, sizeof(int));
+    myassert(size >= 0, "taille du tableau incorrecte");
+
+    data->inBatch = true;
+    if (data->bulkMode == CM_BULK_ELEMENT)
+      insertManyElements(data, size);
+    else
+      insertManyBulk(data, size);
+    data->inBatch = false;
+
+    //tout le lot devient visible d'un coup, avant l'accusé de réception
+    if (keepsWrites(data))
+      commitWrites(data);
 
     //on envoie l'accusé de reception au client 
     int receiptSent = CM_ANSWER_INSERT_MANY_OK;
-    int retw = write(data->fdMasterToClient, &receiptSent, sizeof(int));
-    myassert(retw != -1, "echec envoi accusé de reception");
-    
-    //on reinitialise nos variables 
-    data->elementInsertMany=false; 
-    data->elementInsertMany=0;
-
+    mio_write(data->fdMasterToClient, &receiptSent, sizeof(int));
 }
 
 
@@ -506,31 +984,413 @@ void orderInsertMany(Data *data)
  ************************************************************************/
 void orderPrint(Data *data)
 {
-    TRACE0("[master] ordre affichage\n");
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
     //cas ensemble vide
-    if (!data->hasChild){
-      TRACE0("pas de premier worker\n");
+    if (!data->root->hasChild){
       int receiptSent = CM_ANSWER_PRINT_OK;
-      int retw = write(data->fdMasterToClient, &receiptSent, sizeof(int));
-      myassert(retw != -1, "echec envoi accusé de reception");
+      mio_write(data->fdMasterToClient, &receiptSent, sizeof(int));
     }
     else{
       //envoi au premier worker de l'ordre print
-      int orderToSend = MW_ORDER_PRINT ; 
-      int retw = write(data->fdMasterToWorker1, &orderToSend, sizeof(int));
-      myassert(retw != -1, "echec envoi ordre au worker 1");    
+      writeOrder(data, MW_ORDER_PRINT);
 
       //reception de l'accusé de réception venant du premier worker
       int receiptReceived;
-      int retr = read(data->fdWorker1ToMaster, &receiptReceived, sizeof(int));
-      myassert(retr != 0, "echec lecture accusé de reception");
+      mio_read(data->root->fdWorker1ToMaster, &receiptReceived, sizeof(int));
 
       //envoi de l'accusé de reception vers le client avec la conversion vers le bon ordre 
       int receiptSent = receiptReceived + 10;
-      retw = write(data->fdMasterToClient, &receiptSent, sizeof(int));
-      myassert(retw != -1, "echec envoi accusé de reception");
+      mio_write(data->fdMasterToClient, &receiptSent, sizeof(int));
+    }
+}
+
+
+/************************************************************************
+ * statistiques des ordres
+ ************************************************************************/
+void orderStats(Data *data)
+{
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    //seuls les types d'ordres déjà reçus sont envoyés
+    const CmOrderStats *sent[CM_NB_STATS_SLOTS + 1];
+    int nb = 0;
+    for (int i = 0; i < CM_NB_STATS_SLOTS; i++)
+      if (data->stats[i].latency.count > 0)
+        sent[nb++] = &(data->stats[i]);
+    if (data->unknownStats.errors > 0)
+      sent[nb++] = &(data->unknownStats);
+
+    int receiptSent = CM_ANSWER_STATS_OK;
+    mio_write(data->fdMasterToClient, &receiptSent, sizeof(int));
+    //les statistiques sont écrites directement, après l'accusé de reception
+    mio_flush();
+    cm_writeStats(data->fdMasterToClient, sent, nb);
+
+    //raccourcis des exist
+    if (data->bloomOn)
+      data->exist.bloomEstimatedFp = bf_estimatedFp(&(data->bloom));
+    if (data->cacheOn){
+      data->exist.cacheEntries = data->cache.nb;
+      data->exist.cacheLookups = data->cache.lookups;
+      data->exist.cacheHits = data->cache.hits;
+      data->exist.cacheEvictions = data->cache.evictions;
+    }
+    cm_writeAll(data->fdMasterToClient, &(data->exist), sizeof(CmExistStats));
+}
+
+
+/************************************************************************
+ * forme de l'arbre des workers
+ ************************************************************************/
+//ajout de l'arbre d'un ensemble à la forêt du master (profondeurs
+//additionnées niveau par niveau)
+static void addTree(MwTreeStats *forest, int **depths, const MwTreeStats *tree, const int *treeDepths)
+{
+    if (tree->height > forest->height){
+      *depths = realloc(*depths, tree->height * sizeof(int));
+      myassert(*depths != NULL, "echec allocation des profondeurs");
+      for (int d = forest->height; d < tree->height; d++)
+        (*depths)[d] = 0;
+      forest->height = tree->height;
+    }
+    for (int d = 0; d < tree->height; d++)
+      (*depths)[d] += treeDepths[d];
+    forest->nbNodes += tree->nbNodes;
+    forest->maxImbalance = (tree->maxImbalance > forest->maxImbalance) ? tree->maxImbalance : forest->maxImbalance;
+    forest->nbUnbalanced += tree->nbUnbalanced;
+    forest->rssKB += tree->rssKB;
+    forest->nbFds += tree->nbFds;
+    forest->maxFds = (tree->maxFds > forest->maxFds) ? tree->maxFds : forest->maxFds;
+}
+
+void orderTreeStats(Data *data)
+{
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    //statistiques agrégées par les workers de tous les ensembles, comme
+    //stats (rien pour un ensemble vide), puis par ceux des répliques
+    MwTreeStats workers = {0};
+    int *depths = NULL;
+    for (int i = 0; i < CM_MAX_SETS; i++){
+      SetRoot *root = &(data->sets[i]);
+      if (! root->hasChild)
+        continue;
+      writeOrderTo(root->fdMasterToWorker1, MW_ORDER_TREESTATS);
+
+      int receipt;
+      mio_read(root->fdWorker1ToMaster, &receipt, sizeof(int));
+      myassert(receipt == MW_ANSWER_TREESTATS, "accusé de reception inattendu");
+      MwTreeStats tree;
+      int *treeDepths = mw_readTreeStats(root->fdWorker1ToMaster, &tree);
+      addTree(&workers, &depths, &tree, treeDepths);
+      free(treeDepths);
+    }
+    //(le verrou attend la fin de l'échange en cours du thread de la réplique)
+    bool replicas = __atomic_load_n(&(data->replicasRunning), __ATOMIC_ACQUIRE);
+    for (int i = 0; replicas && (i < data->nbReplicas); i++){
+      ReplicaThread *rt = &(data->replicas[i]);
+      MwTreeStats tree;
+      pthread_mutex_lock(&(rt->lock));
+      int *treeDepths = rp_treeStats(&(rt->replica), &tree);
+      pthread_mutex_unlock(&(rt->lock));
+      addTree(&workers, &depths, &tree, treeDepths);
+      free(treeDepths);
+    }
+
+    //on y ajoute le master
+    long rss = ut_getRssKB();
+    int nbFds = ut_getNbOpenFds();
+    rss = (rss < 0) ? 0 : rss;
+    nbFds = (nbFds < 0) ? 0 : nbFds;
+
+    CmTreeStats tree;
+    tree.maxDepth = workers.height;
+    tree.nbWorkers = workers.nbNodes;
+    tree.nbProcesses = workers.nbNodes + 1;
+    tree.maxImbalance = workers.maxImbalance;
+    tree.nbUnbalanced = workers.nbUnbalanced;
+    tree.rssKB = workers.rssKB + rss;
+    tree.nbFds = workers.nbFds + nbFds;
+    tree.maxFds = (workers.maxFds > nbFds) ? workers.maxFds : nbFds;
+    tree.depths = depths;
+
+    int receiptSent = CM_ANSWER_TREESTATS_OK;
+    mio_write(data->fdMasterToClient, &receiptSent, sizeof(int));
+    mio_flush();
+    cm_writeTreeStats(data->fdMasterToClient, &tree);
+    free(depths);
+}
+
+//ajout de la durée d'un ordre à ses statistiques (chemin critique : O(1))
+static void recordOrder(Data *data, int order, uint64_t duration)
+{
+    CmOrderStats *st = &(data->stats[CM_STATS_SLOT(order)]);
+    hg_record(&(st->latency), duration);
+    if (data->miss)
+      st->misses++;
+}
+
+
+/************************************************************************
+ * boîte aux lettres (thread dédié)
+ ************************************************************************/
+//dépôt de la réponse d'une case et réveil de son client
+static void publishAnswer(CmSlot *slot, const CmAnswer *answer)
+{
+    slot->answer = *answer;
+    __atomic_store_n(&(slot->state), CM_SLOT_ANSWER, __ATOMIC_RELEASE);
+    cm_futexWake(&(slot->state), 1);
+}
+
+//traitement de l'ordre d'une case, puis réveil de son client
+static void serveSlot(Data *data, CmSlot *slot)
+{
+    int order = slot->order;
+    int set = slot->set;
+    elt_t elt = slot->elt;
+    CmAnswer answer;
+    memset(&answer, 0, sizeof(answer));
+
+    //instantané : une lecture n'attend pas l'ordre en cours d'un autre
+    //client (un long insertmany), elle lit la dernière version validée
+    //(ni trace ni statistiques des ordres : elles sont sous data->lock)
+    bool snapshotRead = data->snapshotOn && cm_isReadOrder(order) && (set == CM_SET_DEFAULT);
+    if (snapshotRead && (pthread_mutex_trylock(&(data->lock)) != 0)){
+      uint64_t start = ut_getTimeNs();
+      sn_answer(&(data->snapshot), order, elt, &answer);
+      hg_record(&(data->snapshotLatency), ut_getTimeNs() - start);
+      publishAnswer(slot, &answer);
+      return;
+    }
+    if (! snapshotRead)
+      pthread_mutex_lock(&(data->lock));
+    uint64_t orderStart = ut_getTimeNs();
+    data->miss = false;
+    data->lastTraceId++;
+    tr_traceId = data->lastTraceId;
+    tr_event(TR_ORDER, order, 0, 0);
+
+    //(compteurs de performance : ils ne suivent que le thread principal)
+    bool known = ! data->stopping && (set >= 0) && (set < CM_MAX_SETS);
+    if (known)
+    {
+        selectSet(data, set);
+        switch (order)
+        {
+          case CM_ORDER_HOW_MANY:
+            answerHowMany(data, &answer);
+            break;
+          case CM_ORDER_MINIMUM:
+            answerMinimum(data, &answer);
+            break;
+          case CM_ORDER_MAXIMUM:
+            answerMaximum(data, &answer);
+            break;
+          case CM_ORDER_EXIST:
+            answerExist(data, elt, &answer);
+            break;
+          case CM_ORDER_SUM:
+            answerSum(data, &answer);
+            break;
+          case CM_ORDER_INSERT:
+            answerInsert(data, elt, &answer);
+            break;
+          default:
+            known = false;
+            break;
+        }
+    }
+    if (! known)
+    {
+        data->unknownStats.errors++;
+        answer.code = CM_ANSWER_ERROR;
+    }
+    mio_flush();
+    uint64_t duration = ut_getTimeNs() - orderStart;
+    if (known)
+        recordOrder(data, order, duration);
+    tr_event(TR_ORDER_END, order, 0, duration);
+    data->nbMailboxOrders++;
+    pthread_mutex_unlock(&(data->lock));
+
+    publishAnswer(slot, &answer);
+}
+
+//prise en charge d'une case (plusieurs threads parcourent la boîte)
+static bool takeSlot(CmSlot *slot)
+{
+    uint32_t expected = CM_SLOT_REQUEST;
+    return __atomic_compare_exchange_n(&(slot->state), &expected, CM_SLOT_SERVING, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+//attente sur seq : un ordre déposé après la lecture de seq la modifie,
+//FUTEX_WAIT retourne alors immédiatement
+static void * mailboxLoop(void *arg)
+{
+    Data *data = (Data *) arg;
+    CmMailbox *mailbox = data->mailbox;
+
+    while (__atomic_load_n(&(mailbox->open), __ATOMIC_ACQUIRE))
+    {
+        uint32_t seq = __atomic_load_n(&(mailbox->seq), __ATOMIC_SEQ_CST);
+        bool served = false;
+        for (int i = 0; i < CM_MAILBOX_SLOTS; i++)
+        {
+            CmSlot *slot = &(mailbox->slots[i]);
+            if (__atomic_load_n(&(slot->state), __ATOMIC_ACQUIRE) != CM_SLOT_REQUEST)
+                continue;
+            //les lectures de l'ensemble par défaut sont laissées aux répliques
+            //tant qu'elles tournent
+            if (cm_isReadOrder(slot->order) && (slot->set == CM_SET_DEFAULT)
+                && __atomic_load_n(&(data->replicasRunning), __ATOMIC_ACQUIRE))
+                continue;
+            if (takeSlot(slot))
+            {
+                serveSlot(data, slot);
+                served = true;
+            }
+        }
+        if (! served)
+            cm_futexWait(&(mailbox->seq), seq, 0);
+    }
+    return NULL;
+}
+
+static void startMailbox(Data *data)
+{
+    int ret = pthread_create(&(data->mailboxThread), NULL, mailboxLoop, data);
+    myassert(ret == 0, "echec création thread boîte aux lettres");
+}
+
+//arrêt du thread ; les ordres déposés entre temps reçoivent une erreur
+static void closeMailbox(Data *data)
+{
+    CmMailbox *mailbox = data->mailbox;
+
+    __atomic_store_n(&(mailbox->open), 0, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&(mailbox->seq), 1, __ATOMIC_SEQ_CST);
+    cm_futexWake(&(mailbox->seq), 1);
+    int ret = pthread_join(data->mailboxThread, NULL);
+    myassert(ret == 0, "echec attente thread boîte aux lettres");
+
+    for (int i = 0; i < CM_MAILBOX_SLOTS; i++)
+    {
+        CmSlot *slot = &(mailbox->slots[i]);
+        if (__atomic_load_n(&(slot->state), __ATOMIC_ACQUIRE) == CM_SLOT_REQUEST)
+        {
+            slot->answer.code = CM_ANSWER_ERROR;
+            __atomic_store_n(&(slot->state), CM_SLOT_ANSWER, __ATOMIC_RELEASE);
+            cm_futexWake(&(slot->state), 1);
+        }
+    }
+    cm_mailboxDestroy(mailbox);
+    pthread_mutex_destroy(&(data->lock));
+}
+
+
+/************************************************************************
+ * répliques (un thread par réplique, cf. replica.h)
+ ************************************************************************/
+//rejoue le journal jusqu'au rang <to>, en un lot
+static void catchUp(ReplicaThread *rt, uint64_t to)
+{
+    if (rt->applied >= to)
+      return;
+    rp_journalCopy(&(rt->data->journal), rt->applied, to, &(rt->buf), &(rt->bufCapacity));
+    pthread_mutex_lock(&(rt->lock));
+    rp_insert(&(rt->replica), rt->buf, (int) (to - rt->applied));
+    pthread_mutex_unlock(&(rt->lock));
+    __atomic_store_n(&(rt->applied), to, __ATOMIC_RELEASE);
+    rt->nbBatches++;
+}
+
+//même attente que mailboxLoop ; le master incrémente aussi seq à chaque
+//ajout au journal
+static void * replicaLoop(void *arg)
+{
+    ReplicaThread *rt = (ReplicaThread *) arg;
+    Data *data = rt->data;
+    CmMailbox *mailbox = data->mailbox;
+
+    while (__atomic_load_n(&(data->replicasRunning), __ATOMIC_ACQUIRE))
+    {
+        uint32_t seq = __atomic_load_n(&(mailbox->seq), __ATOMIC_SEQ_CST);
+        bool worked = false;
+
+        //rattrapage asynchrone de l'arbre principal
+        uint64_t end = rp_journalLength(&(data->journal));
+        if (rt->applied < end)
+        {
+            catchUp(rt, end);
+            worked = true;
+        }
+
+        for (int i = 0; i < CM_MAILBOX_SLOTS; i++)
+        {
+            CmSlot *slot = &(mailbox->slots[i]);
+            if ((__atomic_load_n(&(slot->state), __ATOMIC_ACQUIRE) != CM_SLOT_REQUEST)
+                || ! cm_isReadOrder(slot->order) || (slot->set != CM_SET_DEFAULT) || ! takeSlot(slot))
+                continue;
+            //barrière : toute écriture acquittée avant la lecture est au journal
+            if (data->replicaBarrier)
+                catchUp(rt, rp_journalLength(&(data->journal)));
+            CmAnswer answer;
+            memset(&answer, 0, sizeof(answer));
+            pthread_mutex_lock(&(rt->lock));
+            rp_answer(&(rt->replica), slot->order, slot->elt, &answer);
+            pthread_mutex_unlock(&(rt->lock));
+            publishAnswer(slot, &answer);
+            rt->nbReads++;
+            worked = true;
+        }
+        if (! worked)
+            cm_futexWait(&(mailbox->seq), seq, 0);
+    }
+    return NULL;
+}
+
+static void startReplicas(Data *data)
+{
+    if (data->nbReplicas == 0)
+      return;
+    data->replicas = malloc(data->nbReplicas * sizeof(ReplicaThread));
+    myassert(data->replicas != NULL, "echec allocation des répliques");
+    __atomic_store_n(&(data->replicasRunning), true, __ATOMIC_RELEASE);
+    for (int i = 0; i < data->nbReplicas; i++){
+      ReplicaThread *rt = &(data->replicas[i]);
+      rt->data = data;
+      rp_init(&(rt->replica));
+      int ret = pthread_mutex_init(&(rt->lock), NULL);
+      myassert(ret == 0, "echec initialisation verrou réplique");
+      rt->applied = 0;
+      rt->buf = NULL;
+      rt->bufCapacity = 0;
+      rt->nbReads = 0;
+      rt->nbBatches = 0;
+      ret = pthread_create(&(rt->thread), NULL, replicaLoop, rt);
+      myassert(ret == 0, "echec création thread réplique");
+    }
+}
+
+//arrêt des threads puis des arbres des répliques ; les lectures suivantes
+//reviennent au thread de la boîte aux lettres
+static void stopReplicas(Data *data)
+{
+    if (! __atomic_load_n(&(data->replicasRunning), __ATOMIC_ACQUIRE))
+      return;
+    __atomic_store_n(&(data->replicasRunning), false, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&(data->mailbox->seq), 1, __ATOMIC_SEQ_CST);
+    cm_futexWake(&(data->mailbox->seq), INT_MAX);
+    for (int i = 0; i < data->nbReplicas; i++){
+      ReplicaThread *rt = &(data->replicas[i]);
+      int ret = pthread_join(rt->thread, NULL);
+      myassert(ret == 0, "echec attente thread réplique");
+      rp_stop(&(rt->replica));
+      pthread_mutex_destroy(&(rt->lock));
+      free(rt->buf);
     }
 }
 
@@ -543,23 +1403,45 @@ void loop(Data *data)
     bool end = false;
 
     init(data);
+    startMailbox(data);
+    startReplicas(data);
 
     while (! end)
     {
         // - ouverture des tubes nommés 
-        data->fdClientToMaster = open("pipe1", O_RDONLY);
+        data->fdClientToMaster = open(data->pipeClientToMaster, O_RDONLY);
         myassert(data->fdClientToMaster != -1, "echec ouverture pipe ClientToMaster");
         //printf("MASTER : ouverture lecture ClienToMaster ok !\n");
 
-        data->fdMasterToClient = open("pipe2", O_WRONLY);
+        data->fdMasterToClient = open(data->pipeMasterToClient, O_WRONLY);
         myassert(data->fdClientToMaster != -1, "echec ouverture pipe MasterToClient");
         //printf("MASTER : ouverture écriture MasterToClient ok !\n");
 
-        // - reception de l'ordre 
-        int orderReceived; 
-        int retr = read(data->fdClientToMaster, &orderReceived, sizeof(int));
-        myassert(retr != 0, "echec lecture order");
+        //les workers ne sont pas partagés avec le thread de la boîte aux lettres
+        pthread_mutex_lock(&(data->lock));
+
+        // - reception de l'ordre et de son ensemble
+        int header[2];
+        mio_read(data->fdClientToMaster, header, sizeof(header));
+        int orderReceived = header[0];
+        if ((header[1] >= 0) && (header[1] < CM_MAX_SETS))
+          selectSet(data, header[1]);
+        else{
+          //ensemble inconnu : paramètres lus (le client attend la réponse
+          //une fois tout envoyé), puis réponse d'erreur
+          skipParameters(data, orderReceived);
+          orderReceived = CM_ORDER_NONE;
+        }
         //printf("MASTER : lecture de l'ordre ok !\n");
+        uint64_t orderStart = ut_getTimeNs();
+        data->miss = false;
+        bool known = true;
+        data->lastTraceId++;
+        tr_traceId = data->lastTraceId;
+        tr_event(TR_ORDER, orderReceived, 0, 0);
+        PcSample perfBefore;
+        if (data->perfOn)
+          pc_read(&perfBefore);
 
         //printf("MASTER : J'ai recu l'ordre suivant : %d ! \n", orderReceived);
 
@@ -570,6 +1452,7 @@ void loop(Data *data)
         {
           case CM_ORDER_STOP:
             orderStop(data);
+            data->stopping = true;
             end = true;
             break;
           case CM_ORDER_HOW_MANY:
@@ -596,11 +1479,32 @@ void loop(Data *data)
           case CM_ORDER_PRINT:
             orderPrint(data);
             break;
+          case CM_ORDER_STATS:
+            orderStats(data);
+            break;
+          case CM_ORDER_TREESTATS:
+            orderTreeStats(data);
+            break;
           default:
-            myassert(false, "ordre inconnu");
-            exit(EXIT_FAILURE);
+            //paramètres éventuels inconnus : on répond une erreur sans les lire
+            known = false;
+            data->unknownStats.errors++;
+            int receiptSent = CM_ANSWER_ERROR;
+            mio_write(data->fdMasterToClient, &receiptSent, sizeof(int));
             break;
         }
+        //la réponse est partie avant la mesure de la durée
+        mio_flush();
+        if (data->perfOn && known){
+          PcSample perfAfter;
+          pc_read(&perfAfter);
+          pc_add(&(data->stats[CM_STATS_SLOT(orderReceived)].perf), &perfBefore, &perfAfter);
+        }
+        uint64_t duration = ut_getTimeNs() - orderStart;
+        if (known)
+          recordOrder(data, orderReceived, duration);
+        tr_event(TR_ORDER_END, orderReceived, 0, duration);
+        pthread_mutex_unlock(&(data->lock));
 
         //attend la fin de la lecture de l'accusé de reception par le client  
         struct sembuf operationMoins = {0, -1, 0};
@@ -618,7 +1522,16 @@ void loop(Data *data)
         int ret2 = close(data->fdMasterToClient);
         myassert(ret2 == 0, "echec fermeture pipe MasterToClient");
 
-        TRACE0("[master] fin ordre\n");
+        //le client suivant n'est admis qu'une fois nos extrémités fermées :
+        //sinon il peut ouvrir les tubes nommés sur nos anciens descripteurs
+        //et lire une fin de fichier à la place de sa réponse
+        struct sembuf operationPlus = {0, +1, 0};
+
+        int semId2 = semget(KEY2, 1, 0);
+        myassert(semId2 != -1, "echec ouverture sema 2");
+
+        int retsem2 = semop(semId2, &operationPlus, 1);
+        myassert(retsem2 != -1, "erreur 'vendre' sémaphore");
     }
 }
 
@@ -632,7 +1545,8 @@ int main(int argc, char * argv[])
     if (argc != 1)
         usage(argv[0], NULL);
 
-    TRACE0("[master] début\n");
+    tr_init("master", true);
+    tr_event(TR_START, CM_ORDER_NONE, 0, 0);
 
     Data data;
 
@@ -644,13 +1558,15 @@ int main(int argc, char * argv[])
     myassert(semId2 != -1, "echec creation sema 2");
     
     // - création des tubes nommés
-    int ret1 = mkfifo("pipe1", 0644);
+    cm_name(data.pipeClientToMaster, CM_PIPE_CLIENT_TO_MASTER, cm_namespace());
+    cm_name(data.pipeMasterToClient, CM_PIPE_MASTER_TO_CLIENT, cm_namespace());
+    int ret1 = mkfifo(data.pipeClientToMaster, 0644);
     myassert(ret1 == 0, "echec creation pipe MasterToClient");
     
-    int ret2 = mkfifo("pipe2", 0644);
+    int ret2 = mkfifo(data.pipeMasterToClient, 0644);
     myassert(ret2 == 0, "echec creation pipe ClientToMaster");
 
-    TRACE0("  [master] semaphores and pipes created !\n");
+    tr_event(TR_READY, CM_ORDER_NONE, 0, 0);
 
     // - initialisation des semaphores 
     int ret3 = semctl(semId1, 0, SETVAL, 0);
@@ -658,14 +1574,72 @@ int main(int argc, char * argv[])
 
     int ret4 = semctl(semId2, 0, SETVAL, 1);
     myassert(ret3 != -1, "initialisation sémaphore");
+
+    // - boîte aux lettres des ordres simples (mode MWC_HANDSHAKE=futex des clients)
+    data.mailbox = cm_mailboxCreate();
         
     loop(&data);
+    closeMailbox(&data);
+    closeRoutes(&data);
+
+    if (data.ioMode == MIO_URING){
+      uint64_t nbOps, nbCalls;
+      mio_getCounts(&nbOps, &nbCalls);
+      fprintf(stderr, "[master] io_uring : %llu lectures/écritures en %llu appels système\n",
+              (unsigned long long) nbOps, (unsigned long long) nbCalls);
+    }
+    mio_end();
+    if (data.routeMode == RT_DIRECT)
+      fprintf(stderr, "[master] routage direct : %llu ordres envoyés au worker concerné, "
+              "%llu exist répondus par la table%s\n", (unsigned long long) data.nbDirect,
+              (unsigned long long) data.nbAbsent, data.routesComplete ? "" : " (table incomplète)");
+    if (data.bloomOn){
+      fprintf(stderr, "[master] filtre de Bloom (%llu Ko, %d hachages) : %llu exist sur %llu répondus par le filtre, "
+              "%llu faux positifs\n", (unsigned long long) (bf_bytes(&(data.bloom)) / 1024), data.bloom.nbHashes,
+              (unsigned long long) data.exist.bloomNegatives, (unsigned long long) data.exist.bloomLookups,
+              (unsigned long long) data.exist.bloomFalsePositives);
+      bf_end(&(data.bloom));
+    }
+    if (data.cacheOn){
+      fprintf(stderr, "[master] cache (%d entrées) : %llu exist sur %llu répondus par le cache, %llu évictions\n",
+              data.cache.capacity, (unsigned long long) data.cache.hits,
+              (unsigned long long) data.cache.lookups, (unsigned long long) data.cache.evictions);
+      kc_end(&(data.cache));
+    }
+    if (data.snapshotOn){
+      const Histogram *h = &(data.snapshotLatency);
+      fprintf(stderr, "[master] instantané : %llu versions, %llu lectures répondues pendant un autre ordre "
+              "(p50 %.1f µs, p99 %.1f µs)\n", (unsigned long long) data.snapshot.epoch,
+              (unsigned long long) h->count, hg_percentile(h, 0.50) * 1e-3, hg_percentile(h, 0.99) * 1e-3);
+      sn_end(&(data.snapshot));
+    }
+    if (data.nbReplicas > 0){
+      for (int i = 0; i < data.nbReplicas; i++)
+        fprintf(stderr, "[master] réplique %d : %llu lectures, journal rejoué en %llu lots\n", i + 1,
+                (unsigned long long) data.replicas[i].nbReads, (unsigned long long) data.replicas[i].nbBatches);
+      free(data.replicas);
+      rp_journalEnd(&(data.journal));
+    }
+    free(data.staged);
+    if (data.nbMailboxOrders > 0)
+      fprintf(stderr, "[master] boîte aux lettres : %llu ordres\n", (unsigned long long) data.nbMailboxOrders);
+    if (data.bulkCopied + data.bulkSpliced > 0)
+      fprintf(stderr, "[master] insertmany (%s) : %llu octets recopiés, %llu octets transmis par splice\n",
+              cm_bulkName(data.bulkMode), (unsigned long long) data.bulkCopied,
+              (unsigned long long) data.bulkSpliced);
+
+    if (data.perfOn){
+      PcTotals perf[CM_NB_STATS_SLOTS];
+      for (int i = 0; i < CM_NB_STATS_SLOTS; i++)
+        perf[i] = data.stats[i].perf;
+      pc_dump("master", perf, CM_NB_STATS_SLOTS);
+    }
 
     //destruction des tubes nommés
-    ret1 = unlink("pipe1");
+    ret1 = unlink(data.pipeClientToMaster);
     myassert(ret1 == 0, "echec fermeture pipe MasterToClient");
 
-    ret2 = unlink("pipe2");
+    ret2 = unlink(data.pipeMasterToClient);
     myassert(ret2 == 0, "echec fermeture pipe ClientToMaster");
 
     //destruction des des sémaphores
@@ -675,8 +1649,6 @@ int main(int argc, char * argv[])
     ret4 = semctl(semId2, -1, IPC_RMID);
     myassert(ret4 != -1, "echec destruction sémaphore 2");
 
-    TRACE0("  [master] semaphores and pipes destroyed !\n");
-
-    TRACE0("[master] terminaison\n");
+    tr_event(TR_END, CM_ORDER_NONE, 0, 0);
     return EXIT_SUCCESS;
 }
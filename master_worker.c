@@ -2,13 +2,85 @@
 #include "config.h"
 #endif
 
-//TODO include selon ce qu'il y a dans le .h
+#include <stdlib.h>
+#include <unistd.h>
 
 #include "utils.h"
 #include "myassert.h"
 
 #include "master_worker.h"
+#include "trace.h"
 
 
-//TODO fonctions selon ce qu'il y a dans le .h
+/************************************************************************
+ * lecture/écriture complètes
+ ************************************************************************/
+void mw_writeAll(int fd, const void *buf, size_t size)
+{
+    const char *src = (const char *) buf;
+    while (size > 0)
+    {
+        ssize_t ret = write(fd, src, size);
+        myassert(ret > 0, "echec écriture tube");
+        src += ret;
+        size -= ret;
+    }
+}
+
+void mw_readAll(int fd, void *buf, size_t size)
+{
+    char *dest = (char *) buf;
+    while (size > 0)
+    {
+        ssize_t ret = read(fd, dest, size);
+        myassert(ret > 0, "echec lecture tube");
+        dest += ret;
+        size -= ret;
+    }
+}
+
+
+/************************************************************************
+ * ordres
+ ************************************************************************/
+int mw_writeOrder(int fd, int order)
+{
+    MwOrderHeader header = { order, tr_traceId };
+    return write(fd, &header, sizeof(header));
+}
+
+int mw_readOrder(int fd, int *order)
+{
+    MwOrderHeader header;
+    int ret = read(fd, &header, sizeof(header));
+    if (ret <= 0)
+        return ret;
+    //un tube transmet d'un bloc les écritures de moins de PIPE_BUF octets
+    myassert(ret == sizeof(header), "ordre incomplet");
+    *order = header.order;
+    tr_traceId = header.traceId;
+    return ret;
+}
+
+
+/************************************************************************
+ * statistiques d'un sous-arbre
+ ************************************************************************/
+void mw_writeTreeStats(int fd, const MwTreeStats *stats, const int *depths)
+{
+    mw_writeAll(fd, stats, sizeof(MwTreeStats));
+    mw_writeAll(fd, depths, stats->height * sizeof(int));
+}
+
+int * mw_readTreeStats(int fd, MwTreeStats *stats)
+{
+    mw_readAll(fd, stats, sizeof(MwTreeStats));
+    myassert(stats->height >= 0, "hauteur incorrecte");
+    if (stats->height == 0)
+        return NULL;
+    int *depths = malloc(stats->height * sizeof(int));
+    myassert(depths != NULL, "echec allocation des profondeurs");
+    mw_readAll(fd, depths, stats->height * sizeof(int));
+    return depths;
+}
 
@@ -1,6 +1,7 @@
 #ifndef MASTER_WORKER_H
 #define MASTER_WORKER_H
 
+#include <stdint.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -13,6 +14,11 @@
 #define MW_ORDER_SUM            50
 #define MW_ORDER_INSERT         60
 #define MW_ORDER_PRINT          70
+#define MW_ORDER_TREESTATS      80
+#define MW_ORDER_INSERT_MANY    90
+
+// une case par type d'ordre (ordre / 10), pour les mesures par type
+#define MW_NB_ORDER_SLOTS       (MW_ORDER_INSERT_MANY / 10 + 1)
 
 // réponses possibles d'un worker pour le master, ou d'un worker pour son père
 // pas de MW_ANSWER_STOP : le master attend la fin du premier worker, ou un worker attend la fin de ses fils
@@ -24,15 +30,54 @@
 #define MW_ANSWER_SUM           50
 #define MW_ANSWER_INSERT        60
 #define MW_ANSWER_PRINT         70
+#define MW_ANSWER_TREESTATS     80
+#define MW_ANSWER_INSERT_MANY   90
+
+// Insertion d'un tableau (MW_ORDER_INSERT_MANY) : l'ordre est suivi d'un
+// int nb puis de nb éléments. Le worker garde ses exemplaires, transmet à
+// chacun de ses fils, en un seul ordre, le sous-tableau qui le concerne
+// (dans l'ordre d'arrivée : l'arbre obtenu est le même qu'avec des
+// insertions successives) et répond à son père (pas au master) une fois
+// tout son sous-arbre à jour.
+// Un fils créé pendant cette insertion reçoit un 5e argument, <fdAck> : le
+// canal de son accusé de réception de création (ici celui vers son père).
+
+
+// Chaque ordre est précédé de l'identifiant de trace de la requête du client
+// qui l'a provoqué (attribué par le master, cf. trace.h) : les événements
+// de tous les processus traversés par une requête portent le même
+// identifiant. Les deux champs partent en une seule écriture.
+typedef struct {
+    int order;
+    uint32_t traceId;
+} MwOrderHeader;
+
+// lecture/écriture complètes de <size> octets (un tube ne contient que 64Ko)
+void mw_readAll(int fd, void *buf, size_t size);
+void mw_writeAll(int fd, const void *buf, size_t size);
+
+// envoi d'un ordre avec l'identifiant de trace courant (même retour que write)
+int mw_writeOrder(int fd, int order);
+// réception d'un ordre ; l'identifiant reçu devient l'identifiant courant
+// (retourne 0 en fin de fichier, -1 en cas d'erreur)
+int mw_readOrder(int fd, int *order);
 
+// statistiques d'un sous-arbre de workers (MW_ORDER_TREESTATS), agrégées
+// de père en fils comme pour MW_ORDER_HOW_MANY
+typedef struct {
+    int height;         // hauteur du sous-arbre (1 pour une feuille)
+    int nbNodes;        // nombre de workers
+    int maxImbalance;   // plus grand écart de hauteur entre fils gauche et droit
+    int nbUnbalanced;   // nombre de workers dont cet écart dépasse 1
+    long rssKB;         // mémoire résidente totale (Ko)
+    int nbFds;          // descripteurs ouverts au total
+    int maxFds;         // descripteurs ouverts au plus par worker
+} MwTreeStats;
 
-//TODO
-// Vous pouvez mettre ici des informations/fonctions soit communes au master et au
-// worker, soit liées aux deux :
-// . structures de données
-// . libération/initialisation de ressources (sémaphores, tubes, ...)
-// . communications
-// . lancement d'un worker
-//END TODO
+// envoi des statistiques suivies de <height> entiers : nombre de workers à
+// chaque profondeur (0 = racine du sous-arbre)
+void mw_writeTreeStats(int fd, const MwTreeStats *stats, const int *depths);
+// réception ; retourne le tableau des profondeurs (alloué, NULL si height vaut 0)
+int * mw_readTreeStats(int fd, MwTreeStats *stats);
 
 #endif
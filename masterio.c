@@ -0,0 +1,377 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// syscall(), MAP_POPULATE
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#include "myassert.h"
+
+#include "masterio.h"
+
+// taille de l'anneau (opérations d'un lot)
+#define MIO_ENTRIES     64
+// zone de tampons enregistrée : messages en file d'un lot
+#define MIO_ARENA_SIZE  (64 * 1024)
+
+// une opération du lot en cours
+typedef struct {
+    bool isRead;
+    int fd;
+    char *buf;              // adresse donnée au noyau (zone ou tampon de l'appelant)
+    char *dest;             // lecture dans la zone : destination finale (sinon NULL)
+    size_t size;
+    int res;                // résultat de la complétion
+} MioOp;
+
+static int mode = MIO_BLOCKING;
+static uint64_t nbOps = 0;
+static uint64_t nbCalls = 0;
+
+// anneau io_uring
+static int ringFd = -1;
+static void *sqRing = NULL;
+static void *cqRing = NULL;
+static size_t sqRingSize, cqRingSize;
+static unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+static unsigned *cqHead, *cqTail, *cqMask;
+static struct io_uring_sqe *sqes = NULL;
+static size_t sqesSize;
+static struct io_uring_cqe *cqes;
+
+// lot en cours
+static MioOp batch[MIO_ENTRIES];
+static int nbPending = 0;
+static char *arena = NULL;
+static size_t arenaUsed = 0;
+static bool fixedBuffers = false;
+
+
+/************************************************************************
+ * lecture/écriture complètes bloquantes
+ ************************************************************************/
+static void writeAll(int fd, const char *src, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t ret = write(fd, src, size);
+        myassert(ret > 0, "echec écriture tube");
+        nbCalls++;
+        src += ret;
+        size -= ret;
+    }
+}
+
+static void readAll(int fd, char *dest, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t ret = read(fd, dest, size);
+        myassert(ret > 0, "echec lecture tube");
+        nbCalls++;
+        dest += ret;
+        size -= ret;
+    }
+}
+
+
+/************************************************************************
+ * création de l'anneau
+ ************************************************************************/
+static bool uringSetup(void)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ringFd = syscall(SYS_io_uring_setup, MIO_ENTRIES, &params);
+    if (ringFd == -1)
+        return false;
+    fcntl(ringFd, F_SETFD, FD_CLOEXEC);
+
+    //RW_CUR_POS : offset -1 pour les tubes ; anneaux partagés en une projection si possible
+    if (! (params.features & IORING_FEAT_RW_CUR_POS))
+    {
+        close(ringFd);
+        ringFd = -1;
+        return false;
+    }
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single)
+        sqRingSize = cqRingSize = (sqRingSize > cqRingSize) ? sqRingSize : cqRingSize;
+
+    sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                  IORING_OFF_SQ_RING);
+    myassert(sqRing != MAP_FAILED, "echec projection de l'anneau de soumission");
+    if (single)
+        cqRing = sqRing;
+    else
+    {
+        cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                      IORING_OFF_CQ_RING);
+        myassert(cqRing != MAP_FAILED, "echec projection de l'anneau de complétion");
+    }
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                IORING_OFF_SQES);
+    myassert(sqes != MAP_FAILED, "echec projection des soumissions");
+
+    char *sq = sqRing;
+    char *cq = cqRing;
+    sqHead = (unsigned *) (sq + params.sq_off.head);
+    sqTail = (unsigned *) (sq + params.sq_off.tail);
+    sqMask = (unsigned *) (sq + params.sq_off.ring_mask);
+    sqArray = (unsigned *) (sq + params.sq_off.array);
+    cqHead = (unsigned *) (cq + params.cq_off.head);
+    cqTail = (unsigned *) (cq + params.cq_off.tail);
+    cqMask = (unsigned *) (cq + params.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+
+    //zone de tampons : enregistrée si la limite de mémoire verrouillée le permet
+    arena = mmap(NULL, MIO_ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    myassert(arena != MAP_FAILED, "echec allocation des tampons");
+    struct iovec iov = { arena, MIO_ARENA_SIZE };
+    fixedBuffers = (syscall(SYS_io_uring_register, ringFd, IORING_REGISTER_BUFFERS, &iov, 1) == 0);
+    return true;
+}
+
+int mio_init(void)
+{
+    mode = MIO_BLOCKING;
+    nbOps = nbCalls = 0;
+    const char *env = getenv(MIO_ENV_MODE);
+    if ((env == NULL) || (strcmp(env, mio_name(MIO_URING)) != 0))
+        return mode;
+    if (uringSetup())
+        mode = MIO_URING;
+    else
+        fprintf(stderr, "[master] io_uring indisponible, entrées/sorties bloquantes\n");
+    return mode;
+}
+
+void mio_end(void)
+{
+    if (mode != MIO_URING)
+        return;
+    mio_flush();
+    munmap(sqes, sqesSize);
+    if (cqRing != sqRing)
+        munmap(cqRing, cqRingSize);
+    munmap(sqRing, sqRingSize);
+    munmap(arena, MIO_ARENA_SIZE);
+    close(ringFd);
+    ringFd = -1;
+    mode = MIO_BLOCKING;
+}
+
+const char * mio_name(int m)
+{
+    return (m == MIO_URING) ? "uring" : "blocking";
+}
+
+void mio_getCounts(uint64_t *ops, uint64_t *calls)
+{
+    *ops = nbOps;
+    *calls = nbCalls;
+}
+
+
+/************************************************************************
+ * lots d'opérations
+ ************************************************************************/
+// soumission de tout le lot (chaîné) et attente de toutes les complétions
+static void submitAndWait(void)
+{
+    if (nbPending == 0)
+        return;
+
+    unsigned tail = *sqTail;
+    for (int i = 0; i < nbPending; i++)
+    {
+        MioOp *op = &(batch[i]);
+        unsigned index = tail & *sqMask;
+        struct io_uring_sqe *sqe = &(sqes[index]);
+        memset(sqe, 0, sizeof(*sqe));
+        bool inArena = (op->buf >= arena) && (op->buf < arena + MIO_ARENA_SIZE);
+        if (inArena && fixedBuffers)
+            sqe->opcode = op->isRead ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+        else
+            sqe->opcode = op->isRead ? IORING_OP_READ : IORING_OP_WRITE;
+        sqe->fd = op->fd;
+        sqe->off = (uint64_t) -1;
+        sqe->addr = (uint64_t) (uintptr_t) op->buf;
+        sqe->len = op->size;
+        sqe->buf_index = 0;
+        sqe->user_data = i;
+        if (i < nbPending - 1)
+            sqe->flags = IOSQE_IO_LINK;
+        sqArray[index] = index;
+        tail++;
+    }
+    __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+    int submitted = 0;
+    int completed = 0;
+    while (completed < nbPending)
+    {
+        int ret = syscall(SYS_io_uring_enter, ringFd, nbPending - submitted, nbPending - completed,
+                          IORING_ENTER_GETEVENTS, NULL, 0);
+        nbCalls++;
+        myassert((ret >= 0) || (errno == EINTR), "echec io_uring_enter");
+        if (ret > 0)
+            submitted += ret;
+
+        unsigned head = *cqHead;
+        while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+        {
+            struct io_uring_cqe *cqe = &(cqes[head & *cqMask]);
+            myassert(cqe->user_data < (uint64_t) nbPending, "complétion inattendue");
+            batch[cqe->user_data].res = cqe->res;
+            completed++;
+            head++;
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+    myassert(*sqHead == tail, "soumissions non consommées");
+
+    //dans l'ordre du lot : fin des opérations courtes ou annulées par la rupture de la chaîne
+    for (int i = 0; i < nbPending; i++)
+    {
+        MioOp *op = &(batch[i]);
+        int res = op->res;
+        myassert((res >= 0) || (res == -ECANCELED) || (res == -EINTR) || (res == -EAGAIN),
+                 op->isRead ? "echec lecture tube" : "echec écriture tube");
+        myassert(! (op->isRead && (res == 0)), "echec lecture tube");
+        size_t done = (res > 0) ? (size_t) res : 0;
+        if (op->isRead)
+        {
+            readAll(op->fd, op->buf + done, op->size - done);
+            if (op->dest != NULL)
+                memcpy(op->dest, op->buf, op->size);
+        }
+        else
+            writeAll(op->fd, op->buf + done, op->size - done);
+    }
+    nbOps += nbPending;
+    nbPending = 0;
+    arenaUsed = 0;
+}
+
+// ajout d'une opération ; <dest> : copie de la zone vers l'appelant (lectures)
+static void queue(bool isRead, int fd, char *buf, char *dest, size_t size)
+{
+    MioOp *op = &(batch[nbPending++]);
+    op->isRead = isRead;
+    op->fd = fd;
+    op->buf = buf;
+    op->dest = dest;
+    op->size = size;
+    op->res = 0;
+}
+
+// place dans la zone (NULL si le message ne tient pas dans le lot)
+// alignement sur 8 octets
+static size_t arenaAligned(size_t size)
+{
+    return (size + 7) & ~((size_t) 7);
+}
+
+static char * arenaAlloc(size_t size)
+{
+    size_t aligned = arenaAligned(size);
+    if ((nbPending == MIO_ENTRIES) || (arenaUsed + aligned > MIO_ARENA_SIZE))
+        submitAndWait();
+    if (aligned > MIO_ARENA_SIZE)
+        return NULL;
+    char *buf = arena + arenaUsed;
+    arenaUsed += aligned;
+    return buf;
+}
+
+
+/************************************************************************
+ * lectures, écritures
+ ************************************************************************/
+void mio_write(int fd, const void *buf, size_t size)
+{
+    if (mode != MIO_URING)
+    {
+        writeAll(fd, buf, size);
+        nbOps++;
+        return;
+    }
+    char *copy = arenaAlloc(size);
+    if (copy != NULL)
+    {
+        memcpy(copy, buf, size);
+        queue(false, fd, copy, NULL, size);
+        return;
+    }
+    //trop grand pour la zone : envoyé tout de suite depuis le tampon de l'appelant
+    queue(false, fd, (char *) buf, NULL, size);
+    submitAndWait();
+}
+
+void mio_read(int fd, void *buf, size_t size)
+{
+    if (mode != MIO_URING)
+    {
+        readAll(fd, buf, size);
+        nbOps++;
+        return;
+    }
+    char *place = arenaAlloc(size);
+    if (place != NULL)
+        queue(true, fd, place, buf, size);
+    else
+        queue(true, fd, buf, NULL, size);
+    submitAndWait();
+}
+
+void mio_readLinked(int fd, void *header, size_t headerSize, void *payload, size_t payloadSize)
+{
+    if (mode != MIO_URING)
+    {
+        readAll(fd, header, headerSize);
+        readAll(fd, payload, payloadSize);
+        nbOps += 2;
+        return;
+    }
+    //les deux lectures doivent partir dans le même lot : place réservée
+    //pour les deux avant d'en ajouter une (arenaAlloc ne doit pas envoyer
+    //le lot entre les deux)
+    size_t needed = arenaAligned(headerSize) + arenaAligned(payloadSize);
+    bool inArena = (needed <= MIO_ARENA_SIZE);
+    if ((nbPending >= MIO_ENTRIES - 1) || (inArena && (arenaUsed + needed > MIO_ARENA_SIZE)))
+        submitAndWait();
+    if (inArena)
+    {
+        queue(true, fd, arenaAlloc(headerSize), header, headerSize);
+        queue(true, fd, arenaAlloc(payloadSize), payload, payloadSize);
+    }
+    else
+    {
+        //trop grand pour la zone : lu directement chez l'appelant
+        queue(true, fd, header, NULL, headerSize);
+        queue(true, fd, payload, NULL, payloadSize);
+    }
+    submitAndWait();
+}
+
+void mio_flush(void)
+{
+    if (mode == MIO_URING)
+        submitAndWait();
+}
@@ -0,0 +1,58 @@
+#ifndef MASTERIO_H
+#define MASTERIO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/******************************************
+ * entrées/sorties du master (tubes nommés et tubes des workers)
+ ******************************************/
+// Deux implémentations derrière les mêmes fonctions, choisies au démarrage
+// par la variable d'environnement MWC_IO :
+//    blocking  (défaut) un read/write bloquant par champ, comme avant
+//    uring     io_uring (appels système directs, sans liburing) :
+//              - les écritures sont mises en file et partent avec la
+//                lecture suivante (ou mio_flush) en un seul io_uring_enter ;
+//              - les opérations d'un même lot sont chaînées (IOSQE_IO_LINK),
+//                donc exécutées dans l'ordre où elles ont été demandées ;
+//              - les petits messages passent par une zone de tampons
+//                enregistrée (READ_FIXED/WRITE_FIXED) ;
+//              - mio_readLinked lit un en-tête et la suite qu'il annonce
+//                avec deux lectures liées, soumises ensemble.
+//              Une opération courte (tube partiellement rempli) rompt la
+//              chaîne : la fin du lot est alors terminée en mode bloquant.
+// Si io_uring n'est pas disponible (noyau, seccomp,
+// kernel.io_uring_disabled), le mode bloquant est utilisé.
+//
+// Les écritures en file ne sont garanties parties qu'après une lecture,
+// mio_flush ou mio_end : il faut appeler mio_flush avant toute attente
+// hors de ce module (sémaphores, wait, fermeture d'un tube, écriture
+// directe sur un descripteur, fork).
+
+#define MIO_ENV_MODE    "MWC_IO"
+
+#define MIO_BLOCKING    0
+#define MIO_URING       1
+
+// choix de l'implémentation ; retourne celle effectivement utilisée
+int mio_init(void);
+// fin : envoi des écritures en attente et libération de l'anneau
+void mio_end(void);
+
+const char * mio_name(int mode);
+
+// écriture complète de <size> octets (éventuellement différée, <buf> est
+// copié et peut être réutilisé dès le retour)
+void mio_write(int fd, const void *buf, size_t size);
+// lecture complète de <size> octets, après les écritures en attente
+void mio_read(int fd, void *buf, size_t size);
+// lecture complète d'un en-tête puis de sa suite sur le même descripteur
+void mio_readLinked(int fd, void *header, size_t headerSize, void *payload, size_t payloadSize);
+// envoi des écritures en attente
+void mio_flush(void);
+
+// opérations effectuées et appels système correspondants depuis mio_init
+void mio_getCounts(uint64_t *nbOps, uint64_t *nbCalls);
+
+#endif
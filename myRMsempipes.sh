@@ -4,3 +4,7 @@ unlink pipe1
 unlink pipe2
 ipcrm -S 17989646
 ipcrm -S 34766862
+unlink mailbox
+# espaces de noms des masters côte à côte (MWC_SHARD) ; leurs sémaphores
+# sont détruits par rmsempipe.sh
+rm -f pipe1.* pipe2.* mailbox.*
@@ -0,0 +1,165 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// syscall()
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "myassert.h"
+
+#include "perfcount.h"
+#include "trace.h"
+
+static const struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} counters[PC_NB_COUNTERS] = {
+    [PC_CYCLES]       = { "cycles",       PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    [PC_INSTRUCTIONS] = { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    [PC_CACHE_MISSES] = { "cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    [PC_CTX_SWITCHES] = { "ctx_switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+    [PC_TASK_CLOCK]   = { "task_clock",   PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+};
+
+// groupe ouvert : le premier compteur ouvert est le meneur, une lecture de
+// celui-ci renvoie { nombre, valeur 0, valeur 1, ... } dans l'ordre d'ouverture
+static int leaderFd = -1;
+static int nbOpen = 0;
+static int opened[PC_NB_COUNTERS];     // compteur de chaque valeur lue
+static uint32_t openMask = 0;
+
+
+/************************************************************************
+ * ouverture
+ ************************************************************************/
+// noyau compris si c'est permis (les ordres passent surtout leur temps dans
+// les appels système des tubes), sinon espace utilisateur seulement
+static int openCounter(int counter, int groupFd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counters[counter].type;
+    attr.config = counters[counter].config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_hv = 1;
+    //processus courant, sur n'importe quel processeur
+    int fd = syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC);
+    if ((fd == -1) && ((errno == EACCES) || (errno == EPERM)))
+    {
+        attr.exclude_kernel = 1;
+        fd = syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC);
+    }
+    return fd;
+}
+
+bool pc_init(void)
+{
+    const char *mode = getenv(PC_ENV_MODE);
+    if ((mode == NULL) || (strcmp(mode, "on") != 0))
+        return false;
+
+    for (int k = 0; k < PC_NB_COUNTERS; k++)
+    {
+        int fd = openCounter(k, leaderFd);
+        if (fd == -1)
+            continue;
+        if (leaderFd == -1)
+            leaderFd = fd;
+        opened[nbOpen++] = k;
+        openMask |= 1u << k;
+    }
+    return nbOpen > 0;
+}
+
+
+
+/************************************************************************
+ * lectures
+ ************************************************************************/
+void pc_read(PcSample *sample)
+{
+    uint64_t buf[1 + PC_NB_COUNTERS];
+    ssize_t ret = read(leaderFd, buf, (1 + nbOpen) * sizeof(uint64_t));
+    myassert(ret == (ssize_t) ((1 + nbOpen) * sizeof(uint64_t)), "echec lecture compteurs");
+    for (int i = 0; i < nbOpen; i++)
+        sample->values[opened[i]] = buf[1 + i];
+}
+
+void pc_add(PcTotals *totals, const PcSample *before, const PcSample *after)
+{
+    totals->nbSamples++;
+    totals->mask = openMask;
+    for (int i = 0; i < nbOpen; i++)
+    {
+        int k = opened[i];
+        totals->values[k] += after->values[k] - before->values[k];
+    }
+}
+
+
+/************************************************************************
+ * fichier de sortie
+ ************************************************************************/
+void pc_dumpHeader(void)
+{
+    const char *path = getenv(PC_ENV_DUMP);
+    if (path == NULL)
+        return;
+    FILE *f = fopen(path, "w");
+    if (f == NULL)
+        return;
+    fprintf(f, "role,pid,order,name,samples");
+    for (int k = 0; k < PC_NB_COUNTERS; k++)
+        fprintf(f, ",%s", counters[k].name);
+    fprintf(f, "\n");
+    fclose(f);
+}
+
+void pc_dump(const char *role, const PcTotals totals[], int nb)
+{
+    const char *path = getenv(PC_ENV_DUMP);
+    if (path == NULL)
+        return;
+
+    //une seule écriture en ajout : les lignes des processus ne se mélangent pas
+    char buf[4096];
+    int len = 0;
+    for (int i = 0; i < nb; i++)
+    {
+        const PcTotals *t = &(totals[i]);
+        if (t->nbSamples == 0)
+            continue;
+        len += snprintf(buf + len, sizeof(buf) - len, "%s,%d,%d,%s,%llu", role, (int) getpid(), i * 10,
+                        tr_orderName(role, i * 10), (unsigned long long) t->nbSamples);
+        for (int k = 0; k < PC_NB_COUNTERS; k++)
+        {
+            if (t->mask & (1u << k))
+                len += snprintf(buf + len, sizeof(buf) - len, ",%llu", (unsigned long long) t->values[k]);
+            else
+                len += snprintf(buf + len, sizeof(buf) - len, ",");
+        }
+        len += snprintf(buf + len, sizeof(buf) - len, "\n");
+        myassert(len < (int) sizeof(buf), "sortie des compteurs trop longue");
+    }
+    if (len == 0)
+        return;
+
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd == -1)
+        return;
+    ssize_t ret = write(fd, buf, len);
+    myassert(ret == len, "echec écriture des compteurs");
+    close(fd);
+}
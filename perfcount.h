@@ -0,0 +1,59 @@
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/******************************************
+ * compteurs de performance (perf_event_open)
+ ******************************************/
+// Mode optionnel (variable d'environnement MWC_PERF=on, héritée par les
+// workers) : le master et chaque worker ouvrent un groupe de compteurs
+// sur eux-mêmes (noyau compris si c'est permis, sinon espace utilisateur
+// seulement, ce qui suffit avec perf_event_paranoid <= 2) et les lisent,
+// en un seul appel système, avant et après le traitement de chaque ordre.
+// Chaque compteur qui ne peut pas être ouvert (pas de PMU dans une machine
+// virtuelle, droits insuffisants, ...) est simplement ignoré : son bit est
+// absent de PcTotals.mask. Sans aucun compteur, le mode est désactivé.
+//
+// Les totaux par type d'ordre du master sont transmis avec ./client stats.
+// Avec MWC_PERF_DUMP=<fichier>, le master (qui vide le fichier au début)
+// et chaque worker (à sa terminaison) y ajoutent leurs totaux en CSV.
+
+#define PC_ENV_MODE     "MWC_PERF"
+#define PC_ENV_DUMP     "MWC_PERF_DUMP"
+
+#define PC_CYCLES           0
+#define PC_INSTRUCTIONS     1
+#define PC_CACHE_MISSES     2
+#define PC_CTX_SWITCHES     3
+#define PC_TASK_CLOCK       4       // temps processeur en ns (logiciel, toujours présent)
+#define PC_NB_COUNTERS      5
+
+typedef struct {
+    uint64_t values[PC_NB_COUNTERS];
+} PcSample;
+
+// totaux d'un type d'ordre
+typedef struct {
+    uint64_t nbSamples;
+    uint32_t mask;                  // bit k : compteur k disponible
+    uint64_t values[PC_NB_COUNTERS];
+} PcTotals;
+
+// ouverture des compteurs si le mode est demandé ; false si le mode n'est
+// pas demandé ou si aucun compteur n'est disponible
+bool pc_init(void);
+
+// lecture de tous les compteurs
+void pc_read(PcSample *sample);
+
+// ajout de la différence entre deux lectures
+void pc_add(PcTotals *totals, const PcSample *before, const PcSample *after);
+
+// fichier de sortie (MWC_PERF_DUMP) : création avec l'en-tête (master),
+// puis ajout des totaux non vides de <nb> types d'ordres (ordre i*10)
+void pc_dumpHeader(void);
+void pc_dump(const char *role, const PcTotals totals[], int nb);
+
+#endif
@@ -0,0 +1,274 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// pipe2
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include "myassert.h"
+
+#include "master_worker.h"
+#include "replica.h"
+
+
+/************************************************************************
+ * paramètres
+ ************************************************************************/
+bool rp_parse(const char *spec, int *nb, bool *barrier)
+{
+    if ((spec == NULL) || (spec[0] == '\0'))
+        return false;
+    char *end;
+    long n = strtol(spec, &end, 10);
+    *barrier = false;
+    if (strcmp(end, ":ryw") == 0)
+        *barrier = true;
+    else if (*end != '\0')
+        return false;
+    if ((n < 1) || (n > RP_MAX))
+        return false;
+    *nb = (int) n;
+    return true;
+}
+
+
+/************************************************************************
+ * arbre d'une réplique
+ ************************************************************************/
+void rp_init(Replica *replica)
+{
+    replica->hasChild = false;
+    replica->pid = -1;
+    replica->fdToRoot = -1;
+    replica->fdRootToMaster = -1;
+    replica->fdAnyToMaster = -1;
+}
+
+//création de la racine avec <elt> (mêmes arguments que le premier worker,
+//sans inscriptions) ; les tubes sont créés O_CLOEXEC : les workers créés
+//en même temps par les autres threads du master n'en héritent pas
+static void spawnRoot(Replica *replica, elt_t elt)
+{
+    int fdsIn[2], fdsOut[2], fdsAny[2];
+    int ret = pipe2(fdsIn, O_CLOEXEC);
+    myassert(ret == 0, "echec création tube réplique");
+    ret = pipe2(fdsOut, O_CLOEXEC);
+    myassert(ret == 0, "echec création tube réplique");
+    ret = pipe2(fdsAny, O_CLOEXEC);
+    myassert(ret == 0, "echec création tube réplique");
+
+    //(chaînes préparées avant le fork : le master a plusieurs threads)
+    char eltString[50], fdInString[50], fdOutString[50], fdToMasterString[50];
+    sprintf(eltString, ELT_ARG_FMT, elt);
+    sprintf(fdInString, "%d", fdsIn[0]);
+    sprintf(fdOutString, "%d", fdsOut[1]);
+    sprintf(fdToMasterString, "%d", fdsAny[1]);
+
+    pid_t pid = fork();
+    myassert(pid != -1, "echec fork réplique");
+    if (pid == 0)
+    {
+        //seules les extrémités de la racine survivent à exec
+        fcntl(fdsIn[0], F_SETFD, 0);
+        fcntl(fdsOut[1], F_SETFD, 0);
+        fcntl(fdsAny[1], F_SETFD, 0);
+        execl("worker", "./worker", eltString, fdInString, fdOutString, fdToMasterString, fdToMasterString,
+              "-1", NULL);
+        myassert(false, "echec exec worker réplique");
+    }
+
+    close(fdsIn[0]);
+    close(fdsOut[1]);
+    close(fdsAny[1]);
+    replica->pid = pid;
+    replica->fdToRoot = fdsIn[1];
+    replica->fdRootToMaster = fdsOut[0];
+    replica->fdAnyToMaster = fdsAny[0];
+    replica->hasChild = true;
+}
+
+static void writeOrder(Replica *replica, int order)
+{
+    int ret = mw_writeOrder(replica->fdToRoot, order);
+    myassert(ret == (int) sizeof(MwOrderHeader), "echec envoi ordre réplique");
+}
+
+void rp_insert(Replica *replica, const elt_t *elts, int nb)
+{
+    int first = 0;
+    if (! replica->hasChild && (nb > 0))
+    {
+        spawnRoot(replica, elts[0]);
+        int ack;
+        mw_readAll(replica->fdAnyToMaster, &ack, sizeof(int));
+        myassert(ack == MW_ANSWER_INSERT, "accusé de reception inattendu");
+        first = 1;
+    }
+    int rest = nb - first;
+    if (rest == 0)
+        return;
+
+    writeOrder(replica, MW_ORDER_INSERT_MANY);
+    mw_writeAll(replica->fdToRoot, &rest, sizeof(int));
+    mw_writeAll(replica->fdToRoot, elts + first, rest * sizeof(elt_t));
+    int ack;
+    mw_readAll(replica->fdRootToMaster, &ack, sizeof(int));
+    myassert(ack == MW_ANSWER_INSERT_MANY, "accusé de reception inattendu");
+}
+
+void rp_answer(Replica *replica, int order, elt_t elt, CmAnswer *answer)
+{
+    switch (order)
+    {
+      case CM_ORDER_HOW_MANY:
+        answer->code = CM_ANSWER_HOW_MANY_OK;
+        answer->nbTotal = 0;
+        answer->nbDistinct = 0;
+        if (replica->hasChild)
+        {
+            writeOrder(replica, MW_ORDER_HOW_MANY);
+            mw_readAll(replica->fdRootToMaster, &(answer->code), sizeof(int));
+            mw_readAll(replica->fdRootToMaster, &(answer->nbTotal), sizeof(int));
+            mw_readAll(replica->fdRootToMaster, &(answer->nbDistinct), sizeof(int));
+        }
+        break;
+      case CM_ORDER_MINIMUM:
+      case CM_ORDER_MAXIMUM:
+        answer->code = (order == CM_ORDER_MINIMUM) ? CM_ANSWER_MINIMUM_EMPTY : CM_ANSWER_MAXIMUM_EMPTY;
+        if (replica->hasChild)
+        {
+            writeOrder(replica, (order == CM_ORDER_MINIMUM) ? MW_ORDER_MINIMUM : MW_ORDER_MAXIMUM);
+            mw_readAll(replica->fdAnyToMaster, &(answer->code), sizeof(int));
+            mw_readAll(replica->fdAnyToMaster, &(answer->elt), sizeof(elt_t));
+        }
+        break;
+      case CM_ORDER_EXIST:
+        answer->code = CM_ANSWER_EXIST_NO;
+        if (replica->hasChild)
+        {
+            writeOrder(replica, MW_ORDER_EXIST);
+            mw_writeAll(replica->fdToRoot, &elt, sizeof(elt_t));
+            int code;
+            mw_readAll(replica->fdAnyToMaster, &code, sizeof(int));
+            //(conversion des réponses du worker, cf. master.c)
+            if (code == MW_ANSWER_EXIST_YES)
+            {
+                mw_readAll(replica->fdAnyToMaster, &(answer->quantity), sizeof(int));
+                answer->code = CM_ANSWER_EXIST_YES;
+            }
+        }
+        break;
+      case CM_ORDER_SUM:
+        answer->code = CM_ANSWER_SUM_OK;
+        answer->sum = 0;
+        if (replica->hasChild)
+        {
+            writeOrder(replica, MW_ORDER_SUM);
+            mw_readAll(replica->fdRootToMaster, &(answer->code), sizeof(int));
+            mw_readAll(replica->fdRootToMaster, &(answer->sum), sizeof(eltsum_t));
+        }
+        break;
+      default:
+        answer->code = CM_ANSWER_ERROR;
+        break;
+    }
+}
+
+int * rp_treeStats(Replica *replica, MwTreeStats *stats)
+{
+    *stats = (MwTreeStats) {0};
+    if (! replica->hasChild)
+        return NULL;
+    writeOrder(replica, MW_ORDER_TREESTATS);
+    int receipt;
+    mw_readAll(replica->fdRootToMaster, &receipt, sizeof(int));
+    myassert(receipt == MW_ANSWER_TREESTATS, "accusé de reception inattendu");
+    return mw_readTreeStats(replica->fdRootToMaster, stats);
+}
+
+void rp_stop(Replica *replica)
+{
+    if (! replica->hasChild)
+        return;
+    writeOrder(replica, MW_ORDER_STOP);
+    waitpid(replica->pid, NULL, 0);
+    close(replica->fdToRoot);
+    close(replica->fdRootToMaster);
+    close(replica->fdAnyToMaster);
+    rp_init(replica);
+}
+
+
+/************************************************************************
+ * journal
+ ************************************************************************/
+void rp_journalInit(RpJournal *journal)
+{
+    int ret = pthread_mutex_init(&(journal->lock), NULL);
+    myassert(ret == 0, "echec initialisation verrou journal");
+    journal->elts = NULL;
+    journal->first = 0;
+    journal->end = 0;
+    journal->capacity = 0;
+}
+
+void rp_journalEnd(RpJournal *journal)
+{
+    free(journal->elts);
+    journal->elts = NULL;
+    journal->capacity = 0;
+    pthread_mutex_destroy(&(journal->lock));
+}
+
+void rp_journalAppend(RpJournal *journal, const elt_t *elts, int nb, uint64_t applied)
+{
+    pthread_mutex_lock(&(journal->lock));
+    //oubli du début rejoué partout
+    if (applied > journal->first)
+    {
+        uint64_t dropped = applied - journal->first;
+        memmove(journal->elts, journal->elts + dropped, (journal->end - applied) * sizeof(elt_t));
+        journal->first = applied;
+    }
+    uint64_t size = journal->end - journal->first;
+    if (size + nb > journal->capacity)
+    {
+        while (size + nb > journal->capacity)
+            journal->capacity = (journal->capacity == 0) ? 1024 : 2 * journal->capacity;
+        journal->elts = realloc(journal->elts, journal->capacity * sizeof(elt_t));
+        myassert(journal->elts != NULL, "echec allocation journal");
+    }
+    memcpy(journal->elts + size, elts, nb * sizeof(elt_t));
+    journal->end += nb;
+    pthread_mutex_unlock(&(journal->lock));
+}
+
+uint64_t rp_journalLength(RpJournal *journal)
+{
+    pthread_mutex_lock(&(journal->lock));
+    uint64_t end = journal->end;
+    pthread_mutex_unlock(&(journal->lock));
+    return end;
+}
+
+void rp_journalCopy(RpJournal *journal, uint64_t from, uint64_t to, elt_t **buf, uint64_t *capacity)
+{
+    if (to - from > *capacity)
+    {
+        *capacity = to - from;
+        free(*buf);
+        *buf = malloc(*capacity * sizeof(elt_t));
+        myassert(*buf != NULL, "echec allocation copie du journal");
+    }
+    pthread_mutex_lock(&(journal->lock));
+    myassert((from >= journal->first) && (to <= journal->end), "rangs hors du journal");
+    memcpy(*buf, journal->elts + (from - journal->first), (to - from) * sizeof(elt_t));
+    pthread_mutex_unlock(&(journal->lock));
+}
@@ -0,0 +1,74 @@
+#ifndef REPLICA_H
+#define REPLICA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "element.h"
+#include "client_master.h"
+#include "master_worker.h"
+
+/******************************************
+ * répliques de l'arbre des workers
+ ******************************************/
+// Mode optionnel du master (variable d'environnement MWC_REPLICAS) :
+//    MWC_REPLICAS=<n>[:ryw]
+// Le master crée <n> arbres de workers de plus (répliques), chacun servi
+// par son propre thread. Les insertions validées par l'arbre principal sont
+// ajoutées à un journal ; chaque réplique le rejoue dans l'ordre, de façon
+// asynchrone, par lots (un ordre MW_ORDER_INSERT_MANY). Les lectures de la
+// boîte aux lettres (howmany, min, max, exist, sum) sont prises par la
+// première réplique libre : elles ne passent plus par l'arbre principal et
+// plusieurs lectures avancent en même temps.
+// Une réplique peut être en retard sur l'arbre principal. Avec ":ryw", elle
+// rejoue tout le journal avant de répondre : une lecture voit toute écriture
+// acquittée avant elle (lecture de ses propres écritures).
+// Les ordres des tubes nommés passent toujours par l'arbre principal.
+
+#define RP_ENV_MODE     "MWC_REPLICAS"
+#define RP_MAX          16
+
+// lecture de MWC_REPLICAS ; false si le mode n'est pas demandé ou incorrect
+bool rp_parse(const char *spec, int *nb, bool *barrier);
+
+// une réplique (utilisée par un seul thread)
+typedef struct {
+    bool hasChild;
+    pid_t pid;              // racine de la réplique
+    int fdToRoot;
+    int fdRootToMaster;
+    int fdAnyToMaster;
+} Replica;
+
+void rp_init(Replica *replica);
+// insertion d'un lot (création de la racine avec le premier élément si besoin)
+void rp_insert(Replica *replica, const elt_t *elts, int nb);
+// lecture (cf. cm_isReadOrder) : même protocole que l'arbre principal
+void rp_answer(Replica *replica, int order, elt_t elt, CmAnswer *answer);
+// forme de l'arbre de la réplique (cf. MW_ORDER_TREESTATS) ; retourne les
+// profondeurs (allouées, NULL et statistiques nulles sans arbre)
+int * rp_treeStats(Replica *replica, MwTreeStats *stats);
+// arrêt de l'arbre de la réplique
+void rp_stop(Replica *replica);
+
+// journal des insertions validées (rang : position depuis le début)
+typedef struct {
+    pthread_mutex_t lock;
+    elt_t *elts;
+    uint64_t first;         // rang de elts[0]
+    uint64_t end;           // rang suivant le dernier élément
+    uint64_t capacity;
+} RpJournal;
+
+void rp_journalInit(RpJournal *journal);
+void rp_journalEnd(RpJournal *journal);
+// ajout d'un lot ; les éléments de rang < <applied> (rejoués par toutes les
+// répliques) sont oubliés
+void rp_journalAppend(RpJournal *journal, const elt_t *elts, int nb, uint64_t applied);
+uint64_t rp_journalLength(RpJournal *journal);
+// copie des éléments de rang [from, to[ dans *buf (agrandi si besoin)
+void rp_journalCopy(RpJournal *journal, uint64_t from, uint64_t to, elt_t **buf, uint64_t *capacity);
+
+#endif
@@ -0,0 +1,157 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// MSG_CMSG_CLOEXEC
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "myassert.h"
+
+#include "routing.h"
+
+
+/************************************************************************
+ * mode
+ ************************************************************************/
+int rt_mode(void)
+{
+    const char *env = getenv(RT_ENV_MODE);
+    if ((env != NULL) && (strcmp(env, rt_name(RT_DIRECT)) == 0))
+        return RT_DIRECT;
+    return RT_TREE;
+}
+
+const char * rt_name(int mode)
+{
+    return (mode == RT_DIRECT) ? "direct" : "tree";
+}
+
+
+/************************************************************************
+ * inscriptions
+ ************************************************************************/
+// un message : l'élément, et le descripteur en donnée annexe
+typedef union {
+    struct cmsghdr header;
+    char buf[CMSG_SPACE(sizeof(int))];
+} FdControl;
+
+void rt_register(int fdRoute, elt_t elt, int fd)
+{
+    struct iovec iov = { &elt, sizeof(elt_t) };
+    FdControl control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    ssize_t ret = sendmsg(fdRoute, &msg, 0);
+    myassert(ret == (ssize_t) sizeof(elt_t), "echec inscription auprès du master");
+}
+
+int rt_receive(int fdRoute, elt_t *elt, int *fd)
+{
+    struct iovec iov = { elt, sizeof(elt_t) };
+    FdControl control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    ssize_t ret = recvmsg(fdRoute, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    //(0 : plus aucun worker ne peut écrire)
+    if ((ret == 0) || ((ret == -1) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))))
+        return 0;
+    myassert(ret == (ssize_t) sizeof(elt_t), "inscription incorrecte");
+
+    //plus de descripteur disponible : le noyau tronque la donnée annexe
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if ((msg.msg_flags & MSG_CTRUNC) || (cmsg == NULL) || (cmsg->cmsg_type != SCM_RIGHTS))
+    {
+        *fd = -1;
+        return -1;
+    }
+    memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+    return 1;
+}
+
+
+/************************************************************************
+ * table triée
+ ************************************************************************/
+void rt_init(RtTable *table)
+{
+    table->nb = 0;
+    table->capacity = 0;
+    table->entries = NULL;
+}
+
+// indice du premier élément >= elt
+static int lowerBound(const RtTable *table, elt_t elt)
+{
+    int lo = 0;
+    int hi = table->nb;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (table->entries[mid].elt < elt)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+void rt_add(RtTable *table, elt_t elt, int fd)
+{
+    int pos = lowerBound(table, elt);
+    myassert((pos == table->nb) || (table->entries[pos].elt != elt), "élément déjà inscrit");
+
+    if (table->nb == table->capacity)
+    {
+        table->capacity = (table->capacity == 0) ? 64 : 2 * table->capacity;
+        table->entries = realloc(table->entries, table->capacity * sizeof(RtEntry));
+        myassert(table->entries != NULL, "echec allocation table de routage");
+    }
+    memmove(&(table->entries[pos + 1]), &(table->entries[pos]), (table->nb - pos) * sizeof(RtEntry));
+    table->entries[pos].elt = elt;
+    table->entries[pos].fd = fd;
+    table->nb++;
+}
+
+int rt_find(const RtTable *table, elt_t elt)
+{
+    int pos = lowerBound(table, elt);
+    if ((pos < table->nb) && (table->entries[pos].elt == elt))
+        return table->entries[pos].fd;
+    return -1;
+}
+
+void rt_end(RtTable *table)
+{
+    for (int i = 0; i < table->nb; i++)
+        close(table->entries[i].fd);
+    free(table->entries);
+    rt_init(table);
+}
@@ -0,0 +1,67 @@
+#ifndef ROUTING_H
+#define ROUTING_H
+
+#include <stdbool.h>
+
+#include "element.h"
+
+/******************************************
+ * routage direct du master vers les workers
+ ******************************************/
+// Mode optionnel (variable d'environnement MWC_ROUTE, lue par le master) :
+//    tree    (défaut) tout ordre part du premier worker et descend l'arbre
+//    direct  le master garde une table triée élément -> canal d'entrée du
+//            worker qui le gère : exist et insert d'un élément présent
+//            vont directement au bon worker (un saut au lieu de la
+//            profondeur), exist d'un élément absent est répondu sans
+//            aucun worker
+// En mode direct, le master crée une socket unix (SOCK_SEQPACKET) héritée
+// par tous les workers (dernier argument de ./worker). Un worker qui crée
+// un fils y inscrit l'élément du fils et une copie de l'extrémité
+// d'écriture de son tube d'entrée (SCM_RIGHTS), avant le fork : l'inscription
+// précède donc toujours l'accusé de réception de création du fils, et le
+// master la lit dès qu'il a reçu cet accusé (la table reste à jour).
+// Le tube d'entrée d'un worker a alors deux écrivains, son père et le
+// master : ils ne se gênent pas, le master n'envoyant un ordre qu'une fois
+// le précédent terminé.
+// Si le master ne peut plus recevoir de descripteur (limite RLIMIT_NOFILE),
+// la table devient incomplète : un élément absent de la table passe alors
+// par l'arbre.
+
+#define RT_ENV_MODE     "MWC_ROUTE"
+
+#define RT_TREE         0
+#define RT_DIRECT       1
+
+int rt_mode(void);
+const char * rt_name(int mode);
+
+// côté worker : inscription de <fd> (copié par le noyau) pour <elt>
+void rt_register(int fdRoute, elt_t elt, int fd);
+
+// côté master : lecture d'une inscription sans attendre ; retourne 1 si
+// une inscription a été lue, 0 s'il n'y en a pas, -1 si une inscription
+// a été lue mais son descripteur perdu (*fd vaut alors -1)
+int rt_receive(int fdRoute, elt_t *elt, int *fd);
+
+// table triée des éléments et de leurs canaux
+typedef struct {
+    elt_t elt;
+    int fd;
+} RtEntry;
+
+typedef struct {
+    int nb;
+    int capacity;
+    RtEntry *entries;
+} RtTable;
+
+void rt_init(RtTable *table);
+// ajout (la table devient propriétaire de <fd>)
+void rt_add(RtTable *table, elt_t elt, int fd);
+// canal du worker qui gère <elt>, -1 s'il n'est pas dans la table
+int rt_find(const RtTable *table, elt_t elt);
+// fermeture de tous les canaux
+void rt_end(RtTable *table);
+
+#endif
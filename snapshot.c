@@ -0,0 +1,135 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "myassert.h"
+
+#include "snapshot.h"
+
+
+/************************************************************************
+ * paramètres
+ ************************************************************************/
+bool sn_parse(const char *spec)
+{
+    return (spec != NULL) && (strcmp(spec, "on") == 0);
+}
+
+void sn_init(Snapshot *snap)
+{
+    int ret = pthread_mutex_init(&(snap->lock), NULL);
+    myassert(ret == 0, "echec initialisation verrou instantané");
+    snap->epoch = 0;
+    snap->nbTotal = 0;
+    snap->nbDistinct = 0;
+    snap->sum = 0;
+    snap->min = 0;
+    snap->max = 0;
+    snap->capacity = 1024;
+    snap->entries = calloc(snap->capacity, sizeof(SnEntry));
+    myassert(snap->entries != NULL, "echec allocation instantané");
+}
+
+void sn_end(Snapshot *snap)
+{
+    free(snap->entries);
+    snap->entries = NULL;
+    snap->capacity = 0;
+    pthread_mutex_destroy(&(snap->lock));
+}
+
+
+/************************************************************************
+ * table des cardinalités (adressage ouvert, jamais de suppression)
+ ************************************************************************/
+static int slotOf(const SnEntry *entries, int capacity, elt_t elt)
+{
+    int i = (int) (elt_hash(elt) & (uint64_t) (capacity - 1));
+    while ((entries[i].count != 0) && (entries[i].elt != elt))
+        i = (i + 1) & (capacity - 1);
+    return i;
+}
+
+//taux de remplissage maximal 1/2
+static void grow(Snapshot *snap)
+{
+    int capacity = 2 * snap->capacity;
+    SnEntry *entries = calloc(capacity, sizeof(SnEntry));
+    myassert(entries != NULL, "echec allocation instantané");
+    for (int i = 0; i < snap->capacity; i++)
+        if (snap->entries[i].count != 0)
+            entries[slotOf(entries, capacity, snap->entries[i].elt)] = snap->entries[i];
+    free(snap->entries);
+    snap->entries = entries;
+    snap->capacity = capacity;
+}
+
+static void add(Snapshot *snap, elt_t elt)
+{
+    SnEntry *entry = &(snap->entries[slotOf(snap->entries, snap->capacity, elt)]);
+    if (entry->count == 0)
+    {
+        entry->elt = elt;
+        if ((snap->nbDistinct == 0) || (elt < snap->min))
+            snap->min = elt;
+        if ((snap->nbDistinct == 0) || (elt > snap->max))
+            snap->max = elt;
+        snap->nbDistinct++;
+    }
+    entry->count++;
+    snap->nbTotal++;
+    snap->sum += (eltsum_t) elt;
+
+    if (2 * snap->nbDistinct > snap->capacity)
+        grow(snap);
+}
+
+
+/************************************************************************
+ * versions
+ ************************************************************************/
+void sn_commit(Snapshot *snap, const elt_t *elts, int nb)
+{
+    pthread_mutex_lock(&(snap->lock));
+    for (int i = 0; i < nb; i++)
+        add(snap, elts[i]);
+    snap->epoch++;
+    pthread_mutex_unlock(&(snap->lock));
+}
+
+void sn_answer(Snapshot *snap, int order, elt_t elt, CmAnswer *answer)
+{
+    pthread_mutex_lock(&(snap->lock));
+    bool empty = (snap->nbDistinct == 0);
+    switch (order)
+    {
+      case CM_ORDER_HOW_MANY:
+        answer->code = CM_ANSWER_HOW_MANY_OK;
+        answer->nbTotal = snap->nbTotal;
+        answer->nbDistinct = snap->nbDistinct;
+        break;
+      case CM_ORDER_MINIMUM:
+        answer->code = empty ? CM_ANSWER_MINIMUM_EMPTY : CM_ANSWER_MINIMUM_OK;
+        answer->elt = snap->min;
+        break;
+      case CM_ORDER_MAXIMUM:
+        answer->code = empty ? CM_ANSWER_MAXIMUM_EMPTY : CM_ANSWER_MAXIMUM_OK;
+        answer->elt = snap->max;
+        break;
+      case CM_ORDER_EXIST:
+        answer->quantity = snap->entries[slotOf(snap->entries, snap->capacity, elt)].count;
+        answer->code = (answer->quantity > 0) ? CM_ANSWER_EXIST_YES : CM_ANSWER_EXIST_NO;
+        break;
+      case CM_ORDER_SUM:
+        answer->code = CM_ANSWER_SUM_OK;
+        answer->sum = snap->sum;
+        break;
+      default:
+        answer->code = CM_ANSWER_ERROR;
+        break;
+    }
+    pthread_mutex_unlock(&(snap->lock));
+}
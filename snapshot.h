@@ -0,0 +1,57 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "element.h"
+#include "client_master.h"
+
+/******************************************
+ * instantané de l'ensemble pour les lectures
+ ******************************************/
+// Mode optionnel du master (variable d'environnement MWC_SNAPSHOT=on) :
+// le master tient une copie de l'ensemble (cardinalité de chaque élément,
+// nombres d'éléments, somme, minimum, maximum), mise à jour après chaque
+// écriture terminée par les workers (validation). Un insertmany est validé
+// en une fois, à la fin : une lecture voit tout le lot ou rien du lot.
+// Chaque validation crée une nouvelle version (epoch).
+// Une lecture (howmany, min, max, exist, sum) de la boîte aux lettres qui
+// arrive pendant un autre ordre (un long insertmany typiquement) n'attend
+// pas les workers : elle est répondue par la dernière version validée.
+// Le nombre d'éléments distincts est celui des workers (quelques milliers) :
+// la copie reste petite devant l'arbre.
+
+#define SN_ENV_MODE     "MWC_SNAPSHOT"
+
+typedef struct {
+    elt_t elt;
+    int count;              // 0 : case libre
+} SnEntry;
+
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t epoch;         // nombre de validations
+    int nbTotal;
+    int nbDistinct;
+    eltsum_t sum;
+    elt_t min;
+    elt_t max;
+    int capacity;           // puissance de 2 (adressage ouvert)
+    SnEntry *entries;
+} Snapshot;
+
+// lecture de MWC_SNAPSHOT ; false si le mode n'est pas demandé
+bool sn_parse(const char *spec);
+
+void sn_init(Snapshot *snap);
+void sn_end(Snapshot *snap);
+
+// validation d'un lot d'éléments insérés : nouvelle version, visible d'un coup
+void sn_commit(Snapshot *snap, const elt_t *elts, int nb);
+
+// réponse à une lecture (cf. cm_isReadOrder) d'après la dernière version validée
+void sn_answer(Snapshot *snap, int order, elt_t elt, CmAnswer *answer);
+
+#endif
@@ -0,0 +1,257 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+
+#include "myassert.h"
+
+#include "trace.h"
+#include "client_master.h"
+#include "master_worker.h"
+
+TrRing *tr_ring = NULL;
+uint32_t tr_traceId = 0;
+
+// en-tête du processus, utilisé aussi sans anneau (mode VERBOSE)
+static TrRing self;
+
+
+/************************************************************************
+ * noms des ordres
+ ************************************************************************/
+static const char * masterOrderName(int order)
+{
+    switch (order)
+    {
+      case CM_ORDER_STOP:        return "stop";
+      case CM_ORDER_HOW_MANY:    return "how many";
+      case CM_ORDER_MINIMUM:     return "minimum";
+      case CM_ORDER_MAXIMUM:     return "maximum";
+      case CM_ORDER_EXIST:       return "existence";
+      case CM_ORDER_SUM:         return "somme";
+      case CM_ORDER_INSERT:      return "insertion";
+      case CM_ORDER_INSERT_MANY: return "insertion tableau";
+      case CM_ORDER_PRINT:       return "affichage";
+      case CM_ORDER_STATS:       return "statistiques";
+      case CM_ORDER_TREESTATS:   return "statistiques de l'arbre";
+      default:                   return "inconnu";
+    }
+}
+
+static const char * workerOrderName(int order)
+{
+    switch (order)
+    {
+      case MW_ORDER_STOP:        return "stop";
+      case MW_ORDER_HOW_MANY:    return "how many";
+      case MW_ORDER_MINIMUM:     return "minimum";
+      case MW_ORDER_MAXIMUM:     return "maximum";
+      case MW_ORDER_EXIST:       return "exist";
+      case MW_ORDER_SUM:         return "sum";
+      case MW_ORDER_INSERT:      return "insert";
+      case MW_ORDER_PRINT:       return "print";
+      case MW_ORDER_TREESTATS:   return "tree stats";
+      case MW_ORDER_INSERT_MANY: return "insert many";
+      default:                   return "inconnu";
+    }
+}
+
+const char * tr_orderName(const char *role, int order)
+{
+    if (strcmp(role, "worker") == 0)
+        return workerOrderName(order);
+    return masterOrderName(order);
+}
+
+
+/************************************************************************
+ * décodage
+ ************************************************************************/
+// l'élément est décodé selon le type du processus qui l'a écrit
+void tr_formatElt(const char *eltName, uint64_t bits, char *buf, size_t size)
+{
+    if (strcmp(eltName, "double") == 0)
+    {
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        snprintf(buf, size, "%g", d);
+    }
+    else if (strcmp(eltName, "int32") == 0)
+    {
+        int32_t i;
+        memcpy(&i, &bits, sizeof(i));
+        snprintf(buf, size, "%" PRId32, i);
+    }
+    else if (strcmp(eltName, "int64") == 0)
+    {
+        int64_t i;
+        memcpy(&i, &bits, sizeof(i));
+        snprintf(buf, size, "%" PRId64, i);
+    }
+    else
+    {
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        snprintf(buf, size, "%g", f);
+    }
+}
+
+void tr_format(const TrRing *ring, const TrRecord *rec, char *buf, size_t size)
+{
+    bool worker = (strcmp(ring->role, "worker") == 0);
+    char who[96];
+    if (! worker)
+        snprintf(who, sizeof(who), "[%s]", ring->role);
+    else
+    {
+        char elt[32];
+        tr_formatElt(ring->eltName, rec->elt, elt, sizeof(elt));
+        snprintf(who, sizeof(who), "    [worker (%d, %d) {%s}] :", (int) ring->pid, (int) ring->ppid, elt);
+    }
+    const char *order = tr_orderName(ring->role, rec->order);
+    char id[32] = "";
+    if (rec->traceId != 0)
+        snprintf(id, sizeof(id), " #%u", (unsigned) rec->traceId);
+
+    switch (rec->event)
+    {
+      case TR_START:
+        snprintf(buf, size, "%s début", who);
+        break;
+      case TR_READY:
+        snprintf(buf, size, "  %s semaphores and pipes created", who);
+        break;
+      case TR_ORDER:
+        snprintf(buf, size, "%s ordre %s%s", who, order, id);
+        break;
+      case TR_ORDER_END:
+        snprintf(buf, size, "%s fin ordre %s%s (%.1f µs)", who, order, id, rec->arg * 1e-3);
+        break;
+      case TR_SESSION:
+        snprintf(buf, size, "%s début session", who);
+        break;
+      case TR_SESSION_END:
+        snprintf(buf, size, "%s fin session %s", who, order);
+        break;
+      case TR_END:
+        snprintf(buf, size, "%s terminaison", who);
+        break;
+      default:
+        snprintf(buf, size, "%s événement %d inconnu", who, (int) rec->event);
+        break;
+    }
+}
+
+void tr_print(int event, int order, elt_t elt, uint64_t arg)
+{
+    if (self.role[0] == '\0')
+        return;
+    union { elt_t e; uint64_t u; } bits = { .u = 0 };
+    bits.e = elt;
+    TrRecord rec = { .traceId = tr_traceId, .event = event, .order = order, .elt = bits.u, .arg = arg };
+    char line[256];
+    tr_format(&self, &rec, line, sizeof(line));
+    fprintf(stderr, "%s\n", line);
+}
+
+
+/************************************************************************
+ * création des anneaux
+ ************************************************************************/
+const char * tr_dir(void)
+{
+    const char *dir = getenv(TR_ENV_DIR);
+    return (dir != NULL) ? dir : TR_DIR;
+}
+
+// suppression des anneaux dont le master (ou le client) est terminé
+static void removeStaleRings(const char *dir)
+{
+    DIR *d = opendir(dir);
+    if (d == NULL)
+        return;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL)
+    {
+        int run, pid;
+        if (sscanf(entry->d_name, TR_PREFIX "%d.%d", &run, &pid) != 2)
+            continue;
+        int owner = (run != 0) ? run : pid;
+        if ((kill(owner, 0) == -1) && (errno == ESRCH))
+        {
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(d);
+}
+
+void tr_init(const char *role, bool newRun)
+{
+    memset(&self, 0, sizeof(self));
+    memcpy(self.magic, TR_MAGIC, sizeof(self.magic));
+    self.version = TR_VERSION;
+    self.capacity = TR_CAPACITY;
+    self.pid = getpid();
+    self.ppid = getppid();
+    snprintf(self.role, sizeof(self.role), "%s", role);
+    snprintf(self.eltName, sizeof(self.eltName), "%s", ELT_NAME);
+
+    const char *mode = getenv(TR_ENV_MODE);
+    if ((mode != NULL) && (strcmp(mode, TR_MODE_OFF) == 0))
+        return;
+    //processus lancé à part (client) : anneau seulement sur demande, sinon
+    //chaque client laisserait un anneau jusqu'au master suivant
+    const char *inherited = getenv(TR_ENV_RUN);
+    if ((! newRun) && (inherited == NULL)
+        && ((mode == NULL) || (strcmp(mode, TR_MODE_CLIENT) != 0)))
+        return;
+
+    const char *dir = tr_dir();
+    char run[32];
+    if (newRun)
+    {
+        removeStaleRings(dir);
+        snprintf(run, sizeof(run), "%d", (int) self.pid);
+        int ret = setenv(TR_ENV_RUN, run, 1);
+        myassert(ret == 0, "echec variable d'environnement des traces");
+    }
+    else
+    {
+        snprintf(run, sizeof(run), "%s", (inherited != NULL) ? inherited : "0");
+    }
+
+    //en cas d'échec les traces sont simplement désactivées
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/" TR_PREFIX "%s.%d", dir, run, (int) self.pid);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+        return;
+    size_t size = sizeof(TrRing) + TR_CAPACITY * sizeof(TrRecord);
+    int ret = ftruncate(fd, size);
+    void *addr = (ret == 0) ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (addr == MAP_FAILED)
+    {
+        unlink(path);
+        return;
+    }
+
+    TrRing *ring = addr;
+    memcpy(ring, &self, sizeof(TrRing));
+    tr_ring = ring;
+}
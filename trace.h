@@ -0,0 +1,121 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "element.h"
+#include "utils.h"
+
+/******************************************
+ * traces binaires (master et workers)
+ ******************************************/
+// Chaque processus (master, workers, clients) écrit ses événements dans
+// un anneau en mémoire partagée (un fichier projeté, par défaut dans
+// /dev/shm) : une écriture de 32 octets et une lecture d'horloge par
+// événement, sans appel système ni formatage. Les anneaux survivent aux
+// processus ; ./tracedump les fusionne et les décode après coup.
+//    <dir>/mwc-trace-<run>.<pid>
+// <run> est le pid du master : les workers en héritent par la variable
+// d'environnement MWC_TRACE_RUN ; les clients, lancés à part, utilisent
+// <run> = 0 et sont rattachés à une exécution par leurs dates. Le
+// répertoire peut être changé par MWC_TRACE_DIR ; MWC_TRACE=off
+// désactive les traces et MWC_TRACE=client enregistre aussi les clients
+// (sans anneau par défaut).
+//
+// Chaque requête d'un client reçoit du master un identifiant de trace,
+// transmis avec chaque ordre aux workers (cf. mw_writeOrder) et enregistré
+// dans tous les événements qu'elle provoque : ./tracedump --chrome=<fichier>
+// en déduit une chronologie Chrome/Perfetto de la requête à travers les
+// processus.
+// Si VERBOSE est défini (cf. config.h), chaque événement est en plus
+// affiché sur stderr.
+
+#define TR_DIR          "/dev/shm"
+#define TR_PREFIX       "mwc-trace-"
+#define TR_ENV_RUN      "MWC_TRACE_RUN"
+#define TR_ENV_DIR      "MWC_TRACE_DIR"
+#define TR_ENV_MODE     "MWC_TRACE"
+#define TR_MODE_OFF     "off"
+#define TR_MODE_CLIENT  "client"
+#define TR_MAGIC        "MWCTRACE"
+#define TR_VERSION      2
+#define TR_CAPACITY     (1 << 14)       // événements par anneau (puissance de 2)
+
+// événements
+#define TR_START        1       // début du processus
+#define TR_READY        2       // master : sémaphores et tubes nommés créés
+#define TR_ORDER        3       // réception d'un ordre (order)
+#define TR_ORDER_END    4       // fin d'un ordre (order, arg = durée en ns)
+#define TR_END          5       // fin du processus
+#define TR_SESSION      6       // client : début d'une session avec le master
+#define TR_SESSION_END  7       // client : fin de la session (order)
+
+typedef struct {
+    uint64_t time;          // ns, horloge monotone commune à tous les processus
+    uint32_t traceId;       // requête en cours (0 : aucune)
+    uint16_t event;
+    int16_t order;          // CM_ORDER_* (master, client) ou MW_ORDER_* (worker)
+    uint64_t elt;           // worker : bits de son élément
+    uint64_t arg;
+} TrRecord;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t capacity;
+    int32_t pid;
+    int32_t ppid;
+    char role[16];          // "master", "worker" ou "client"
+    char eltName[16];       // ELT_NAME (pour décoder elt)
+    volatile uint64_t next; // nombre d'événements écrits depuis le début
+    TrRecord records[];
+} TrRing;
+
+// anneau du processus (NULL si les traces sont désactivées)
+extern TrRing *tr_ring;
+
+// identifiant de trace de la requête en cours
+extern uint32_t tr_traceId;
+
+// création de l'anneau du processus ; <newRun> : le master commence une
+// nouvelle exécution (et supprime les anneaux des masters terminés)
+// (un processus lancé à part, sans MWC_TRACE_RUN, n'en crée que si
+// MWC_TRACE=client)
+void tr_init(const char *role, bool newRun);
+
+// affichage d'un événement sur stderr (mode VERBOSE)
+void tr_print(int event, int order, elt_t elt, uint64_t arg);
+
+// décodage d'un événement d'un anneau
+void tr_format(const TrRing *ring, const TrRecord *rec, char *buf, size_t size);
+// nom d'un ordre (CM_ORDER_* ou MW_ORDER_* selon le rôle du processus)
+const char * tr_orderName(const char *role, int order);
+// élément (bits d'un TrRecord) d'un processus de type <eltName>
+void tr_formatElt(const char *eltName, uint64_t bits, char *buf, size_t size);
+
+// chemin des anneaux
+const char * tr_dir(void);
+
+static inline void tr_event(int event, int order, elt_t elt, uint64_t arg)
+{
+#ifdef VERBOSE
+    tr_print(event, order, elt, arg);
+#endif
+    TrRing *ring = tr_ring;
+    if (ring == NULL)
+        return;
+    union { elt_t e; uint64_t u; } bits = { .u = 0 };
+    bits.e = elt;
+    TrRecord *rec = &(ring->records[ring->next & (ring->capacity - 1)]);
+    rec->time = ut_getTimeNs();
+    rec->traceId = tr_traceId;
+    rec->event = event;
+    rec->order = order;
+    rec->elt = bits.u;
+    rec->arg = arg;
+    ring->next++;
+}
+
+#endif
@@ -0,0 +1,448 @@
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "myassert.h"
+
+#include "trace.h"
+
+/************************************************************************
+ * Fusion et décodage des anneaux de traces (cf. trace.h)
+ ************************************************************************/
+// $ ./tracedump [--run=<pid du master>] [--dir=<répertoire>] [--clean]
+//               [--chrome=<fichier.json>]
+// Par défaut : l'exécution la plus récente du répertoire des anneaux.
+// Les événements de tous les processus (master, workers, et clients
+// pendant l'exécution) sont triés par date et affichés avec leur date
+// relative au premier événement.
+// --chrome écrit en plus une chronologie au format Chrome trace (à ouvrir
+// dans ui.perfetto.dev ou chrome://tracing) : une tranche par ordre traité
+// dans chaque processus, reliées par une flèche par requête.
+
+#define OPT_RUN     "--run="
+#define OPT_DIR     "--dir="
+#define OPT_CLEAN   "--clean"
+#define OPT_CHROME  "--chrome="
+
+typedef struct
+{
+    const char *dir;
+    int run;                // 0 : la plus récente
+    bool clean;
+    const char *chrome;     // NULL : pas d'export
+} Options;
+
+typedef struct
+{
+    TrRing *ring;
+    size_t size;
+    char path[1024];
+} Ring;
+
+typedef struct
+{
+    const TrRing *ring;
+    const TrRecord *rec;
+    int ringIndex;
+} Event;
+
+// ordre traité par un processus (session pour un client)
+typedef struct
+{
+    const TrRing *ring;
+    uint64_t begin;
+    uint64_t end;
+    int order;
+    uint32_t traceId;
+    uint64_t elt;
+} Span;
+
+
+/************************************************************************
+ * Usage et analyse des arguments passés en ligne de commande
+ ************************************************************************/
+static void usage(const char *exeName, const char *message)
+{
+    fprintf(stderr, "usage : %s [options]\n", exeName);
+    fprintf(stderr, "   " OPT_RUN "<pid>     exécution (pid du master), défaut : la plus récente\n");
+    fprintf(stderr, "   " OPT_DIR "<rép>     répertoire des anneaux (défaut : $" TR_ENV_DIR " ou " TR_DIR ")\n");
+    fprintf(stderr, "   " OPT_CLEAN "        supprime les anneaux de l'exécution après affichage\n");
+    fprintf(stderr, "   " OPT_CHROME "<f>  chronologie au format Chrome trace (JSON)\n");
+    if (message != NULL)
+        fprintf(stderr, "message : %s\n", message);
+    exit(EXIT_FAILURE);
+}
+
+static void parseArgs(int argc, char * argv[], Options *options)
+{
+    options->dir = tr_dir();
+    options->run = 0;
+    options->clean = false;
+    options->chrome = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], OPT_RUN, strlen(OPT_RUN)) == 0)
+        {
+            options->run = atoi(argv[i] + strlen(OPT_RUN));
+            if (options->run <= 0)
+                usage(argv[0], "pid incorrect");
+        }
+        else if (strncmp(argv[i], OPT_DIR, strlen(OPT_DIR)) == 0)
+            options->dir = argv[i] + strlen(OPT_DIR);
+        else if (strcmp(argv[i], OPT_CLEAN) == 0)
+            options->clean = true;
+        else if (strncmp(argv[i], OPT_CHROME, strlen(OPT_CHROME)) == 0)
+            options->chrome = argv[i] + strlen(OPT_CHROME);
+        else
+            usage(argv[0], "option inconnue");
+    }
+}
+
+
+/************************************************************************
+ * lecture des anneaux
+ ************************************************************************/
+// exécution dont un anneau a été modifié le plus récemment
+static int lastRun(const char *dir)
+{
+    DIR *d = opendir(dir);
+    myassert(d != NULL, "echec ouverture du répertoire des traces");
+    int run = 0;
+    time_t last = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL)
+    {
+        int r, pid;
+        if ((sscanf(entry->d_name, TR_PREFIX "%d.%d", &r, &pid) != 2) || (r == 0))
+            continue;
+        char path[1024];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        if ((stat(path, &st) == 0) && (st.st_mtime >= last))
+        {
+            last = st.st_mtime;
+            run = r;
+        }
+    }
+    closedir(d);
+    return run;
+}
+
+static bool mapRing(const char *path, Ring *ring)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return false;
+    struct stat st;
+    int ret = fstat(fd, &st);
+    myassert(ret == 0, "echec taille anneau");
+    void *addr = MAP_FAILED;
+    if ((size_t) st.st_size >= sizeof(TrRing))
+        addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return false;
+
+    TrRing *r = addr;
+    bool valid = (memcmp(r->magic, TR_MAGIC, sizeof(r->magic)) == 0) && (r->version == TR_VERSION)
+                 && ((size_t) st.st_size >= sizeof(TrRing) + r->capacity * sizeof(TrRecord));
+    if (! valid)
+    {
+        fprintf(stderr, "%s : anneau incorrect, ignoré\n", path);
+        munmap(addr, st.st_size);
+        return false;
+    }
+    ring->ring = r;
+    ring->size = st.st_size;
+    snprintf(ring->path, sizeof(ring->path), "%s", path);
+    return true;
+}
+
+// anneaux de l'exécution et des clients (run 0)
+static Ring * loadRings(const char *dir, int run, int *nb)
+{
+    DIR *d = opendir(dir);
+    myassert(d != NULL, "echec ouverture du répertoire des traces");
+    int capacity = 16;
+    Ring *rings = malloc(capacity * sizeof(Ring));
+    myassert(rings != NULL, "echec allocation");
+    *nb = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL)
+    {
+        int r, pid;
+        if ((sscanf(entry->d_name, TR_PREFIX "%d.%d", &r, &pid) != 2) || ((r != run) && (r != 0)))
+            continue;
+        if (*nb == capacity)
+        {
+            capacity *= 2;
+            rings = realloc(rings, capacity * sizeof(Ring));
+            myassert(rings != NULL, "echec allocation");
+        }
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        if (mapRing(path, &(rings[*nb])))
+            (*nb)++;
+    }
+    closedir(d);
+    return rings;
+}
+
+static bool isClient(const TrRing *ring)
+{
+    return strcmp(ring->role, "client") == 0;
+}
+
+static bool isMaster(const TrRing *ring)
+{
+    return strcmp(ring->role, "master") == 0;
+}
+
+// à date égale : master d'abord, puis par pid
+static int compareEvents(const void *a, const void *b)
+{
+    const Event *e1 = a;
+    const Event *e2 = b;
+    if (e1->rec->time != e2->rec->time)
+        return (e1->rec->time < e2->rec->time) ? -1 : 1;
+    bool m1 = isMaster(e1->ring);
+    bool m2 = isMaster(e2->ring);
+    if (m1 != m2)
+        return m1 ? -1 : 1;
+    return e1->ring->pid - e2->ring->pid;
+}
+
+// événements de l'exécution triés par date ; les événements des clients
+// hors de la période couverte par le master et les workers sont ignorés
+static Event * collectEvents(Ring *rings, int nbRings, bool *used, long *nb)
+{
+    uint64_t first = UINT64_MAX;
+    uint64_t last = 0;
+    long nbEvents = 0;
+    for (int i = 0; i < nbRings; i++)
+    {
+        const TrRing *r = rings[i].ring;
+        uint64_t kept = (r->next < r->capacity) ? r->next : r->capacity;
+        nbEvents += kept;
+        for (uint64_t k = r->next - kept; (k < r->next) && ! isClient(r); k++)
+        {
+            uint64_t t = r->records[k & (r->capacity - 1)].time;
+            first = (t < first) ? t : first;
+            last = (t > last) ? t : last;
+        }
+    }
+
+    Event *events = malloc((nbEvents > 0 ? nbEvents : 1) * sizeof(Event));
+    myassert(events != NULL, "echec allocation");
+    long n = 0;
+    for (int i = 0; i < nbRings; i++)
+    {
+        const TrRing *r = rings[i].ring;
+        uint64_t kept = (r->next < r->capacity) ? r->next : r->capacity;
+        used[i] = false;
+        for (uint64_t k = r->next - kept; k < r->next; k++)
+        {
+            const TrRecord *rec = &(r->records[k & (r->capacity - 1)]);
+            if (isClient(r) && ((rec->time < first) || (rec->time > last)))
+                continue;
+            events[n].ring = r;
+            events[n].rec = rec;
+            events[n].ringIndex = i;
+            used[i] = true;
+            n++;
+        }
+    }
+    qsort(events, n, sizeof(Event), compareEvents);
+    *nb = n;
+    return events;
+}
+
+
+/************************************************************************
+ * chronologie au format Chrome trace
+ ************************************************************************/
+// une tranche par couple début/fin d'ordre (ou de session) d'un processus
+static Span * buildSpans(const Event *events, long nbEvents, int nbRings, long *nb)
+{
+    Span *spans = malloc((nbEvents > 0 ? nbEvents : 1) * sizeof(Span));
+    myassert(spans != NULL, "echec allocation");
+    const TrRecord **pending = calloc(nbRings, sizeof(TrRecord *));
+    myassert(pending != NULL, "echec allocation");
+
+    long n = 0;
+    for (long i = 0; i < nbEvents; i++)
+    {
+        const TrRecord *rec = events[i].rec;
+        int r = events[i].ringIndex;
+        if ((rec->event == TR_ORDER) || (rec->event == TR_SESSION))
+            pending[r] = rec;
+        else if (((rec->event == TR_ORDER_END) || (rec->event == TR_SESSION_END)) && (pending[r] != NULL))
+        {
+            spans[n].ring = events[i].ring;
+            spans[n].begin = pending[r]->time;
+            spans[n].end = rec->time;
+            spans[n].order = rec->order;
+            spans[n].traceId = pending[r]->traceId;
+            spans[n].elt = pending[r]->elt;
+            n++;
+            pending[r] = NULL;
+        }
+    }
+    free(pending);
+
+    // une session de client est rattachée à l'ordre que le master a reçu
+    // pendant celle-ci (le master traite un client à la fois)
+    for (long i = 0; i < n; i++)
+    {
+        if (! isClient(spans[i].ring))
+            continue;
+        for (long j = 0; j < n; j++)
+        {
+            if (isMaster(spans[j].ring) && (spans[j].begin >= spans[i].begin)
+                && (spans[j].begin <= spans[i].end))
+            {
+                spans[i].traceId = spans[j].traceId;
+                break;
+            }
+        }
+    }
+    *nb = n;
+    return spans;
+}
+
+// par requête puis par date de début
+static int compareSpans(const void *a, const void *b)
+{
+    const Span *s1 = a;
+    const Span *s2 = b;
+    if (s1->traceId != s2->traceId)
+        return (s1->traceId < s2->traceId) ? -1 : 1;
+    if (s1->begin != s2->begin)
+        return (s1->begin < s2->begin) ? -1 : 1;
+    return 0;
+}
+
+static void writeChrome(const char *path, const Ring *rings, const bool *used, int nbRings,
+                        Span *spans, long nbSpans, uint64_t origin)
+{
+    FILE *f = fopen(path, "w");
+    myassert(f != NULL, "echec ouverture du fichier chrome");
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    //noms des processus
+    const char *sep = "";
+    for (int i = 0; i < nbRings; i++)
+    {
+        const TrRing *r = rings[i].ring;
+        if (! used[i])
+            continue;
+        fprintf(f, "%s{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+                sep, (int) r->pid, (int) r->pid, r->role, (int) r->pid);
+        sep = ",\n";
+    }
+
+    //tranches, puis flèches d'une requête à travers les processus
+    qsort(spans, nbSpans, sizeof(Span), compareSpans);
+    for (long i = 0; i < nbSpans; i++)
+    {
+        const Span *sp = &(spans[i]);
+        char elt[32] = "";
+        if (strcmp(sp->ring->role, "worker") == 0)
+            tr_formatElt(sp->ring->eltName, sp->elt, elt, sizeof(elt));
+        fprintf(f, "%s{\"ph\":\"X\",\"cat\":\"%s\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,"
+                   "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"traceId\":%u,\"elt\":\"%s\"}}",
+                sep, sp->ring->role, tr_orderName(sp->ring->role, sp->order), (int) sp->ring->pid, (int) sp->ring->pid,
+                (sp->begin - origin) * 1e-3, (sp->end - sp->begin) * 1e-3, (unsigned) sp->traceId, elt);
+        sep = ",\n";
+
+        if (sp->traceId == 0)
+            continue;
+        bool first = (i == 0) || (spans[i-1].traceId != sp->traceId);
+        bool last = (i == nbSpans - 1) || (spans[i+1].traceId != sp->traceId);
+        if (first && last)
+            continue;
+        fprintf(f, ",\n{\"ph\":\"%s\",\"cat\":\"requête\",\"name\":\"requête\",\"id\":%u,\"pid\":%d,\"tid\":%d,\"ts\":%.3f%s}",
+                first ? "s" : (last ? "f" : "t"), (unsigned) sp->traceId, (int) sp->ring->pid,
+                (int) sp->ring->pid, (sp->begin - origin) * 1e-3, last ? ",\"bp\":\"e\"" : "");
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+}
+
+
+/************************************************************************
+ * Fonction principale
+ ************************************************************************/
+int main(int argc, char * argv[])
+{
+    Options options;
+    parseArgs(argc, argv, &options);
+
+    int run = (options.run > 0) ? options.run : lastRun(options.dir);
+    if (run == 0)
+    {
+        fprintf(stderr, "aucune trace dans %s\n", options.dir);
+        return EXIT_FAILURE;
+    }
+    int nbRings;
+    Ring *rings = loadRings(options.dir, run, &nbRings);
+    bool *used = malloc((nbRings > 0 ? nbRings : 1) * sizeof(bool));
+    myassert(used != NULL, "echec allocation");
+    long n;
+    Event *events = collectEvents(rings, nbRings, used, &n);
+
+    //les plus anciens événements d'un anneau plein ont été écrasés
+    int nbUsed = 0;
+    for (int i = 0; i < nbRings; i++)
+        nbUsed += used[i];
+    printf("exécution %d : %d processus\n", run, nbUsed);
+    for (int i = 0; i < nbRings; i++)
+    {
+        const TrRing *r = rings[i].ring;
+        if (used[i] && (r->next > r->capacity))
+            printf("   %s %d : %llu événements perdus (anneau plein)\n", r->role, (int) r->pid,
+                   (unsigned long long) (r->next - r->capacity));
+    }
+
+    uint64_t origin = (n > 0) ? events[0].rec->time : 0;
+    for (long i = 0; i < n; i++)
+    {
+        char line[256];
+        tr_format(events[i].ring, events[i].rec, line, sizeof(line));
+        printf("%14.3f  %7d  %s\n", (events[i].rec->time - origin) * 1e-3, (int) events[i].ring->pid, line);
+    }
+
+    if (options.chrome != NULL)
+    {
+        long nbSpans;
+        Span *spans = buildSpans(events, n, nbRings, &nbSpans);
+        writeChrome(options.chrome, rings, used, nbRings, spans, nbSpans, origin);
+        printf("chronologie : %s (%ld tranches)\n", options.chrome, nbSpans);
+        free(spans);
+    }
+
+    free(events);
+    for (int i = 0; i < nbRings; i++)
+    {
+        munmap(rings[i].ring, rings[i].size);
+        if (options.clean && used[i])
+            unlink(rings[i].path);
+    }
+    free(used);
+    free(rings);
+    return EXIT_SUCCESS;
+}
@@ -2,84 +2,491 @@
 #include "config.h"
 #endif
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <time.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <dirent.h>
 //TODO d'autres include éventuellement
 
 #include "utils.h"
 #include "myassert.h"
 
+/******************************************
+ * générateur pseudo-aléatoire (xoshiro256**)
+ ******************************************/
+// taille (en éléments) des blocs d'un tableau généré : chaque bloc a son
+// propre flux, ce qui rend le tableau indépendant du nombre de threads
+#define UT_RNG_BLOCK (1L << 16)
+
+static uint64_t splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+void ut_rngInit(UtRng *rng, uint64_t seed, uint64_t stream)
+{
+    myassert(rng != NULL, "il faut un générateur");
+    uint64_t x = seed;
+    uint64_t mixedStream = stream;
+    x ^= splitmix64(&mixedStream);
+    for (int i = 0; i < 4; i++)
+        rng->s[i] = splitmix64(&x);
+}
+
+// versions internes, inlinées dans les boucles de génération
+static inline uint64_t rngNext(UtRng *rng)
+{
+    uint64_t *s = rng->s;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+static inline double rngUnit(UtRng *rng)
+{
+    return (rngNext(rng) >> 11) * 0x1.0p-53;
+}
+
+uint64_t ut_rngNext(UtRng *rng)
+{
+    return rngNext(rng);
+}
+
+double ut_rngUnit(UtRng *rng)
+{
+    return rngUnit(rng);
+}
+
+// partie entière inférieure sans appel à floor (|x| < 2^63)
+static inline double fastFloor(double x)
+{
+    double f = (double) (int64_t) x;
+    return (f > x) ? f - 1 : f;
+}
+
+// 10^precision
+static double ut_power10(int precision)
+{
+    double puiss = 1;
+    for (int i = 0; i < precision; i++)
+        puiss *= 10;
+    return puiss;
+}
+
+// tirage dans [min,max[ arrondi à 1/puiss
+static inline double rngRealPow(UtRng *rng, double min, double max, double puiss)
+{
+    double r;
+    do
+    {
+        r = rngUnit(rng) * (max - min) + min;
+        r = (puiss == 1) ? fastFloor(r) : fastFloor(r*puiss)/puiss;
+    } while (r >= max);
+    return r;
+}
+
+double ut_rngReal(UtRng *rng, double min, double max, int precision)
+{
+    myassert(min < max, "min doit être strictement inférieur à max");
+    myassert(precision >= 0, "la précision doit être positive");
+    return rngRealPow(rng, min, max, ut_power10(precision));
+}
+
+uint64_t ut_defaultSeed(void)
+{
+    uint64_t x = ((uint64_t) getpid() << 32) ^ (uint64_t) (ut_getTime() * 1e9);
+    return splitmix64(&x);
+}
+
+
 /******************************************
  * nombres aléatoires
  ******************************************/
+static UtRng globalRng;
+
 static void ut_initAlea(void)
 {
     static bool first = true;
     if (first)
     {
-        srand(getpid());
+        ut_rngInit(&globalRng, getpid(), 0);
         first = false;
     }
 }
 
-float ut_getAleaFloat(float min, float max, int precision)
+double ut_getAleaDouble(double min, double max, int precision)
 {
-    myassert(min < max, "min doit être strictement inférieur à max");
-    myassert(precision >= 0, "la précision doit être positive");
-
     ut_initAlea();
+    return ut_rngReal(&globalRng, min, max, precision);
+}
 
+float ut_getAleaFloat(float min, float max, int precision)
+{
     float r;
-    int puiss = 1;
-    for (int i = 0; i < precision; i++)
-        puiss *= 10;
-
     do
+        r = ut_getAleaDouble(min, max, precision);
+    while (r >= max);
+    return r;
+}
+
+/******************************************
+ * distributions
+ ******************************************/
+// noms reconnus par ut_parseDist, dans l'ordre de UtDistKind
+static const char *distNames[] = {
+    "uniform", "zipf", "normal", "sorted", "reverse", "nearly", "few"
+};
+
+// paramètres par défaut (cf. utils.h)
+#define UT_ZIPF_EXPONENT    1.0
+#define UT_NEARLY_PERCENT   1.0
+#define UT_FEW_DISTINCT     8
+// distance maximale entre deux éléments échangés (distribution "nearly")
+#define UT_NEARLY_DISTANCE  16
+#define UT_TWO_PI           6.283185307179586
+// flux réservés (les blocs utilisent les flux 0, 1, 2, ...)
+#define UT_STREAM_FEW       UINT64_MAX
+#define UT_STREAM_NEARLY    (UINT64_MAX - 1)
+
+bool ut_parseDist(const char *text, UtDist *dist)
+{
+    myassert(dist != NULL, "il faut une distribution");
+    const char *colon = strchr(text, ':');
+    size_t len = (colon != NULL) ? (size_t) (colon - text) : strlen(text);
+
+    int nbNames = sizeof(distNames) / sizeof(distNames[0]);
+    for (int i = 0; i < nbNames; i++)
     {
-        int rInt = rand();
-        r = ((float) rInt)/RAND_MAX * (max - min) + min;
-        r = floor(r*puiss)/puiss;
-    } while (r >= max);
+        if ((strlen(distNames[i]) == len) && (strncmp(text, distNames[i], len) == 0))
+        {
+            dist->kind = (UtDistKind) i;
+            if (dist->kind == UT_DIST_ZIPF)
+                dist->param = UT_ZIPF_EXPONENT;
+            else if (dist->kind == UT_DIST_NEARLY_SORTED)
+                dist->param = UT_NEARLY_PERCENT;
+            else if (dist->kind == UT_DIST_FEW_DISTINCT)
+                dist->param = UT_FEW_DISTINCT;
+            else
+                dist->param = 0;
+            if (colon != NULL)
+                dist->param = strtod(colon + 1, NULL);
+            return dist->param >= 0;
+        }
+    }
+    return false;
+}
 
+const char * ut_distName(UtDistKind kind)
+{
+    return distNames[kind];
+}
+
+// état partagé (lecture seule) d'une génération
+typedef struct {
+    UtDistKind kind;
+    double min;
+    double max;
+    double puiss;
+    // zipf (rejet-inversion, Hörmann et Derflinger) sur les rangs 1..nbValues
+    double zipfExponent;
+    double zipfNbValues;
+    double zipfHX1;
+    double zipfHN;
+    double zipfS;
+    // few : valeurs tirées une fois pour toutes
+    int nbFew;
+    double *fewValues;
+} GenState;
+
+// log(1+x)/x et (exp(x)-1)/x prolongées par continuité en 0
+static double helper1(double x)
+{
+    return (fabs(x) > 1e-8) ? log1p(x) / x : 1 - x * (0.5 - x * (1.0/3 - 0.25 * x));
+}
+
+static double helper2(double x)
+{
+    return (fabs(x) > 1e-8) ? expm1(x) / x : 1 + x * 0.5 * (1 + x * (1.0/3) * (1 + 0.25 * x));
+}
+
+static double zipfH(const GenState *g, double x)
+{
+    return exp(-g->zipfExponent * log(x));
+}
+
+static double zipfHIntegral(const GenState *g, double x)
+{
+    double logX = log(x);
+    return helper2((1 - g->zipfExponent) * logX) * logX;
+}
+
+static double zipfHIntegralInverse(const GenState *g, double x)
+{
+    double t = x * (1 - g->zipfExponent);
+    if (t < -1)
+        t = -1;
+    return exp(helper1(t) * x);
+}
+
+static void initZipf(GenState *g, double exponent)
+{
+    // une valeur par pas de 1/puiss dans [min,max[
+    g->zipfExponent = exponent;
+    g->zipfNbValues = ceil((g->max - g->min) * g->puiss);
+    if (g->zipfNbValues < 1)
+        g->zipfNbValues = 1;
+    g->zipfHX1 = zipfHIntegral(g, 1.5) - 1;
+    g->zipfHN = zipfHIntegral(g, g->zipfNbValues + 0.5);
+    g->zipfS = 2 - zipfHIntegralInverse(g, zipfHIntegral(g, 2.5) - zipfH(g, 2));
+}
+
+// rang dans 1..nbValues, de probabilité proportionnelle à 1/rang^exposant
+static double sampleZipf(const GenState *g, UtRng *rng)
+{
+    for (;;)
+    {
+        double u = g->zipfHN + rngUnit(rng) * (g->zipfHX1 - g->zipfHN);
+        double x = zipfHIntegralInverse(g, u);
+        double k = fastFloor(x + 0.5);
+        if (k < 1)
+            k = 1;
+        else if (k > g->zipfNbValues)
+            k = g->zipfNbValues;
+        if ((k - x <= g->zipfS) || (u >= zipfHIntegral(g, k + 0.5) - zipfH(g, k)))
+            return k;
+    }
+}
+
+// loi normale centrée sur le milieu de [min,max[, écart type (max-min)/6,
+// tronquée à [min,max[ (Box-Muller)
+static double sampleNormal(const GenState *g, UtRng *rng)
+{
+    double mean = (g->min + g->max) / 2;
+    double sigma = (g->max - g->min) / 6;
+    double r;
+    do
+    {
+        double u1 = 1 - rngUnit(rng);   // ]0,1]
+        double u2 = rngUnit(rng);
+        r = mean + sigma * sqrt(-2 * log(u1)) * cos(UT_TWO_PI * u2);
+        r = fastFloor(r * g->puiss) / g->puiss;
+    } while ((r < g->min) || (r >= g->max));
     return r;
 }
 
-float * ut_generateTab(int size, float min, float max, int precision)
+// un tirage selon la distribution (les distributions triées partent
+// d'un tirage uniforme, trié ensuite)
+static inline double sample(const GenState *g, UtRng *rng)
+{
+    switch (g->kind)
+    {
+      case UT_DIST_ZIPF:
+        {
+          double r = g->min + (sampleZipf(g, rng) - 1) / g->puiss;
+          return (r < g->max) ? r : rngRealPow(rng, g->min, g->max, g->puiss);
+        }
+      case UT_DIST_NORMAL:
+        return sampleNormal(g, rng);
+      case UT_DIST_FEW_DISTINCT:
+        return g->fewValues[ut_rngNext(rng) % g->nbFew];
+      default:
+        return rngRealPow(rng, g->min, g->max, g->puiss);
+    }
+}
+
+//Une structure pour les arguments d'un thread de génération
+typedef struct {
+    elt_t *t;
+    long size;
+    long firstBlock;    // premier bloc généré (inclus)
+    long lastBlock;     // dernier bloc généré (exclu)
+    uint64_t seed;
+    const GenState *state;
+} GenerateArgs;
+
+static void * generateBlocks(void *arg)
 {
-    float *t = malloc(size * sizeof(float));
-    myassert(t != NULL, "allocation mémoire génération tableau float");
-    for (int i = 0; i < size; i++)
-        t[i] = ut_getAleaFloat(min, max, precision);
+    GenerateArgs *args = (GenerateArgs *) arg;
+    elt_t *t = args->t;
+    const GenState *g = args->state;
+    for (long b = args->firstBlock; b < args->lastBlock; b++)
+    {
+        UtRng rng;
+        ut_rngInit(&rng, args->seed, b);
+        long end = (b + 1) * UT_RNG_BLOCK;
+        if (end > args->size)
+            end = args->size;
+        if (g->kind == UT_DIST_UNIFORM)
+        {
+            // cas le plus fréquent : boucle sans aiguillage
+            for (long i = b * UT_RNG_BLOCK; i < end; i++)
+                t[i] = ELT_FROM_REAL(rngRealPow(&rng, g->min, g->max, g->puiss));
+        }
+        else
+        {
+            for (long i = b * UT_RNG_BLOCK; i < end; i++)
+                t[i] = ELT_FROM_REAL(sample(g, &rng));
+        }
+    }
+    return NULL;
+}
+
+static int compareElt(const void *a, const void *b)
+{
+    elt_t x = *((const elt_t *) a);
+    elt_t y = *((const elt_t *) b);
+    return (x > y) - (x < y);
+}
+
+elt_t * ut_generateDist(const UtDist *dist, long size, double min, double max, int precision, uint64_t seed, int nbThreads)
+{
+    myassert(dist != NULL, "il faut une distribution");
+    myassert(size >= 0, "la taille doit être positive");
+    myassert(min < max, "min doit être strictement inférieur à max");
+    myassert(precision >= 0, "la précision doit être positive");
+    myassert(nbThreads >= 1, "il faut au moins un thread");
+
+    if (ELT_IS_INTEGER)
+        precision = 0;
+
+    elt_t *t = malloc(size * sizeof(elt_t));
+    myassert((t != NULL) || (size == 0), "allocation mémoire génération tableau d'éléments");
+
+    GenState state;
+    state.kind = dist->kind;
+    state.min = min;
+    state.max = max;
+    state.puiss = ut_power10(precision);
+    state.fewValues = NULL;
+    if (dist->kind == UT_DIST_ZIPF)
+        initZipf(&state, dist->param);
+    else if (dist->kind == UT_DIST_FEW_DISTINCT)
+    {
+        state.nbFew = (dist->param >= 1) ? (int) dist->param : 1;
+        state.fewValues = malloc(state.nbFew * sizeof(double));
+        myassert(state.fewValues != NULL, "allocation mémoire valeurs distinctes");
+        UtRng rng;
+        ut_rngInit(&rng, seed, UT_STREAM_FEW);
+        for (int i = 0; i < state.nbFew; i++)
+            state.fewValues[i] = rngRealPow(&rng, min, max, state.puiss);
+    }
+
+    // répartition des blocs entre les threads
+    long nbBlocks = (size + UT_RNG_BLOCK - 1) / UT_RNG_BLOCK;
+    if (nbThreads > nbBlocks)
+        nbThreads = (nbBlocks > 0) ? nbBlocks : 1;
+
+    pthread_t threads[nbThreads];
+    GenerateArgs args[nbThreads];
+    for (int i = 0; i < nbThreads; i++)
+    {
+        args[i].t = t;
+        args[i].size = size;
+        args[i].firstBlock = nbBlocks * i / nbThreads;
+        args[i].lastBlock = nbBlocks * (i+1) / nbThreads;
+        args[i].seed = seed;
+        args[i].state = &state;
+        int ret = pthread_create(&(threads[i]), NULL, generateBlocks, &(args[i]));
+        myassert(ret == 0, "echec création thread de génération");
+    }
+    for (int i = 0; i < nbThreads; i++)
+    {
+        int ret = pthread_join(threads[i], NULL);
+        myassert(ret == 0, "echec attente thread de génération");
+    }
+    free(state.fewValues);
+
+    // distributions triées : tri du tirage uniforme (O(n log n))
+    if ((dist->kind == UT_DIST_SORTED) || (dist->kind == UT_DIST_REVERSE_SORTED)
+        || (dist->kind == UT_DIST_NEARLY_SORTED))
+        qsort(t, size, sizeof(elt_t), compareElt);
+    if (dist->kind == UT_DIST_REVERSE_SORTED)
+    {
+        for (long i = 0; i < size / 2; i++)
+        {
+            elt_t tmp = t[i];
+            t[i] = t[size - 1 - i];
+            t[size - 1 - i] = tmp;
+        }
+    }
+    else if ((dist->kind == UT_DIST_NEARLY_SORTED) && (size > 1))
+    {
+        // <param> % des éléments échangés avec un voisin proche
+        UtRng rng;
+        ut_rngInit(&rng, seed, UT_STREAM_NEARLY);
+        long nbSwaps = (long) (size * dist->param / 100 / 2);
+        for (long k = 0; k < nbSwaps; k++)
+        {
+            long i = ut_rngNext(&rng) % size;
+            long j = i + 1 + ut_rngNext(&rng) % UT_NEARLY_DISTANCE;
+            if (j >= size)
+                j = size - 1;
+            elt_t tmp = t[i];
+            t[i] = t[j];
+            t[j] = tmp;
+        }
+    }
 
     // à mettre à true pour débuguer
     bool toPrint = false;
     if (toPrint)
     {
         printf("[");
-        for (int i = 0; i < size; i++)
+        for (long i = 0; i < size; i++)
         {
             if (i != 0)
                 printf(" ");
-            printf("%g", t[i]);
+            printf(ELT_FMT, t[i]);
         }
         printf("]\n");
     }
     return t;
 }
 
-// retourne un tableau de float depuis un intervalle
-float * arrFromInterval(int nb, float min, float max){
-    float *arr = malloc(nb * sizeof(float));
-    myassert(arr != NULL, "allocation mémoire génération tableau float depuis intervalle");
+elt_t * ut_generateTabSeed(long size, double min, double max, int precision, uint64_t seed, int nbThreads)
+{
+    UtDist uniform = { UT_DIST_UNIFORM, 0 };
+    return ut_generateDist(&uniform, size, min, max, precision, seed, nbThreads);
+}
+
+elt_t * ut_generateTab(int size, double min, double max, int precision)
+{
+    long nbCores = sysconf(_SC_NPROCESSORS_ONLN);
+    return ut_generateTabSeed(size, min, max, precision, ut_defaultSeed(), (nbCores < 1) ? 1 : nbCores);
+}
+
+// retourne un tableau d'éléments depuis un intervalle
+elt_t * arrFromInterval(int nb, double min, double max){
+    elt_t *arr = malloc(nb * sizeof(elt_t));
+    myassert(arr != NULL, "allocation mémoire génération tableau d'éléments depuis intervalle");
 
-    float myIncrement = (max - min)/nb;
+    double myIncrement = (max - min)/nb;
 
     for (int i = 0; i < nb; i++)
     {
-        arr[i] = min + (i*myIncrement);
+        arr[i] = ELT_FROM_REAL(min + (i*myIncrement));
     }
 
     // à mettre à true pour débuguer
@@ -91,11 +498,61 @@ float * arrFromInterval(int nb, float min, float max){
         {
             if (i != 0)
                 printf(" ");
-            printf("%g", arr[i]);
+            printf(ELT_FMT, arr[i]);
         }
         printf("]\n");
     }
     return arr;
 }
 
+/******************************************
+ * mesure du temps
+ ******************************************/
+double ut_getTime(void)
+{
+    struct timespec ts;
+    int ret = clock_gettime(CLOCK_MONOTONIC, &ts);
+    myassert(ret == 0, "echec lecture horloge");
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+uint64_t ut_getTimeNs(void)
+{
+    struct timespec ts;
+    int ret = clock_gettime(CLOCK_MONOTONIC, &ts);
+    myassert(ret == 0, "echec lecture horloge");
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/******************************************
+ * ressources du processus courant
+ ******************************************/
+long ut_getRssKB(void)
+{
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f == NULL)
+        return -1;
+    long size, resident;
+    int ret = fscanf(f, "%ld %ld", &size, &resident);
+    fclose(f);
+    if (ret != 2)
+        return -1;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+int ut_getNbOpenFds(void)
+{
+    DIR *dir = opendir("/proc/self/fd");
+    if (dir == NULL)
+        return -1;
+    int nb = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+        if (entry->d_name[0] != '.')
+            nb++;
+    closedir(dir);
+    return nb - 1;      // sans le descripteur du répertoire lui-même
+}
+
 //TODO d'autres fonctions utilitaires éventuellement
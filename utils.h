@@ -2,18 +2,112 @@
 #define UTILS_H
 
 //TODO d'autres include éventuellement
+#include <stdbool.h>
+#include <stdint.h>
+#include "element.h"
+
+
+/******************************************
+ * générateur pseudo-aléatoire (xoshiro256**)
+ ******************************************/
+// État privé d'un générateur : un par thread, jamais partagé.
+// Deux générateurs initialisés avec la même graine et des flux (stream)
+// différents produisent des suites indépendantes.
+typedef struct {
+    uint64_t s[4];
+} UtRng;
+
+// initialisation à partir d'une graine et d'un numéro de flux
+void ut_rngInit(UtRng *rng, uint64_t seed, uint64_t stream);
+
+// entier 64 bits uniforme
+uint64_t ut_rngNext(UtRng *rng);
+
+// réel uniforme dans [0,1[
+double ut_rngUnit(UtRng *rng);
+
+// réel entre min et max (max non inclus : [min,max[), arrondi à <precision> chiffre(s) après la virgule
+double ut_rngReal(UtRng *rng, double min, double max, int precision);
+
+// graine par défaut, différente à chaque exécution (dérivée du pid et de l'horloge)
+uint64_t ut_defaultSeed(void);
 
 
 /******************************************
  * nombres aléatoires
  ******************************************/
 // float aléatoire entre min et max (max non inclus : [min,max[), arrondi à <precision> chiffre(s) après la virgule
+// (générateur global, non thread-safe)
 float ut_getAleaFloat(float min, float max, int precision);
 
-// tableau de float aléatoires utilisant la fonction ci-dessus
-float * ut_generateTab(int size, float min, float max, int precision);
+// double aléatoire entre min et max (mêmes règles que ut_getAleaFloat)
+double ut_getAleaDouble(double min, double max, int precision);
+
+// tableau d'éléments aléatoires (mêmes règles que ut_getAleaFloat) rempli
+// par <nbThreads> threads ; le résultat ne dépend que de <seed>, pas du
+// nombre de threads (pour un type entier, la précision est forcée à 0)
+elt_t * ut_generateTabSeed(long size, double min, double max, int precision, uint64_t seed, int nbThreads);
+
+// distributions des tirages :
+// . uniform : uniforme sur [min,max[ (cf. ut_getAleaFloat)
+// . zipf    : valeur min + (rang-1)/10^precision, rang de probabilité
+//             proportionnelle à 1/rang^s (paramètre s, défaut 1)
+// . normal  : normale de moyenne (min+max)/2 et d'écart type (max-min)/6,
+//             tronquée à [min,max[
+// . sorted  : uniforme triée par ordre croissant
+// . reverse : uniforme triée par ordre décroissant
+// . nearly  : uniforme triée dont p% des éléments sont échangés avec un
+//             voisin proche (paramètre p, défaut 1)
+// . few     : k valeurs distinctes tirées uniformément (paramètre k, défaut 8)
+// note : les distributions triées coûtent un tri en O(n log n)
+typedef enum {
+    UT_DIST_UNIFORM,
+    UT_DIST_ZIPF,
+    UT_DIST_NORMAL,
+    UT_DIST_SORTED,
+    UT_DIST_REVERSE_SORTED,
+    UT_DIST_NEARLY_SORTED,
+    UT_DIST_FEW_DISTINCT
+} UtDistKind;
+
+typedef struct {
+    UtDistKind kind;
+    double param;       // s, p ou k selon la distribution
+} UtDist;
+
+// analyse de "<nom>" ou "<nom>:<paramètre>" ; false si inconnue
+bool ut_parseDist(const char *text, UtDist *dist);
+
+// nom d'une distribution
+const char * ut_distName(UtDistKind kind);
+
+// tableau d'éléments tirés selon <dist> (mêmes règles que ut_generateTabSeed)
+elt_t * ut_generateDist(const UtDist *dist, long size, double min, double max, int precision, uint64_t seed, int nbThreads);
+
+// idem avec une graine par défaut et un thread par coeur
+elt_t * ut_generateTab(int size, double min, double max, int precision);
+
+// tableau d'éléments depuis un intervalle donné 
+elt_t * arrFromInterval(int nb, double min, double max);
+
+
+/******************************************
+ * mesure du temps
+ ******************************************/
+// temps écoulé en secondes depuis une origine arbitraire (horloge monotone)
+double ut_getTime(void);
+
+// idem en nanosecondes entières (pour les mesures fréquentes)
+uint64_t ut_getTimeNs(void);
+
+
+/******************************************
+ * ressources du processus courant (via /proc, -1 si indisponible)
+ ******************************************/
+// mémoire résidente en Ko
+long ut_getRssKB(void);
 
-// tableau de float depuis un intervalle donné 
-float * arrFromInterval(int nb, float min, float max);
+// nombre de descripteurs de fichiers ouverts
+int ut_getNbOpenFds(void);
 
 #endif
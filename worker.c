@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -13,6 +14,9 @@
 #include "myassert.h"
 
 #include "master_worker.h"
+#include "trace.h"
+#include "perfcount.h"
+#include "routing.h"
 
 
 /************************************************************************
@@ -21,18 +25,27 @@
 typedef struct
 {
     // données internes (valeur de l'élément, cardinalité)
-    float element;
+    elt_t element;
     int nbOfElement; 
     // communication avec le père (2 tubes) et avec le master (1 tube en écriture)
     int fdIn; 
     int fdOut;
     int fdToMaster;
+    // canal de l'accusé de réception de création (fdToMaster, ou fdOut
+    // pour un worker créé par une insertion de tableau)
+    int fdAck;
+    // inscription des fils auprès du master (routage direct, -1 sinon ;
+    // cf. routing.h)
+    int fdRoute;
     // communication avec le fils gauche s'il existe (2 tubes)
     int fdFromSubleft;
     int fdToSubleft;
     // communication avec le fils droit s'il existe (2 tubes)
      int fdFromSubright;
      int fdToSubright;
+    // compteurs de performance par type d'ordre (mode MWC_PERF=on)
+    bool perfOn;
+    PcTotals perf[MW_NB_ORDER_SLOTS];
 } Data;
 
 
@@ -41,11 +54,13 @@ typedef struct
  ************************************************************************/
 static void usage(const char *exeName, const char *message)
 {
-    fprintf(stderr, "usage : %s <elt> <fdIn> <fdOut> <fdToMaster>\n", exeName);
-    fprintf(stderr, "   <elt> : élément géré par le worker\n");
+    fprintf(stderr, "usage : %s <elt> <fdIn> <fdOut> <fdToMaster> [<fdAck> [<fdRoute>]]\n", exeName);
+    fprintf(stderr, "   <elt> : élément géré par le worker (type " ELT_NAME ")\n");
     fprintf(stderr, "   <fdIn> : canal d'entrée (en provenance du père)\n");
     fprintf(stderr, "   <fdOut> : canal de sortie (vers le père)\n");
     fprintf(stderr, "   <fdToMaster> : canal de sortie directement vers le master\n");
+    fprintf(stderr, "   <fdAck> : canal de l'accusé de réception de création (défaut <fdToMaster>)\n");
+    fprintf(stderr, "   <fdRoute> : inscription des fils auprès du master (défaut -1 : aucune)\n");
     if (message != NULL)
         fprintf(stderr, "message : %s\n", message);
     exit(EXIT_FAILURE);
@@ -55,11 +70,11 @@ static void parseArgs(int argc, char * argv[], Data *data)
 {
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
-    if (argc != 5)
+    if ((argc < 5) || (argc > 7))
         usage(argv[0], "Nombre d'arguments incorrect");
 
     //initialisation data
-    float elt = strtof(argv[1], NULL);
+    elt_t elt = ELT_FROM_STR(argv[1]);
     int fdIn = strtol(argv[2], NULL, 10);
     int fdOut = strtol(argv[3], NULL, 10);
     int fdToMaster = strtol(argv[4], NULL, 10);
@@ -70,11 +85,16 @@ static void parseArgs(int argc, char * argv[], Data *data)
     data->fdIn=fdIn; 
     data->fdOut=fdOut;
     data->fdToMaster=fdToMaster;
+    data->fdAck = (argc >= 6) ? strtol(argv[5], NULL, 10) : fdToMaster;
+    data->fdRoute = (argc == 7) ? strtol(argv[6], NULL, 10) : -1;
 
     data->fdFromSubleft=0;
     data->fdFromSubright=0;
     data->fdToSubleft=0;
     data->fdToSubright=0;
+
+    data->perfOn = false;
+    memset(data->perf, 0, sizeof(data->perf));
 }
 
 
@@ -83,32 +103,28 @@ static void parseArgs(int argc, char * argv[], Data *data)
  ************************************************************************/
 void stopAction(Data *data)
 {
-    TRACE3("    [worker (%d, %d) {%g}] : ordre stop\n", getpid(), getppid(), data->element);
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
     //si il y a un worker gauche mais pas de droit 
     if ((data->fdToSubleft!=0 && data->fdToSubleft!=0) && (data->fdFromSubright==0 && data->fdToSubright==0)){
       //envoi de l'ordre stop au worker gauche
-      int orderToSend = MW_ORDER_STOP;
-      int retw = write(data->fdToSubleft, &orderToSend, sizeof(int));
+      int retw = mw_writeOrder(data->fdToSubleft, MW_ORDER_STOP);
       myassert(retw != -1, "echec envoi ordre stop au worker gauche");  
       wait(NULL);
     }
     //sinon si il y a un worker droit mais pas de gauche
     else if ((data->fdToSubleft==0 && data->fdToSubleft==0) && (data->fdFromSubright!=0 && data->fdToSubright!=0)) {
       //envoi de l'ordre stop au worker droit
-      int orderToSend = MW_ORDER_STOP;
-      int retw = write(data->fdToSubright, &orderToSend, sizeof(int));
+      int retw = mw_writeOrder(data->fdToSubright, MW_ORDER_STOP);
       myassert(retw != -1, "echec envoi ordre stop au worker droit");  
       wait(NULL);
     }
     //sinon si il y a un work droit et gauche on envoie l'ordre stop au deux 
     else if ((data->fdToSubleft!=0 && data->fdToSubleft!=0) && (data->fdFromSubright!=0 && data->fdToSubright!=0)) {
-      int orderToSend = MW_ORDER_STOP;
-      int retw = write(data->fdToSubleft, &orderToSend, sizeof(int));
+      int retw = mw_writeOrder(data->fdToSubleft, MW_ORDER_STOP);
       myassert(retw != -1, "echec envoi ordre stop au worker gauche");  
 
-      retw = write(data->fdToSubright, &orderToSend, sizeof(int));
+      retw = mw_writeOrder(data->fdToSubright, MW_ORDER_STOP);
       myassert(retw != -1, "echec envoi ordre stop au worker droit");  
 
       //on attend la fin des workers 
@@ -123,7 +139,6 @@ void stopAction(Data *data)
  ************************************************************************/
 static void howManyAction(Data *data)
 {
-    TRACE3("    [worker (%d, %d) {%g}] : ordre how many\n", getpid(), getppid(), data->element);
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
     //cas où les fils n'existent pas
@@ -152,8 +167,7 @@ static void howManyAction(Data *data)
       if((data->fdToSubleft!=0 && data->fdFromSubleft!=0)){
 
         //envoi de l'ordre au worker gauche 
-        int orderToSend = MW_ORDER_HOW_MANY ; 
-        int retw = write(data->fdToSubleft, &orderToSend, sizeof(int));
+        int retw = mw_writeOrder(data->fdToSubleft, MW_ORDER_HOW_MANY);
         myassert(retw != -1, "echec envoi ordre au worker gauche");    
 
         //reception de l'accusé de reception du worker gauche
@@ -172,8 +186,7 @@ static void howManyAction(Data *data)
       //si il y a un worker droit 
       if((data->fdToSubright!=0 && data->fdFromSubright!=0)){
         //envoi de l'ordre au worker droit 
-        int orderToSend = MW_ORDER_HOW_MANY ; 
-        int retw = write(data->fdToSubright, &orderToSend, sizeof(int));
+        int retw = mw_writeOrder(data->fdToSubright, MW_ORDER_HOW_MANY);
         myassert(retw != -1, "echec envoi ordre au worker gauche");    
 
         //reception de l'accusé de reception du worker droit
@@ -213,7 +226,6 @@ static void howManyAction(Data *data)
  ************************************************************************/
 static void minimumAction(Data *data)
 {
-    TRACE3("    [worker (%d, %d) {%g}] : ordre minimum\n", getpid(), getppid(), data->element);
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
     //si le fils gauche n'existe pas (on est sur le minimum)
@@ -224,15 +236,14 @@ static void minimumAction(Data *data)
       myassert(retw != -1, "echec envoi accusé de reception");
 
       //envoi de l'élément du worker courant au master
-      float elementToSend = data->element;
-      retw = write(data->fdToMaster, &elementToSend, sizeof(float));
+      elt_t elementToSend = data->element;
+      retw = write(data->fdToMaster, &elementToSend, sizeof(elt_t));
       myassert(retw != -1, "echec envoi element");
     }
     //sinon (si le minimum n'est pas atteint)
     else {
       //envoi au worker gauche de l'ordre minimum
-      int orderToSend = MW_ORDER_MINIMUM;
-      int retw = write(data->fdToSubleft, &orderToSend, sizeof(int));
+      int retw = mw_writeOrder(data->fdToSubleft, MW_ORDER_MINIMUM);
       myassert(retw != -1, "echec envoi ordre au worker gauche"); 
     }
 }
@@ -243,7 +254,6 @@ static void minimumAction(Data *data)
  ************************************************************************/
 static void maximumAction(Data *data)
 {
-    TRACE3("    [worker (%d, %d) {%g}] : ordre maximum\n", getpid(), getppid(), data->element);
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
     //si le fils droit n'existe pas (on est sur le maximum)
@@ -254,15 +264,14 @@ static void maximumAction(Data *data)
       myassert(retw != -1, "echec envoi accusé de reception");
 
       //envoi de l'élément du worker courant au master
-      float elementToSend = data->element;
-      retw = write(data->fdToMaster, &elementToSend, sizeof(float));
+      elt_t elementToSend = data->element;
+      retw = write(data->fdToMaster, &elementToSend, sizeof(elt_t));
       myassert(retw != -1, "echec envoi element");
     }
     //sinon (si le maximum n'est pas atteint)
     else {
       //envoi au worker droit de l'ordre maximum
-      int orderToSend = MW_ORDER_MAXIMUM;
-      int retw = write(data->fdToSubright, &orderToSend, sizeof(int));
+      int retw = mw_writeOrder(data->fdToSubright, MW_ORDER_MAXIMUM);
       myassert(retw != -1, "echec envoi ordre au worker gauche"); 
     }
 }
@@ -273,13 +282,12 @@ static void maximumAction(Data *data)
  ************************************************************************/
 static void existAction(Data *data)
 {
-    TRACE3("    [worker (%d, %d) {%g}] : ordre exist\n", getpid(), getppid(), data->element);
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
     // - recevoir l'élément à tester en provenance du père
-    float elementReceived;
-    int retr = read(data->fdIn, &elementReceived, sizeof(float));
-    myassert(retr != 0, "echec lecture elt float");
+    elt_t elementReceived;
+    int retr = read(data->fdIn, &elementReceived, sizeof(elt_t));
+    myassert(retr != 0, "echec lecture elt");
 
     // - si élément courant == élément à tester
     if(elementReceived == data->element){
@@ -309,20 +317,18 @@ static void existAction(Data *data)
     }
     //sinon si (elt à insérer < elt courant)
     else if(elementReceived < data->element){
-      int orderToSend = MW_ORDER_EXIST ; 
-      int retw = write(data->fdToSubleft, &orderToSend, sizeof(int));
+      int retw = mw_writeOrder(data->fdToSubleft, MW_ORDER_EXIST);
       myassert(retw != -1, "echec envoi ordre au worker gauche");    
 
-      retw = write(data->fdToSubleft, &elementReceived, sizeof(float));
+      retw = write(data->fdToSubleft, &elementReceived, sizeof(elt_t));
       myassert(retw != -1, "echec envoi element");
     }
     //sinon (elt à insérer > elt courant)
     else{
-      int orderToSend = MW_ORDER_EXIST ; 
-      int retw = write(data->fdToSubright, &orderToSend, sizeof(int));
+      int retw = mw_writeOrder(data->fdToSubright, MW_ORDER_EXIST);
       myassert(retw != -1, "echec envoi ordre au worker gauche");    
 
-      retw = write(data->fdToSubright, &elementReceived, sizeof(float));
+      retw = write(data->fdToSubright, &elementReceived, sizeof(elt_t));
       myassert(retw != -1, "echec envoi element");
     }
 }
@@ -333,7 +339,6 @@ static void existAction(Data *data)
  ************************************************************************/
 static void sumAction(Data *data)
 {
-    TRACE3("    [worker (%d, %d) {%g}] : ordre sum\n", getpid(), getppid(), data->element);
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
      //cas où les fils n'existent pas
@@ -344,21 +349,20 @@ static void sumAction(Data *data)
       myassert(retw != -1, "echec envoi accusé de reception");
 
       //envoyer la valeur du worker
-      float element = (data->element) * (data->nbOfElement); 
-      retw = write(data->fdOut, &element, sizeof(float));
+      eltsum_t element = ((eltsum_t) data->element) * (data->nbOfElement); 
+      retw = write(data->fdOut, &element, sizeof(eltsum_t));
       myassert(retw != -1, "echec envoi accusé de reception");
     }
     //sinon il y a au moins un fils
     else {
       //on initialise nos resultats 
-      float result1=0;
-      float result2=0;
+      eltsum_t result1=0;
+      eltsum_t result2=0;
       //si il y a un worker gauche 
       if((data->fdToSubleft!=0 && data->fdFromSubleft!=0)){
 
         //envoi de l'ordre au worker gauche 
-        int orderToSend = MW_ORDER_SUM ; 
-        int retw = write(data->fdToSubleft, &orderToSend, sizeof(int));
+        int retw = mw_writeOrder(data->fdToSubleft, MW_ORDER_SUM);
         myassert(retw != -1, "echec envoi ordre au worker gauche");    
 
         //reception de l'accusé de reception du worker gauche
@@ -367,15 +371,14 @@ static void sumAction(Data *data)
         myassert(retr != 0, "echec lecture accusé de reception");
 
         //reception du résultat envoyé par le worker gauche 
-        retr = read(data->fdFromSubleft, &result1, sizeof(float));
+        retr = read(data->fdFromSubleft, &result1, sizeof(eltsum_t));
         myassert(retr != 0, "echec lecture somme");
 
       }
       //si il y a un worker droit 
       if((data->fdToSubright!=0 && data->fdFromSubright!=0)){
         //envoi de l'ordre au worker droit 
-        int orderToSend = MW_ORDER_SUM ; 
-        int retw = write(data->fdToSubright, &orderToSend, sizeof(int));
+        int retw = mw_writeOrder(data->fdToSubright, MW_ORDER_SUM);
         myassert(retw != -1, "echec envoi ordre au worker gauche");    
 
         //reception de l'accusé de reception du worker droit
@@ -384,7 +387,7 @@ static void sumAction(Data *data)
         myassert(retr != 0, "echec lecture accusé de reception");
 
         //reception du résultat envoyé par le worker droit 
-        retr = read(data->fdFromSubright, &result2, sizeof(float));
+        retr = read(data->fdFromSubright, &result2, sizeof(eltsum_t));
         myassert(retr != 0, "echec lecture somme");
       }
 
@@ -394,24 +397,84 @@ static void sumAction(Data *data)
       myassert(retw != -1, "echec envoi accusé de reception");    
 
       //envoi de la somme des resultats des sous workers et la valeur du worker courant 
-      float somme = ((data->element)*(data->nbOfElement))+ result1 + result2; 
-      retw = write(data->fdOut, &somme, sizeof(float));
+      eltsum_t somme = (((eltsum_t) data->element)*(data->nbOfElement))+ result1 + result2; 
+      retw = write(data->fdOut, &somme, sizeof(eltsum_t));
       myassert(retw != -1, "echec envoi somme");
     }
 }
 
 
+/************************************************************************
+ * Création d'un fils
+ ************************************************************************/
+// nouveau worker gérant <elt> ; son accusé de réception de création part
+// vers le master, ou vers nous (sur *fdFromSub) si <ackToParent>
+static void spawnSub(Data *data, elt_t elt, bool ackToParent, int *fdFromSub, int *fdToSub)
+{
+    //création des tubes anonymes 
+    int fdsWorkerToSub[2];
+    pipe(fdsWorkerToSub); 
+    int fdsSubToWorker[2];
+    pipe(fdsSubToWorker);
+
+    //inscription du fils auprès du master avant sa création : elle
+    //précède ainsi toujours son accusé de réception
+    if (data->fdRoute != -1)
+      rt_register(data->fdRoute, elt, fdsWorkerToSub[1]);
+
+    //on fork le worker 
+    int f = fork();
+
+    //si on est dans le fils 
+    if (f == 0){
+      //on ferme les extrémités inutiles
+      close(fdsSubToWorker[0]);
+      close(fdsWorkerToSub[1]);
+
+      //on convertit nos arguments en string
+      char myEltString[50];
+      sprintf(myEltString, ELT_ARG_FMT, elt);
+
+      char fdInString[50];
+      sprintf(fdInString,"%d",fdsWorkerToSub[0]);
+
+      char fdOutString[50];
+      sprintf(fdOutString,"%d",fdsSubToWorker[1]);
+
+      char fdtoMasterString[50];
+      sprintf(fdtoMasterString, "%d", data->fdToMaster);
+
+      char fdRouteString[50];
+      sprintf(fdRouteString, "%d", data->fdRoute);
+
+      const char *fdAckString = ackToParent ? fdOutString : fdtoMasterString;
+      execl("worker", "./worker", myEltString, fdInString, fdOutString, fdtoMasterString, fdAckString,
+            fdRouteString, NULL); 
+      myassert(false, "echec lancement ./worker");
+    }
+    //si on est dans le worker pere
+    else{
+      //on ferme les extrémités inutiles
+      close(fdsSubToWorker[1]);
+      close(fdsWorkerToSub[0]);
+
+      //on renseigne les file descriptors permettant de communiquer avec le fils
+      *fdFromSub = fdsSubToWorker[0];
+      *fdToSub = fdsWorkerToSub[1];
+    }
+}
+
+
 /************************************************************************
  * Insertion d'un nouvel élément
  ************************************************************************/
 static void insertAction(Data *data)
 {
-    TRACE3("    [worker (%d, %d) {%g}] : ordre insert\n", getpid(), getppid(), data->element);
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
     // - reception de l'élément à insérer en provenance du père
-    float elementReceived;
-    int retr = read(data->fdIn, &elementReceived, sizeof(float));
+    elt_t elementReceived;
+    int retr = read(data->fdIn, &elementReceived, sizeof(elt_t));
     myassert(retr != 0, "echec lecture accusé de reception");
 
     //printf("mtn je compare %f == %f ... c'est %d\n", elementReceived, data->element, elementReceived == data->element);
@@ -434,131 +497,131 @@ static void insertAction(Data *data)
     //sinon si (elt à tester < elt courant) et (pas de fils gauche)
     else if ((elementReceived < data->element) && ((data->fdFromSubleft==0) && (data->fdToSubleft==0))){
 
-      //création des tubes anonymes 
-      int fdsWorkertoSubleft[2];
-      pipe(fdsWorkertoSubleft); 
-      int fdsSubleftToWorker[2];
-      pipe(fdsSubleftToWorker);
-
-      //on fork le worker 
-      int f1 = fork();
-
-      //si on est dans le fils 
-      if (f1==0){
-        //on ferme les extrémités inutiles
-        close(fdsSubleftToWorker[0]);
-        close(fdsWorkertoSubleft[1]);
-
-        //on convertit nos arguments en string
-        char myEltString[50];
-        sprintf(myEltString,"%f",elementReceived);
-
-        char fdInString[50];
-        sprintf(fdInString,"%d",fdsWorkertoSubleft[0]);
-
-        char fdOutString[50];
-        sprintf(fdOutString,"%d",fdsSubleftToWorker[1]);
-
-        char fdtoMasterString[50];
-        sprintf(fdtoMasterString, "%d", data->fdToMaster);
-
-        // - crée un nouveau worker à "gauche" avec l'élément reçu
-        execl("worker", "./worker", myEltString, fdInString, fdOutString, fdtoMasterString, NULL); 
-      }
-      //si on est dans le worker pere
-      else{
-         //on ferme les extrémités inutiles
-        close(fdsSubleftToWorker[1]);
-        close(fdsWorkertoSubleft[0]);
-
-        //on renseigne les file descriptors permettant de communiquer avec le worker à gauche 
-        data->fdFromSubleft = fdsSubleftToWorker[0];
-        data->fdToSubleft = fdsWorkertoSubleft[1];
-      }
+      // - crée un nouveau worker à "gauche" avec l'élément reçu
+      spawnSub(data, elementReceived, false, &(data->fdFromSubleft), &(data->fdToSubleft));
     }
      //sinon si (elt à tester > elt courant) et (pas de fils droit)
     else if ((elementReceived > data->element) && ((data->fdFromSubright==0) && (data->fdToSubright==0))){
 
-      //création des tubes anonymes 
-      int fdsWorkertoSubright[2];
-      pipe(fdsWorkertoSubright); 
-      int fdsSubrightToWorker[2];
-      pipe(fdsSubrightToWorker);
-
-      //on fork le worker 
-      int f2 = fork();
-
-      //si on est dans le fils 
-      if (f2==0){
-        //on ferme les extrémités inutiles
-        close(fdsSubrightToWorker[0]);
-        close(fdsWorkertoSubright[1]);
-
-        //on convertit nos arguments en string
-        char myEltString[50];
-        sprintf(myEltString,"%f",elementReceived);
-
-        char fdInString[50];
-        sprintf(fdInString,"%d",fdsWorkertoSubright[0]);
-
-        char fdOutString[50];
-        sprintf(fdOutString,"%d",fdsSubrightToWorker[1]);
-
-        char fdtoMasterString[50];
-        sprintf(fdtoMasterString, "%d", data->fdToMaster);
-
-        // - crée un nouveau worker à "droite" avec l'élément reçu
-        execl("worker", "./worker", myEltString, fdInString, fdOutString, fdtoMasterString, NULL); 
-      }
-      //si on est dans le worker pere
-      else{
-         //on ferme les extrémités inutiles
-        close(fdsSubrightToWorker[1]);
-        close(fdsWorkertoSubright[0]);
-
-        //on renseigne les file descriptors permettant de communiquer avec le worker à droite 
-        data->fdFromSubright = fdsSubrightToWorker[0];
-        data->fdToSubright = fdsWorkertoSubright[1];
-      }
+      // - crée un nouveau worker à "droite" avec l'élément reçu
+      spawnSub(data, elementReceived, false, &(data->fdFromSubright), &(data->fdToSubright));
     }
     //sinon si (elt à insérer < elt courant)
     else if(elementReceived < data->element){
       //envoi de l'ordre insert au worker gauche 
-      int orderToSend = MW_ORDER_INSERT;
-      int retw = write(data->fdToSubleft, &orderToSend, sizeof(int));
+      int retw = mw_writeOrder(data->fdToSubleft, MW_ORDER_INSERT);
       myassert(retw != -1, "echec envoi order au worker");
 
       //envoi de l'élément à insérer au worker gauche 
-      retw = write(data->fdToSubleft, &elementReceived, sizeof(float));
+      retw = write(data->fdToSubleft, &elementReceived, sizeof(elt_t));
       myassert(retw != -1, "echec envoi element au worker");
     }
     //sinon (donc elt à insérer > elt courant)
     else{
       //envoi de l'ordre insert au worker droit 
-      int orderToSend = MW_ORDER_INSERT;
-      int retw = write(data->fdToSubright, &orderToSend, sizeof(int));
+      int retw = mw_writeOrder(data->fdToSubright, MW_ORDER_INSERT);
       myassert(retw != -1, "echec envoi order au worker");
 
       //envoi de l'élément à insérer au worker droit 
-      retw = write(data->fdToSubright, &elementReceived, sizeof(float));
+      retw = write(data->fdToSubright, &elementReceived, sizeof(elt_t));
       myassert(retw != -1, "echec envoi element au worker");
     }
 }
 
 
+/************************************************************************
+ * Insertion d'un tableau d'éléments
+ ************************************************************************/
+// envoi à un fils (créé si besoin avec le premier élément) de son
+// sous-tableau ; retourne true si une réponse MW_ANSWER_INSERT_MANY est attendue
+static bool insertManySend(Data *data, int *fdFromSub, int *fdToSub, const elt_t *tab, int nb)
+{
+    if (nb == 0)
+        return false;
+    int first = 0;
+    if (*fdToSub == 0){
+      spawnSub(data, tab[0], true, fdFromSub, fdToSub);
+      int receipt;
+      mw_readAll(*fdFromSub, &receipt, sizeof(int));
+      myassert(receipt == MW_ANSWER_INSERT, "accusé de reception inattendu");
+      first = 1;
+    }
+    int rest = nb - first;
+    if (rest == 0)
+        return false;
+    int retw = mw_writeOrder(*fdToSub, MW_ORDER_INSERT_MANY);
+    myassert(retw != -1, "echec envoi ordre au fils");
+    mw_writeAll(*fdToSub, &rest, sizeof(int));
+    mw_writeAll(*fdToSub, tab + first, rest * sizeof(elt_t));
+    return true;
+}
+
+static void insertManyReceive(int fdFromSub)
+{
+    int receipt;
+    mw_readAll(fdFromSub, &receipt, sizeof(int));
+    myassert(receipt == MW_ANSWER_INSERT_MANY, "accusé de reception inattendu");
+}
+
+static void insertManyAction(Data *data)
+{
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    // - reception du tableau en provenance du père
+    int nb;
+    mw_readAll(data->fdIn, &nb, sizeof(int));
+    myassert(nb >= 0, "taille de tableau incorrecte");
+    elt_t *tab = malloc((nb > 0 ? nb : 1) * sizeof(elt_t));
+    myassert(tab != NULL, "echec allocation tableau");
+    mw_readAll(data->fdIn, tab, nb * sizeof(elt_t));
+
+    // - partage stable : [0,nbLeft[ pour le fils gauche, puis le fils droit
+    int nbLeft = 0;
+    for (int i = 0; i < nb; i++)
+        if (tab[i] < data->element)
+            nbLeft++;
+    elt_t *parts = malloc((nb > 0 ? nb : 1) * sizeof(elt_t));
+    myassert(parts != NULL, "echec allocation tableau");
+    int iLeft = 0;
+    int iRight = nbLeft;
+    for (int i = 0; i < nb; i++)
+    {
+        if (tab[i] < data->element)
+            parts[iLeft++] = tab[i];
+        else if (tab[i] > data->element)
+            parts[iRight++] = tab[i];
+        else
+            (data->nbOfElement)++;
+    }
+    int nbRight = iRight - nbLeft;
+    free(tab);
+
+    // - les deux fils travaillent en même temps
+    bool waitLeft = insertManySend(data, &(data->fdFromSubleft), &(data->fdToSubleft), parts, nbLeft);
+    bool waitRight = insertManySend(data, &(data->fdFromSubright), &(data->fdToSubright), parts + nbLeft, nbRight);
+    free(parts);
+    if (waitLeft)
+        insertManyReceive(data->fdFromSubleft);
+    if (waitRight)
+        insertManyReceive(data->fdFromSubright);
+
+    //envoi de l'accusé de reception au père
+    int receiptToSend = MW_ANSWER_INSERT_MANY;
+    mw_writeAll(data->fdOut, &receiptToSend, sizeof(int));
+}
+
+
 /************************************************************************
  * Affichage
  ************************************************************************/
 static void printAction(Data *data)
 {
-    TRACE3("    [worker (%d, %d) {%g}] : ordre print\n", getpid(), getppid(), data->element);
     myassert(data != NULL, "il faut l'environnement d'exécution");
 
     //si le worker gauche existe
     if (data->fdToSubleft!=0 && data->fdFromSubleft!=0){
       //envoi de l'ordre au worker gauche
-      int orderToSend = MW_ORDER_PRINT;
-      int retw = write(data->fdToSubleft, &orderToSend, sizeof(int));
+      int retw = mw_writeOrder(data->fdToSubleft, MW_ORDER_PRINT);
       myassert(retw != -1, "echec envoi order au worker");
 
       //reception de l'accusé de reception du worker gauche 
@@ -570,8 +633,7 @@ static void printAction(Data *data)
     //si le worker droit existe
     if (data->fdToSubright!=0 && data->fdFromSubright!=0){
       //envoi de l'ordre au worker droit
-      int orderToSend = MW_ORDER_PRINT;
-      int retw = write(data->fdToSubright, &orderToSend, sizeof(int));
+      int retw = mw_writeOrder(data->fdToSubright, MW_ORDER_PRINT);
       myassert(retw != -1, "echec envoi order au worker");
 
       //reception de l'accusé de reception du worker droit 
@@ -580,8 +642,8 @@ static void printAction(Data *data)
       myassert(retr != 0, "echec lecture accusé de reception");
     }
 
-    //Affichage du worker
-    TRACE2("[%f, %d]\n", data->element, data->nbOfElement);
+    //Affichage du worker (c'est le résultat de l'ordre : pas une trace)
+    fprintf(stderr, "[" ELT_FMT ", %d]\n", data->element, data->nbOfElement);
 
     //envoi de l'accusé de reception au père 
     int receiptToSend = MW_ANSWER_PRINT; ;
@@ -590,6 +652,85 @@ static void printAction(Data *data)
 }
 
 
+/************************************************************************
+ * Statistiques de l'arbre
+ ************************************************************************/
+// envoi de l'ordre à un fils (s'il existe)
+static void treeStatsOrder(int fdToSub)
+{
+    if (fdToSub == 0)
+        return;
+    int retw = mw_writeOrder(fdToSub, MW_ORDER_TREESTATS);
+    myassert(retw != -1, "echec envoi ordre au fils");
+}
+
+// réception des statistiques d'un fils (toutes nulles s'il n'existe pas)
+static int * treeStatsReceive(int fdFromSub, MwTreeStats *stats)
+{
+    *stats = (MwTreeStats) {0};
+    if (fdFromSub == 0)
+        return NULL;
+    int receipt;
+    int retr = read(fdFromSub, &receipt, sizeof(int));
+    myassert(retr != 0, "echec lecture accusé de reception");
+    myassert(receipt == MW_ANSWER_TREESTATS, "accusé de reception inattendu");
+    return mw_readTreeStats(fdFromSub, stats);
+}
+
+static void treeStatsAction(Data *data)
+{
+    myassert(data != NULL, "il faut l'environnement d'exécution");
+
+    // les deux fils travaillent en même temps
+    treeStatsOrder(data->fdToSubleft);
+    treeStatsOrder(data->fdToSubright);
+    MwTreeStats left, right;
+    int *depthsLeft = treeStatsReceive(data->fdFromSubleft, &left);
+    int *depthsRight = treeStatsReceive(data->fdFromSubright, &right);
+
+    long rss = ut_getRssKB();
+    int nbFds = ut_getNbOpenFds();
+    rss = (rss < 0) ? 0 : rss;
+    nbFds = (nbFds < 0) ? 0 : nbFds;
+
+    int imbalance = abs(left.height - right.height);
+    MwTreeStats stats;
+    stats.height = 1 + ((left.height > right.height) ? left.height : right.height);
+    stats.nbNodes = 1 + left.nbNodes + right.nbNodes;
+    stats.maxImbalance = imbalance;
+    if (left.maxImbalance > stats.maxImbalance)
+        stats.maxImbalance = left.maxImbalance;
+    if (right.maxImbalance > stats.maxImbalance)
+        stats.maxImbalance = right.maxImbalance;
+    stats.nbUnbalanced = (imbalance > 1) + left.nbUnbalanced + right.nbUnbalanced;
+    stats.rssKB = rss + left.rssKB + right.rssKB;
+    stats.nbFds = nbFds + left.nbFds + right.nbFds;
+    stats.maxFds = nbFds;
+    if (left.maxFds > stats.maxFds)
+        stats.maxFds = left.maxFds;
+    if (right.maxFds > stats.maxFds)
+        stats.maxFds = right.maxFds;
+
+    // profondeurs des fils décalées d'un niveau
+    int *depths = calloc(stats.height, sizeof(int));
+    myassert(depths != NULL, "echec allocation des profondeurs");
+    depths[0] = 1;
+    for (int k = 0; k < left.height; k++)
+        depths[k+1] += depthsLeft[k];
+    for (int k = 0; k < right.height; k++)
+        depths[k+1] += depthsRight[k];
+
+    int receiptToSend = MW_ANSWER_TREESTATS;
+    int retw = write(data->fdOut, &receiptToSend, sizeof(int));
+    myassert(retw != -1, "echec envoi accusé de reception");
+    mw_writeTreeStats(data->fdOut, &stats, depths);
+
+    free(depths);
+    free(depthsLeft);
+    free(depthsRight);
+}
+
+
 /************************************************************************
  * Boucle principale de traitement
  ************************************************************************/
@@ -601,8 +742,13 @@ void loop(Data *data)
     {
         int orderReceived;
 
-        int retr = read(data->fdIn, &orderReceived, sizeof(int));
-        myassert(retr != 0, "error loop worker.c : echec lecture order");
+        int retr = mw_readOrder(data->fdIn, &orderReceived);
+        myassert(retr > 0, "error loop worker.c : echec lecture order");
+        uint64_t orderStart = ut_getTimeNs();
+        tr_event(TR_ORDER, orderReceived, data->element, 0);
+        PcSample perfBefore;
+        if (data->perfOn)
+            pc_read(&perfBefore);
 
         //printf("WORKER : lecture de l'ordre ok !\n");
 
@@ -635,13 +781,25 @@ void loop(Data *data)
           case MW_ORDER_PRINT:
             printAction(data);
             break;
+          case MW_ORDER_TREESTATS:
+            treeStatsAction(data);
+            break;
+          case MW_ORDER_INSERT_MANY:
+            insertManyAction(data);
+            break;
           default:
             myassert(false, "ordre inconnu");
             exit(EXIT_FAILURE);
             break;
         }
 
-        TRACE3("    [worker (%d, %d) {%g}] : fin ordre\n", getpid(), getppid(), data->element);
+        if (data->perfOn && (orderReceived >= 0) && (orderReceived / 10 < MW_NB_ORDER_SLOTS))
+        {
+            PcSample perfAfter;
+            pc_read(&perfAfter);
+            pc_add(&(data->perf[orderReceived / 10]), &perfBefore, &perfAfter);
+        }
+        tr_event(TR_ORDER_END, orderReceived, data->element, ut_getTimeNs() - orderStart);
     }
 }
 
@@ -654,11 +812,13 @@ int main(int argc, char * argv[])
 {
     Data data;
     parseArgs(argc, argv, &data);
-    TRACE3("    [worker (%d, %d) {%g}] : début worker\n", getpid(), getppid(), data.element);
+    tr_init("worker", false);
+    tr_event(TR_START, -1, data.element, 0);
+    data.perfOn = pc_init();
 
-    //envoi au master l'accusé de réception d'insertion 
+    //envoi au master (ou au père) l'accusé de réception d'insertion 
     int receiptToSend = MW_ANSWER_INSERT; ;
-    int retw = write(data.fdToMaster, &receiptToSend, sizeof(int));
+    int retw = write(data.fdAck, &receiptToSend, sizeof(int));
     myassert(retw != -1, "echec envoi accusé de reception");
 
     //note : en effet si je suis créé c'est qu'on vient d'insérer un élément : moi
@@ -675,6 +835,11 @@ int main(int argc, char * argv[])
     int ret3 = close(data.fdToMaster);
     myassert(ret3 == 0, "echec fermeture pipe toMaster");
 
-    TRACE3("    [worker (%d, %d) {%g}] : fin worker\n", getpid(), getppid(), data.element);
+    if (data.fdRoute != -1)
+        close(data.fdRoute);
+
+    if (data.perfOn)
+        pc_dump("worker", data.perf, MW_NB_ORDER_SLOTS);
+    tr_event(TR_END, -1, data.element, 0);
     return EXIT_SUCCESS;
 }